@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+
+#include "level.h"
+#include "tank_base.h"
+
+/*
+ * Helpers shared by the benchmarks
+ */
+
+/* FNV-1a of the pixels of the rectangle, row by row. Levels built in different ways hash the same when their
+ * pixels are the same. */
+inline std::uint64_t HashRect(const Level * level, Rect rect)
+{
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        const LevelPixel * row = level->GetLevelRow(y);
+        for (int x = rect.Left(); x <= rect.Right(); ++x)
+            hash = (hash ^ std::uint64_t(row[x])) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+/* All the pixels of the level, followed by the positions of its bases */
+inline std::uint64_t HashLevel(const Level * level)
+{
+    std::uint64_t hash = HashRect(level, Rect{Position{0, 0}, level->GetSize()});
+    auto add = [&hash](std::uint64_t value) { hash = (hash ^ value) * 0x100000001B3ull; };
+    for (const TankBase & base : level->GetSpawns())
+    {
+        add(std::uint64_t(base.GetPosition().x));
+        add(std::uint64_t(base.GetPosition().y));
+    }
+    return hash;
+}
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "level.h"
+#include "levelgen.h"
+#include "levelgen_braid.h"
+#include "random.h"
+#include "trace.h"
+
+/*
+ * Braid maze benchmark
+ *  Builds the walls of braid mazes for every requested number of cells and seed, once testing each new wall by
+ *  flooding the whole maze and once with the union-find of WallCorners, and checks both keep the same walls.
+ *  Then times whole braid levels of the requested sizes.
+ */
+
+using levelgen::braid::BraidConnectivity;
+
+struct BenchOptions
+{
+    std::vector<Size> cells;
+    std::vector<Size> sizes;
+    int seeds = 3;
+    int first_seed = 1;
+};
+
+static std::chrono::microseconds Median(std::vector<std::chrono::microseconds> times)
+{
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+/* Returns false when the two ways kept different walls */
+static bool RunWalls(const BenchOptions & options, Size cells)
+{
+    std::vector<std::chrono::microseconds> flood_times, corner_times;
+    int differ = 0;
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+    {
+        Random.Seed(seed);
+        Stopwatch<> flood_time;
+        auto flood_walls = levelgen::braid::GenerateBraidWalls(cells, BraidConnectivity::FloodFill);
+        flood_times.push_back(flood_time.GetElapsed());
+
+        Random.Seed(seed);
+        Stopwatch<> corner_time;
+        auto corner_walls = levelgen::braid::GenerateBraidWalls(cells, BraidConnectivity::WallCorners);
+        corner_times.push_back(corner_time.GetElapsed());
+
+        differ += flood_walls != corner_walls;
+    }
+
+    auto flood = Median(flood_times), corners = Median(corner_times);
+    std::printf("%4dx%-4d cells  flood fill %10.3f ms   wall corners %8.3f ms   %8.1fx   %s\n", cells.x, cells.y,
+                flood.count() / 1000.0, corners.count() / 1000.0,
+                double(flood.count()) / std::max<long long>(1, corners.count()), differ ? "DIFFERS" : "same walls");
+    return !differ;
+}
+
+static void RunLevel(const BenchOptions & options, Size size)
+{
+    std::vector<std::chrono::microseconds> times;
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+    {
+        Random.Seed(seed);
+        Stopwatch<> elapsed;
+        levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Braid, size);
+        times.push_back(elapsed.GetElapsed());
+    }
+    std::printf("%5dx%-5d level  %10.3f ms\n", size.x, size.y, Median(times).count() / 1000.0);
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--cells", argv[i]) && i + 2 < argc)
+        {
+            options.cells.push_back(Size{std::max(1, atoi(argv[i + 1])), std::max(1, atoi(argv[i + 2]))});
+            i += 2;
+        }
+        else if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.sizes.push_back(Size{atoi(argv[i + 1]), atoi(argv[i + 2])});
+            i += 2;
+        }
+        else if (!strcmp("--seeds", argv[i]) && i + 1 < argc)
+            options.seeds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.first_seed = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--cells <W> <H>]... [--size <W> <H>]... [--seeds <N>] [--seed <first seed>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    /* Cells of 1000x500 and 4000x4000 levels, and a larger maze to show how the flood fill scales */
+    if (options.cells.empty())
+        options.cells = {Size{16, 8}, Size{66, 66}, Size{128, 128}};
+    if (options.sizes.empty())
+        options.sizes = {Size{1000, 500}, Size{4000, 4000}};
+
+    std::printf("%d seeds from %d\n", options.seeds, options.first_seed);
+    bool is_same = true;
+    for (Size cells : options.cells)
+        is_same = RunWalls(options, cells) && is_same;
+    for (Size size : options.sizes)
+        RunLevel(options, size);
+    return is_same ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+#include "level.h"
+#include "levelgen.h"
+#include "levelgen_toast.h"
+#include "random.h"
+#include "thread_pool.h"
+
+/*
+ * Toast expansion scaling benchmark
+ *  Generates toast levels on pools of 1 to N threads and reports the median time of the randomly_expand stage
+ *  and the speedup against one thread. The thread generating the level helps the pool while it waits.
+ *  Every thread count has to end with the same levels, the benchmark fails when one of them differs.
+ */
+
+struct BenchOptions
+{
+    std::vector<Size> sizes;
+    int seeds = 3;
+    int first_seed = 1;
+    int max_threads = int(std::max(1u, std::thread::hardware_concurrency()));
+};
+
+struct ScalingResult
+{
+    std::chrono::microseconds median = {};
+    std::uint64_t hash = 0; /* Of all the seeds together */
+};
+
+static ScalingResult RunThreads(const BenchOptions & options, Size size, int threads)
+{
+    ThreadPool pool{threads};
+    levelgen::toast::ToastLevelGenerator generator{&pool};
+
+    ScalingResult result;
+    std::vector<std::chrono::microseconds> times;
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+    {
+        Random.Seed(seed);
+        levelgen::GenerationStages stages;
+        auto level = generator.Generate(size, stages);
+        for (const levelgen::GenerationStage & stage : stages)
+            if (!strcmp(stage.name, "randomly_expand"))
+                times.push_back(stage.time);
+        result.hash = result.hash * 31 + HashLevel(level.get());
+    }
+    std::sort(times.begin(), times.end());
+    result.median = times.empty() ? std::chrono::microseconds{} : times[times.size() / 2];
+    return result;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.sizes.push_back(Size{atoi(argv[i + 1]), atoi(argv[i + 2])});
+            i += 2;
+        }
+        else if (!strcmp("--seeds", argv[i]) && i + 1 < argc)
+            options.seeds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.first_seed = atoi(argv[++i]);
+        else if (!strcmp("--max-threads", argv[i]) && i + 1 < argc)
+            options.max_threads = std::max(1, atoi(argv[++i]));
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>]... [--seeds <N>] [--seed <first seed>] [--max-threads <N>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    if (options.sizes.empty())
+        options.sizes = {Size{1000, 500}, Size{4000, 2000}};
+
+    bool is_same = true;
+    std::printf("%11s %8s %12s %8s  %s\n", "size", "threads", "median ms", "speedup", "level hash");
+    for (Size size : options.sizes)
+    {
+        ScalingResult first;
+        for (int threads = 1; threads <= options.max_threads; ++threads)
+        {
+            ScalingResult result = RunThreads(options, size, threads);
+            first = threads == 1 ? result : first;
+            is_same = is_same && result.hash == first.hash;
+            std::printf("%5dx%-5d %8d %12.3f %8.2f  %016llx%s\n", size.x, size.y, threads,
+                        result.median.count() / 1000.0,
+                        double(first.median.count()) / std::max<std::int64_t>(1, result.median.count()),
+                        static_cast<unsigned long long>(result.hash), result.hash == first.hash ? "" : "   DIFFERS");
+        }
+    }
+    return is_same ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "level.h"
+#include "levelgen.h"
+#include "random.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "tweak.h"
+
+/*
+ * Level generation benchmark
+ *  Generates levels with every requested generator, size and seed and reports the median and p95 of the whole
+ *  generation and of each stage the generator times (toast: generate_tree, randomly_expand, smooth_cavern).
+ *  The summary goes to stdout, --csv and --json write the same numbers to files.
+ *  With --golden it instead generates the levels listed in GoldenLevels for several worker counts and fails when
+ *  any of them hashes differently. A change to a generator that is meant to change its levels has to update
+ *  the table.
+ */
+
+struct BenchOptions
+{
+    std::vector<levelgen::LevelGeneratorType> generators;
+    std::vector<Size> sizes;
+    int seeds = 5;
+    int first_seed = 1;
+    int threads = 0; /* Size of the thread pool, parallelism_degree by default */
+    const char * csv_file = nullptr;
+    const char * json_file = nullptr;
+    bool is_golden = false;
+};
+
+/* Times of one stage over all seeds */
+struct StageTimes
+{
+    std::string name;
+    std::vector<std::chrono::microseconds> times;
+
+    std::chrono::microseconds Percentile(int percent) const
+    {
+        std::vector<std::chrono::microseconds> sorted = this->times;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size() - 1, sorted.size() * percent / 100)];
+    }
+};
+
+struct BenchResult
+{
+    levelgen::LevelGeneratorType generator;
+    Size size;
+    std::vector<StageTimes> stages; /* Whole generation first, then the stages the generator timed */
+};
+
+static BenchResult RunGenerator(const BenchOptions & options, levelgen::LevelGeneratorType generator, Size size)
+{
+    BenchResult result = {.generator = generator, .size = size, .stages = {StageTimes{.name = "total"}}};
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+    {
+        Random.Seed(seed);
+        Stopwatch<> elapsed;
+        auto generated = levelgen::LevelGenerator::Generate(generator, size);
+        result.stages[0].times.push_back(elapsed.GetElapsed());
+
+        for (const levelgen::GenerationStage & stage : generated.stages)
+        {
+            auto found = std::find_if(result.stages.begin(), result.stages.end(),
+                                      [&stage](const StageTimes & times) { return times.name == stage.name; });
+            if (found == result.stages.end())
+            {
+                result.stages.push_back(StageTimes{.name = stage.name});
+                found = result.stages.end() - 1;
+            }
+            found->times.push_back(stage.time);
+        }
+    }
+    return result;
+}
+
+/* Levels of the 1000x500 default size, generated in any build and on any number of threads */
+struct GoldenLevel
+{
+    levelgen::LevelGeneratorType generator;
+    int seed;
+    std::uint64_t hash;
+};
+
+static constexpr GoldenLevel GoldenLevels[] = {
+    {levelgen::LevelGeneratorType::Toast, 1, 0x3005cf0ab67f9548ull},
+    {levelgen::LevelGeneratorType::Toast, 2, 0x99986574e2a73a17ull},
+    {levelgen::LevelGeneratorType::Toast, 3, 0x12e2666068b6e8d8ull},
+    {levelgen::LevelGeneratorType::Toast, 4, 0x638314a79d76f43cull},
+    {levelgen::LevelGeneratorType::Toast, 5, 0xdb7f84ecb30d4676ull},
+    {levelgen::LevelGeneratorType::Braid, 1, 0x01efec15f3a6a505ull},
+    {levelgen::LevelGeneratorType::Braid, 2, 0xfddd6544a2777375ull},
+    {levelgen::LevelGeneratorType::Braid, 3, 0xa1ff8aded64f9911ull},
+    {levelgen::LevelGeneratorType::Braid, 4, 0x0c6e18144f5e1bb0ull},
+    {levelgen::LevelGeneratorType::Braid, 5, 0x0126f4538957e4a4ull},
+    {levelgen::LevelGeneratorType::Maze, 1, 0x387cf415adadc252ull},
+    {levelgen::LevelGeneratorType::Maze, 2, 0xd7b603c676f322caull},
+    {levelgen::LevelGeneratorType::Maze, 3, 0xf7b87cc3f31406d8ull},
+    {levelgen::LevelGeneratorType::Maze, 4, 0xa82bc5c1a298b8eaull},
+    {levelgen::LevelGeneratorType::Maze, 5, 0xcc40cca792ac4a4eull},
+    {levelgen::LevelGeneratorType::Simple, 1, 0xb45e63871fc0189bull},
+    {levelgen::LevelGeneratorType::Simple, 2, 0xc16dabbb7d04cf6full},
+    {levelgen::LevelGeneratorType::Simple, 3, 0xb649344cb22e7982ull},
+    {levelgen::LevelGeneratorType::Simple, 4, 0x1d0c2070a501db56ull},
+    {levelgen::LevelGeneratorType::Simple, 5, 0x4197e0fcc646f58dull},
+    {levelgen::LevelGeneratorType::Caves, 1, 0x4166ace31cc4ed34ull},
+    {levelgen::LevelGeneratorType::Caves, 2, 0xe3632c49dc3776fcull},
+    {levelgen::LevelGeneratorType::Caves, 3, 0xedbede6439c8358cull},
+    {levelgen::LevelGeneratorType::Caves, 4, 0x539b53085271248bull},
+    {levelgen::LevelGeneratorType::Caves, 5, 0xf66910bb245ec605ull},
+};
+
+/* Returns false when some level hashed differently than GoldenLevels. parallel_for splits work by the worker
+ * count, the toast expansion runs on ThreadPool::Get() started with --threads. */
+static bool CheckGolden()
+{
+    bool is_same = true;
+    for (int workers : {1, 2, 3, 4, 7, 16})
+    {
+        tweak::perf::parallelism_degree = workers;
+        int differ = 0;
+        for (const GoldenLevel & golden : GoldenLevels)
+        {
+            Random.Seed(golden.seed);
+            auto generated = levelgen::LevelGenerator::Generate(golden.generator, Size{1000, 500});
+            std::uint64_t hash = HashLevel(generated.level.get());
+            if (hash == golden.hash)
+                continue;
+            ++differ;
+            std::printf("%-8s seed %d with %d workers hashes to 0x%016llxull instead of 0x%016llxull\n",
+                        levelgen::LevelGenerator::GetName(golden.generator), golden.seed, workers,
+                        static_cast<unsigned long long>(hash), static_cast<unsigned long long>(golden.hash));
+        }
+        std::printf("%2d workers      %d of %d levels differ\n", workers, differ, int(std::size(GoldenLevels)));
+        is_same = is_same && !differ;
+    }
+    return is_same;
+}
+
+static void PrintSummary(const std::vector<BenchResult> & results)
+{
+    std::printf("%-8s %11s  %-16s %12s %12s\n", "level", "size", "stage", "median ms", "p95 ms");
+    for (const BenchResult & result : results)
+        for (const StageTimes & stage : result.stages)
+            std::printf("%-8s %5dx%-5d  %-16s %12.3f %12.3f\n", levelgen::LevelGenerator::GetName(result.generator),
+                        result.size.x, result.size.y, stage.name.c_str(), stage.Percentile(50).count() / 1000.0,
+                        stage.Percentile(95).count() / 1000.0);
+}
+
+static bool WriteCsv(const char * file_name, const std::vector<BenchResult> & results, int seeds)
+{
+    FILE * out = std::fopen(file_name, "w");
+    if (!out)
+        return false;
+    std::fprintf(out, "generator,width,height,seeds,stage,median_ms,p95_ms\n");
+    for (const BenchResult & result : results)
+        for (const StageTimes & stage : result.stages)
+            std::fprintf(out, "%s,%d,%d,%d,%s,%.3f,%.3f\n", levelgen::LevelGenerator::GetName(result.generator),
+                         result.size.x, result.size.y, seeds, stage.name.c_str(),
+                         stage.Percentile(50).count() / 1000.0, stage.Percentile(95).count() / 1000.0);
+    return std::fclose(out) == 0;
+}
+
+static bool WriteJson(const char * file_name, const std::vector<BenchResult> & results, int seeds)
+{
+    FILE * out = std::fopen(file_name, "w");
+    if (!out)
+        return false;
+    std::fprintf(out, "[\n");
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult & result = results[i];
+        std::fprintf(out, "  {\"generator\": \"%s\", \"width\": %d, \"height\": %d, \"seeds\": %d, \"stages\": {",
+                     levelgen::LevelGenerator::GetName(result.generator), result.size.x, result.size.y, seeds);
+        for (std::size_t s = 0; s < result.stages.size(); ++s)
+            std::fprintf(out, "%s\"%s\": {\"median_ms\": %.3f, \"p95_ms\": %.3f}", s ? ", " : "",
+                         result.stages[s].name.c_str(), result.stages[s].Percentile(50).count() / 1000.0,
+                         result.stages[s].Percentile(95).count() / 1000.0);
+        std::fprintf(out, "}}%s\n", i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "]\n");
+    return std::fclose(out) == 0;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--golden", argv[i]))
+            options.is_golden = true;
+        else if (!strcmp("--level", argv[i]) && i + 1 < argc &&
+            levelgen::LevelGenerator::FromName(argv[i + 1]) != levelgen::LevelGeneratorType::None)
+            options.generators.push_back(levelgen::LevelGenerator::FromName(argv[++i]));
+        else if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.sizes.push_back(Size{atoi(argv[i + 1]), atoi(argv[i + 2])});
+            i += 2;
+        }
+        else if (!strcmp("--seeds", argv[i]) && i + 1 < argc)
+            options.seeds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.first_seed = atoi(argv[++i]);
+        else if (!strcmp("--threads", argv[i]) && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else if (!strcmp("--csv", argv[i]) && i + 1 < argc)
+            options.csv_file = argv[++i];
+        else if (!strcmp("--json", argv[i]) && i + 1 < argc)
+            options.json_file = argv[++i];
+        else
+        {
+            std::printf("Usage: %s [--level <GEN>]... [--size <W> <H>]... [--seeds <N>] [--seed <first seed>] "
+                        "[--threads <N>] [--csv <FILE>] [--json <FILE>] [--golden]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    if (options.generators.empty())
+        options.generators = {levelgen::LevelGeneratorType::Toast, levelgen::LevelGeneratorType::Braid,
+                              levelgen::LevelGeneratorType::Maze, levelgen::LevelGeneratorType::Simple,
+                              levelgen::LevelGeneratorType::Caves};
+    if (options.sizes.empty())
+        options.sizes = {Size{1000, 500}, Size{1500, 750}};
+    if (options.threads > 0)
+        tweak::perf::parallelism_degree = options.threads;
+    if (options.is_golden)
+    {
+        /* Start the pool with --threads workers before CheckGolden changes the worker counts */
+        ThreadPool::Get();
+        return CheckGolden() ? 0 : 1;
+    }
+
+    std::vector<BenchResult> results;
+    for (levelgen::LevelGeneratorType generator : options.generators)
+        for (Size size : options.sizes)
+            results.push_back(RunGenerator(options, generator, size));
+
+    std::printf("\n%d seeds from %d\n", options.seeds, options.first_seed);
+    PrintSummary(results);
+    if (options.csv_file && !WriteCsv(options.csv_file, results, options.seeds))
+    {
+        std::printf("Failed to write %s\n", options.csv_file);
+        return 1;
+    }
+    if (options.json_file && !WriteJson(options.json_file, results, options.seeds))
+    {
+        std::printf("Failed to write %s\n", options.json_file);
+        return 1;
+    }
+    return 0;
+}
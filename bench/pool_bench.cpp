@@ -0,0 +1,159 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <vector>
+
+#include "job_graph.h"
+#include "parallelism.h"
+#include "random.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "world.h"
+
+/*
+ * Fork/join overhead benchmark
+ *  Runs parallel_for over jobs doing next to nothing, so the time per call is the cost of slicing the range,
+ *  handing the jobs out and waiting for them. Compared against launching every job with std::async,
+ *  the way parallel_for worked before the pool. Nested calls check that jobs waiting on jobs make progress.
+ *  A job graph with the jobs of a World tick is compared against calling its jobs one after another.
+ */
+
+struct BenchOptions
+{
+    int calls = 20000;
+    int workers = 0; /* parallelism_degree */
+    int work = 0;    /* Loop iterations per range element */
+};
+
+/* Keeps the optimizer from dropping the job bodies */
+static int Work(int first, int last, int work)
+{
+    int sum = 0;
+    for (int i = first; i <= last; ++i)
+        for (int j = 0; j < work + 1; ++j)
+            sum += (i * 31 + j) & 7;
+    return sum;
+}
+
+template <typename Func>
+auto async_for(Func func, int minimum, int maximum, WorkerCount worker_count)
+    -> std::invoke_result_t<Func, int, int, ThreadLocal *>
+{
+    auto threadLocals = std::vector<ThreadLocal>();
+    using Result = std::invoke_result_t<Func, int, int, ThreadLocal *>;
+    auto tasks = std::vector<std::future<Result>>();
+    threadLocals.reserve(worker_count);
+    tasks.reserve(worker_count);
+
+    int curr = minimum;
+    for (int i = 0; i < worker_count; ++i)
+    {
+        if (curr <= maximum)
+        {
+            int until = curr + (maximum - minimum) / worker_count;
+            threadLocals.emplace_back();
+            tasks.emplace_back(std::async(std::launch::async, func, curr, std::min(maximum, until), &threadLocals[i]));
+            curr = until + 1;
+        }
+    }
+    auto result = Result{};
+    for (auto & task : tasks)
+        result += task.get();
+    return result;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--calls", argv[i]) && i + 1 < argc)
+            options.calls = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--workers", argv[i]) && i + 1 < argc)
+            options.workers = atoi(argv[++i]);
+        else if (!strcmp("--work", argv[i]) && i + 1 < argc)
+            options.work = std::max(0, atoi(argv[++i]));
+        else
+        {
+            std::printf("Usage: %s [--calls <N>] [--workers <N>] [--work <iterations per element>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (options.workers > 0)
+        tweak::perf::parallelism_degree = options.workers;
+    const int workers = tweak::perf::parallelism_degree;
+    const int range = workers * 16;
+    const int work = options.work;
+    auto job = [work](int first, int last, ThreadLocal *) { return Work(first, last, work); };
+
+    /* Start the pool outside of the measurement */
+    const int expected = parallel_for(job, 0, range - 1);
+
+    int mismatches = 0;
+    Stopwatch<> pool_time;
+    for (int call = 0; call < options.calls; ++call)
+        mismatches += parallel_for(job, 0, range - 1) != expected;
+    auto pool_elapsed = pool_time.GetElapsed();
+
+    Stopwatch<> async_time;
+    for (int call = 0; call < options.calls; ++call)
+        mismatches += async_for(job, 0, range - 1, WorkerCount{}) != expected;
+    auto async_elapsed = async_time.GetElapsed();
+
+    /* Every outer job forks and joins again from inside of the pool */
+    auto nested_job = [&job, range](int first, int last, ThreadLocal *) {
+        int sum = 0;
+        for (int i = first; i <= last; ++i)
+            sum += parallel_for(job, 0, range - 1);
+        return sum;
+    };
+    const int nested_calls = std::max(1, options.calls / range);
+    Stopwatch<> nested_time;
+    for (int call = 0; call < nested_calls; ++call)
+        mismatches += parallel_for(nested_job, 0, range - 1) != expected * range;
+    auto nested_elapsed = nested_time.GetElapsed();
+
+    /* The jobs of a World tick with their declarations, doing a range worth of work each */
+    constexpr int tick_job_count = int(std::size(World::TickJobs));
+    int tick_sums[tick_job_count] = {};
+    JobGraph tick_jobs;
+    for (int i = 0; i < tick_job_count; ++i)
+    {
+        auto tick_job = [&tick_sums, i, range, work]() { tick_sums[i] = Work(0, range - 1, work); };
+        tick_jobs.Add(World::TickJobs[i].name, World::TickJobs[i].access, tick_job);
+    }
+
+    tick_jobs.Run();
+    Stopwatch<> graph_time;
+    for (int call = 0; call < options.calls; ++call)
+    {
+        tick_jobs.Run();
+        for (int sum : tick_sums)
+            mismatches += sum != expected;
+    }
+    auto graph_elapsed = graph_time.GetElapsed();
+
+    Stopwatch<> serial_time;
+    for (int call = 0; call < options.calls; ++call)
+    {
+        for (int i = 0; i < tick_job_count; ++i)
+            tick_sums[i] = Work(0, range - 1, work);
+        for (int sum : tick_sums)
+            mismatches += sum != expected;
+    }
+    auto serial_elapsed = serial_time.GetElapsed();
+
+    auto per_call = [](std::chrono::microseconds elapsed, int calls) { return double(elapsed.count()) / calls; };
+    std::printf("%d workers (%d pool threads), %d calls over %d elements, %d iterations each\n", workers,
+                ThreadPool::Get().GetThreadCount(), options.calls, range, work + 1);
+    std::printf("thread pool  %9.3f us per call\nstd::async   %9.3f us per call\nnested pool  %9.3f us per call\n",
+                per_call(pool_elapsed, options.calls), per_call(async_elapsed, options.calls),
+                per_call(nested_elapsed, nested_calls * (range + 1)));
+    std::printf("tick graph   %9.3f us per run\ntick serial  %9.3f us per run\n",
+                per_call(graph_elapsed, options.calls), per_call(serial_elapsed, options.calls));
+    if (mismatches)
+        std::printf("%d calls returned a wrong sum\n", mismatches);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench_util.h"
+#include "level.h"
+#include "level_provider.h"
+#include "levelgen.h"
+#include "random.h"
+#include "trace.h"
+#include "tweak.h"
+
+/*
+ * Level provider benchmark
+ *  Generates every requested generator and seed in the foreground the way Game does without a provider, then
+ *  queues the same requests on a LevelProvider and takes them. A level taken from the provider has to hash the
+ *  same as the one the seed gives in the foreground. Reports how long each took and how long Take waited.
+ */
+
+struct BenchOptions
+{
+    std::vector<levelgen::LevelGeneratorType> generators;
+    Size size = {1000, 500};
+    int seeds = 3;
+    int first_seed = 1;
+    int threads = 0; /* Workers of the provider pool, parallelism_degree by default */
+};
+
+struct LevelResult
+{
+    std::uint64_t hash = 0;
+    std::chrono::microseconds elapsed = {};
+};
+
+static LevelResult GenerateForeground(levelgen::LevelGeneratorType generator, Size size, int seed)
+{
+    Random.Seed(seed);
+    Stopwatch<> elapsed;
+    std::unique_ptr<Level> level = levelgen::LevelGenerator::Generate(generator, size).level;
+    level->MaterializeLevelTerrainAndBases();
+    return LevelResult{.hash = HashLevel(level.get()), .elapsed = elapsed.GetElapsed()};
+}
+
+/* Returns false when some level taken from the provider differs from its foreground level */
+static bool RunGenerator(const BenchOptions & options, levelgen::LevelGeneratorType generator)
+{
+    std::vector<LevelResult> foreground;
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+        foreground.push_back(GenerateForeground(generator, options.size, seed));
+
+    LevelProviderConfig config;
+    if (options.threads > 0)
+        config.thread_count = options.threads;
+    LevelProvider provider(config);
+    for (int seed = options.first_seed; seed < options.first_seed + options.seeds; ++seed)
+        provider.Queue({.generator = generator, .size = options.size, .seed = seed});
+
+    bool is_same = true;
+    for (int i = 0; i < options.seeds; ++i)
+    {
+        Stopwatch<> take_time;
+        std::unique_ptr<Level> level = provider.Take();
+        auto take_elapsed = take_time.GetElapsed();
+        std::uint64_t hash = HashLevel(level.get());
+
+        is_same = is_same && hash == foreground[i].hash;
+        std::printf("%-8s seed %-4d foreground %9.3f ms   take waited %9.3f ms   hash %016llx%s\n",
+                    levelgen::LevelGenerator::GetName(generator), options.first_seed + i,
+                    foreground[i].elapsed.count() / 1000.0, take_elapsed.count() / 1000.0,
+                    static_cast<unsigned long long>(hash), hash == foreground[i].hash ? "" : "   DIFFERS");
+    }
+    return is_same;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--level", argv[i]) && i + 1 < argc &&
+            levelgen::LevelGenerator::FromName(argv[i + 1]) != levelgen::LevelGeneratorType::None)
+            options.generators.push_back(levelgen::LevelGenerator::FromName(argv[++i]));
+        else if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--seeds", argv[i]) && i + 1 < argc)
+            options.seeds = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.first_seed = atoi(argv[++i]);
+        else if (!strcmp("--threads", argv[i]) && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--level <GEN>]... [--size <W> <H>] [--seeds <N>] [--seed <first seed>] "
+                        "[--threads <N>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    if (options.generators.empty())
+        options.generators = {levelgen::LevelGeneratorType::Toast, levelgen::LevelGeneratorType::Braid,
+                              levelgen::LevelGeneratorType::Maze, levelgen::LevelGeneratorType::Simple,
+                              levelgen::LevelGeneratorType::Caves};
+
+    bool is_same = true;
+    for (levelgen::LevelGeneratorType generator : options.generators)
+        is_same = RunGenerator(options, generator) && is_same;
+    return is_same ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "level.h"
+#include "level_pixel.h"
+#include "levelgen.h"
+#include "random.h"
+#include "raycaster.h"
+#include "trace.h"
+
+/*
+ * Terrain line of sight benchmark
+ *  Casts rays between random pairs of blank pixels, the way links test their connections, once through
+ *  Raycaster::Cast reading pixel by pixel and once through the row spans of Level::FirstCollisionAlongRay.
+ */
+
+struct BenchOptions
+{
+    Size size = {1500, 750};
+    int rays = 200000;
+    int max_length = 300;
+    int digs = 20000;
+    int seed = 1;
+};
+
+struct Ray
+{
+    Position from;
+    Position to;
+};
+
+static bool IsBlockedByPixels(const Level * level, Position from, Position to)
+{
+    return !Raycaster::Cast(PositionF{from}, PositionF{to}, [level](PositionF tested_pos, PositionF) {
+        return !Pixel::IsAnyCollision(level->GetPixel(tested_pos.ToIntPosition()));
+    });
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--rays", argv[i]) && i + 1 < argc)
+            options.rays = atoi(argv[++i]);
+        else if (!strcmp("--length", argv[i]) && i + 1 < argc)
+            options.max_length = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--digs", argv[i]) && i + 1 < argc)
+            options.digs = atoi(argv[++i]);
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.seed = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>] [--rays <N>] [--length <max ray length>] [--digs <N>] "
+                        "[--seed <INT>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Toast, options.size);
+    Level * level = generated.level.get();
+    level->MaterializeLevelTerrainAndBases();
+
+    /* Tunnels, so that a good share of the rays gets through */
+    RandomGenerator random;
+    random.Seed(options.seed);
+    for (int dig = 0; dig < options.digs; ++dig)
+    {
+        Position pos = {random.Int(4, options.size.x - 45), random.Int(4, options.size.y - 19)};
+        for (int step = 0; step < 40; ++step)
+            level->DigTankTunnel(pos + Offset{step, step / 3}, false);
+    }
+
+    std::vector<Ray> rays;
+    while (int(rays.size()) < options.rays)
+    {
+        Position from = {random.Int(0, options.size.x - 1), random.Int(0, options.size.y - 1)};
+        Position to = from + Offset{random.Int(-options.max_length, options.max_length),
+                                    random.Int(-options.max_length, options.max_length)};
+        if (level->IsInBounds(to) && level->GetPixel(from) == LevelPixel::Blank &&
+            level->GetPixel(to) == LevelPixel::Blank)
+            rays.push_back(Ray{from, to});
+    }
+
+    std::vector<char> blocked_by_pixels(rays.size()), blocked_by_spans(rays.size());
+    Stopwatch<> pixels_time;
+    for (std::size_t i = 0; i < rays.size(); ++i)
+        blocked_by_pixels[i] = IsBlockedByPixels(level, rays[i].from, rays[i].to);
+    auto pixels_elapsed = pixels_time.GetElapsed();
+
+    Stopwatch<> spans_time;
+    for (std::size_t i = 0; i < rays.size(); ++i)
+        blocked_by_spans[i] = level->FirstCollisionAlongRay(PositionF{rays[i].from}, PositionF{rays[i].to}).has_value();
+    auto spans_elapsed = spans_time.GetElapsed();
+
+    int blocked = 0, differ = 0;
+    for (std::size_t i = 0; i < rays.size(); ++i)
+    {
+        blocked += blocked_by_spans[i];
+        differ += blocked_by_pixels[i] != blocked_by_spans[i];
+    }
+
+    std::printf("Level %dx%d, %d rays up to %d pixels, %d blocked\n", options.size.x, options.size.y,
+                int(rays.size()), options.max_length, blocked);
+    std::printf("raycaster  %9.3f ms\nrow spans  %9.3f ms\n", pixels_elapsed.count() / 1000.0,
+                spans_elapsed.count() / 1000.0);
+    /* Spans test every pixel the segment touches, the raycaster samples one point per step.
+     * They can disagree on rays that only graze the corner of a pixel. */
+    std::printf("differing  %d (%.3f%%)\n", differ, 100.0 * differ / std::max<std::size_t>(1, rays.size()));
+    return 0;
+}
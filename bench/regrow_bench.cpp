@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "bench_util.h"
+#include "level.h"
+#include "level_regrowth.h"
+#include "level_snapshot.h"
+#include "levelgen.h"
+#include "random.h"
+#include "trace.h"
+#include "tweak.h"
+
+/*
+ * Dirt regrowth benchmark
+ *  Generates the same level for each neighbor count source, then alternates tank digging with regrowth passes
+ *  and reports how long the passes take.
+ *  Then plays the same digging tick by tick with a full pass every DirtRecoverInterval and with a slice of the
+ *  level every tick, and reports per-tick regrowth times.
+ *  Last, repeats the same digging on one level for several worker counts, regrown by full passes and by slices
+ *  with the default and with a tight budget, and checks that each schedule ends with the same terrain on all of
+ *  them.
+ */
+
+struct BenchOptions
+{
+    Size size = {1500, 750};
+    int passes = 200;
+    int digs_per_pass = 20;
+    int seed = 1;
+    int workers = 0;
+    int threads = 0; /* Size of the thread pool, parallelism_degree by default */
+};
+
+struct BenchResult
+{
+    std::chrono::microseconds first_pass = {};
+    std::chrono::microseconds passes = {};
+    RegrowStats stats;
+};
+
+static BenchResult RunRegrow(const BenchOptions & options, RegrowNeighborSource source)
+{
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Toast, options.size);
+    Level * level = generated.level.get();
+    level->MaterializeLevelTerrainAndBases();
+
+    WorkerCount worker_count = options.workers ? WorkerCount{options.workers} : WorkerCount{};
+    LevelRegrowth regrowth(level, source);
+    RandomGenerator dig_random;
+    dig_random.Seed(options.seed);
+
+    BenchResult result;
+    Stopwatch<> first_pass;
+    regrowth.Pass(worker_count);
+    result.first_pass = first_pass.GetElapsed();
+
+    for (int pass = 0; pass < options.passes; ++pass)
+    {
+        for (int dig = 0; dig < options.digs_per_pass; ++dig)
+            level->DigTankTunnel(Position{dig_random.Int(4, options.size.x - 5), dig_random.Int(4, options.size.y - 5)},
+                                 false);
+
+        Stopwatch<> elapsed;
+        result.stats += regrowth.Pass(worker_count);
+        result.passes += elapsed.GetElapsed();
+        level->CommitChangedTiles();
+    }
+    return result;
+}
+
+struct ScheduleResult
+{
+    std::vector<std::chrono::microseconds> ticks;
+    RegrowStats stats;
+};
+
+static ScheduleResult RunSchedule(const BenchOptions & options, bool is_sliced)
+{
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Toast, options.size);
+    Level * level = generated.level.get();
+    level->MaterializeLevelTerrainAndBases();
+
+    WorkerCount worker_count = options.workers ? WorkerCount{options.workers} : WorkerCount{};
+    LevelRegrowth regrowth(level);
+    RandomGenerator dig_random;
+    dig_random.Seed(options.seed);
+
+    const int ticks_per_pass = int(std::chrono::microseconds{tweak::world::DirtRecoverInterval} /
+                                   tweak::world::AdvanceStep);
+    ScheduleResult result;
+    std::chrono::microseconds now = {};
+    for (int tick = 0; tick < options.passes * ticks_per_pass; ++tick)
+    {
+        now += tweak::world::AdvanceStep;
+        if (tick % ticks_per_pass == 0)
+            for (int dig = 0; dig < options.digs_per_pass; ++dig)
+                level->DigTankTunnel(
+                    Position{dig_random.Int(4, options.size.x - 5), dig_random.Int(4, options.size.y - 5)}, false);
+
+        Stopwatch<> elapsed;
+        if (is_sliced)
+            result.stats += regrowth.PassSlice(now, tweak::world::DirtRegrowSlices, tweak::world::DirtRegrowTickBudget,
+                                               worker_count);
+        else if (tick % ticks_per_pass == ticks_per_pass - 1)
+            result.stats += regrowth.Pass(worker_count);
+        level->CommitChangedTiles();
+        result.ticks.push_back(elapsed.GetElapsed());
+    }
+    return result;
+}
+
+static void PrintSchedule(const char * name, ScheduleResult result)
+{
+    std::sort(result.ticks.begin(), result.ticks.end());
+    std::chrono::microseconds total = {};
+    for (auto tick : result.ticks)
+        total += tick;
+    auto percentile = [&result](int percent) {
+        return result.ticks[std::min(result.ticks.size() - 1, result.ticks.size() * percent / 100)];
+    };
+    std::printf("%-16s tick average %7.3f ms   p50 %7.3f ms   p99 %7.3f ms   max %7.3f ms   decayed %8d   grown %8d\n",
+                name, total.count() / 1000.0 / std::max<std::size_t>(1, result.ticks.size()),
+                percentile(50).count() / 1000.0, percentile(99).count() / 1000.0,
+                result.ticks.back().count() / 1000.0, result.stats.holes_decayed, result.stats.dirt_grown);
+}
+
+/* Digging of the determinism check, regrown by a full pass per DirtRecoverInterval, or by a slice every tick
+ * when slice_budget is set */
+static void ReplayRegrowth(Level * level, const BenchOptions & options, std::optional<int> slice_budget, int workers)
+{
+    Random.Seed(options.seed);
+    LevelRegrowth regrowth(level);
+    RandomGenerator dig_random;
+    dig_random.Seed(options.seed);
+
+    const int ticks_per_pass = int(std::chrono::microseconds{tweak::world::DirtRecoverInterval} /
+                                   tweak::world::AdvanceStep);
+    std::chrono::microseconds now = {};
+    for (int pass = 0; pass < options.passes; ++pass)
+    {
+        for (int dig = 0; dig < options.digs_per_pass; ++dig)
+            level->DigTankTunnel(
+                Position{dig_random.Int(4, options.size.x - 5), dig_random.Int(4, options.size.y - 5)}, false);
+        if (!slice_budget)
+        {
+            regrowth.Pass(WorkerCount{workers});
+            level->CommitChangedTiles();
+            continue;
+        }
+        for (int tick = 0; tick < ticks_per_pass; ++tick)
+        {
+            now += tweak::world::AdvanceStep;
+            regrowth.PassSlice(now, tweak::world::DirtRegrowSlices, *slice_budget, WorkerCount{workers});
+            level->CommitChangedTiles();
+        }
+    }
+}
+
+/* Returns false when some worker count ended with different terrain */
+static bool CheckDeterminism(const BenchOptions & options)
+{
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Toast, options.size);
+    Level * level = generated.level.get();
+    level->MaterializeLevelTerrainAndBases();
+    auto generated_terrain = level->TakeSnapshot();
+
+    /* A budget of one tile ends nearly every slice early */
+    const std::pair<const char *, std::optional<int>> schedules[] = {
+        {"full pass", std::nullopt}, {"sliced", tweak::world::DirtRegrowTickBudget}, {"sliced, budget 1", 1}};
+    bool is_same = true;
+    for (const auto & [name, slice_budget] : schedules)
+    {
+        std::uint64_t first_hash = 0;
+        for (int workers : {1, 2, 3, 4, 7, 16})
+        {
+            level->RestoreSnapshot(*generated_terrain);
+            ReplayRegrowth(level, options, slice_budget, workers);
+
+            std::uint64_t hash = HashLevel(level);
+            first_hash = first_hash ? first_hash : hash;
+            is_same = is_same && hash == first_hash;
+            std::printf("%-16s %2d workers   terrain hash %016llx%s\n", name, workers,
+                        static_cast<unsigned long long>(hash), hash == first_hash ? "" : "   DIFFERS");
+        }
+    }
+    return is_same;
+}
+
+static void PrintResult(const char * name, const BenchOptions & options, const BenchResult & result)
+{
+    auto average = result.passes / std::max(1, options.passes);
+    std::printf("%-16s first pass %7.3f ms   average pass %7.3f ms   active tiles %7.1f   decayed %8d   grown %8d\n",
+                name, result.first_pass.count() / 1000.0, average.count() / 1000.0,
+                double(result.stats.tiles_active) / std::max(1, options.passes), result.stats.holes_decayed,
+                result.stats.dirt_grown);
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--passes", argv[i]) && i + 1 < argc)
+            options.passes = atoi(argv[++i]);
+        else if (!strcmp("--digs", argv[i]) && i + 1 < argc)
+            options.digs_per_pass = atoi(argv[++i]);
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.seed = atoi(argv[++i]);
+        else if (!strcmp("--workers", argv[i]) && i + 1 < argc)
+            options.workers = atoi(argv[++i]);
+        else if (!strcmp("--threads", argv[i]) && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>] [--passes <N>] [--digs <N per pass>] [--seed <INT>] "
+                        "[--workers <N>] [--threads <N>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    if (options.threads > 0)
+        tweak::perf::parallelism_degree = options.threads;
+
+    std::printf("Level %dx%d, %d passes, %d digs per pass, seed %d\n", options.size.x, options.size.y,
+                options.passes, options.digs_per_pass, options.seed);
+    PrintResult("bit planes", options, RunRegrow(options, RegrowNeighborSource::BitPlanes));
+    PrintResult("adjacency cache", options, RunRegrow(options, RegrowNeighborSource::AdjacencyCache));
+    PrintSchedule("full pass", RunSchedule(options, false));
+    PrintSchedule("sliced", RunSchedule(options, true));
+    return CheckDeterminism(options) ? 0 : 1;
+}
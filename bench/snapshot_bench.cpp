@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "level.h"
+#include "level_pixel.h"
+#include "levelgen.h"
+#include "random.h"
+#include "trace.h"
+
+/*
+ * Level snapshot benchmark
+ *  Compares copy-on-write tile snapshots with a full copy of the level data: time and memory to take one,
+ *  memory held after a number of frames of digging, the write overhead while a snapshot is live
+ *  and the time to roll the level back.
+ */
+
+struct BenchOptions
+{
+    Size size = {1500, 750};
+    int repeats = 50;
+    int frames = 100;
+    int digs_per_frame = 20;
+    int seed = 1;
+};
+
+static double ToMilliseconds(std::chrono::microseconds duration) { return duration.count() / 1000.0; }
+static double ToMegabytes(std::size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+static levelgen::GeneratedLevel GenerateLevel(const BenchOptions & options)
+{
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Toast, options.size);
+    generated.level->MaterializeLevelTerrainAndBases();
+    return generated;
+}
+
+/* Dig with the same random sequence every time it is called */
+static std::chrono::microseconds DigFrames(Level * level, const BenchOptions & options)
+{
+    RandomGenerator dig_random;
+    dig_random.Seed(options.seed);
+
+    Stopwatch<> elapsed;
+    for (int frame = 0; frame < options.frames; ++frame)
+        for (int dig = 0; dig < options.digs_per_frame; ++dig)
+            level->DigTankTunnel(Position{dig_random.Int(4, options.size.x - 5), dig_random.Int(4, options.size.y - 5)},
+                                 false);
+    return elapsed.GetElapsed();
+}
+
+static bool HaveSamePlanes(const Level * level, const Level * other)
+{
+    const LevelBitPlanes & planes = level->GetPlanes();
+    for (int plane = 0; plane < LevelBitPlanes::PlaneCount; ++plane)
+        for (int y = 0; y < level->GetSize().y; ++y)
+        {
+            const LevelBitPlanes::Word * row = planes.GetRow(LevelPlane(plane), y);
+            if (!std::equal(row, row + planes.GetWordsPerRow(), other->GetPlanes().GetRow(LevelPlane(plane), y)))
+                return false;
+        }
+    return true;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--repeats", argv[i]) && i + 1 < argc)
+            options.repeats = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--frames", argv[i]) && i + 1 < argc)
+            options.frames = atoi(argv[++i]);
+        else if (!strcmp("--digs", argv[i]) && i + 1 < argc)
+            options.digs_per_frame = atoi(argv[++i]);
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.seed = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>] [--repeats <N>] [--frames <N>] [--digs <N per frame>] "
+                        "[--seed <INT>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("Level %dx%d, %d frames, %d digs per frame, seed %d\n", options.size.x, options.size.y,
+                options.frames, options.digs_per_frame, options.seed);
+
+    /* Digging into a level nobody holds a snapshot of */
+    auto reference = GenerateLevel(options);
+    auto without_snapshot = DigFrames(reference.level.get(), options);
+
+    auto generated = GenerateLevel(options);
+    Level * level = generated.level.get();
+    const Container2D<LevelPixel> & data = level->GetLevelData();
+
+    /* Taking one */
+    std::vector<LevelPixel> full_copy;
+    Stopwatch<> full_copy_time;
+    for (int i = 0; i < options.repeats; ++i)
+        full_copy.assign(data.cbegin(), data.cend());
+    auto full_copy_average = full_copy_time.GetElapsed() / options.repeats;
+
+    Stopwatch<> snapshot_time;
+    for (int i = 0; i < options.repeats; ++i)
+        level->TakeSnapshot();
+    auto snapshot_average = snapshot_time.GetElapsed() / options.repeats;
+
+    auto snapshot = level->TakeSnapshot();
+    std::printf("take       full copy %9.3f ms %9.3f MB   snapshot %9.3f ms %9.3f MB\n",
+                ToMilliseconds(full_copy_average), ToMegabytes(full_copy.size() * sizeof(LevelPixel)),
+                ToMilliseconds(snapshot_average), ToMegabytes(snapshot->GetMemoryUsage()));
+
+    /* Digging while the snapshot is live */
+    auto with_snapshot = DigFrames(level, options);
+    std::printf("dig      no snapshot %9.3f ms                snapshot %9.3f ms %9.3f MB   %d of %d tiles copied\n",
+                ToMilliseconds(without_snapshot), ToMilliseconds(with_snapshot), ToMegabytes(snapshot->GetMemoryUsage()),
+                snapshot->GetPreservedTileCount(), level->GetTiles().GetTileTotal());
+
+    /* Rolling back. The reference level went through the same digging without a snapshot, so it is rolled
+     * back from the full copy. Both ways leave the bit planes and adjacency valid and the surface uncommitted. */
+    Stopwatch<> full_restore_time;
+    reference.level->RestoreLevelData(full_copy);
+    auto full_restore = full_restore_time.GetElapsed();
+
+    Stopwatch<> snapshot_restore_time;
+    int restored_tiles = level->RestoreSnapshot(*snapshot);
+    auto snapshot_restore = snapshot_restore_time.GetElapsed();
+
+    bool is_identical = std::equal(full_copy.begin(), full_copy.end(), data.cbegin()) &&
+                        std::equal(full_copy.begin(), full_copy.end(), reference.level->GetLevelData().cbegin()) &&
+                        HaveSamePlanes(level, reference.level.get());
+    std::printf("restore  full copy %9.3f ms                  snapshot %9.3f ms   %d tiles, %s\n",
+                ToMilliseconds(full_restore), ToMilliseconds(snapshot_restore), restored_tiles,
+                is_identical ? "identical" : "DIFFERENT");
+    return is_identical ? 0 : 1;
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "bench_util.h"
+#include "level.h"
+#include "levelgen.h"
+#include "random.h"
+#include "trace.h"
+#include "tweak.h"
+
+/*
+ * Streamed level benchmark
+ *  Times the start of a caves level streamed against generated whole, for growing level sizes. Whole levels are
+ *  only generated up to --full-limit pixels.
+ *  Then walks a digging tank across a streamed level, materializing tiles around it every step and evicting
+ *  the far ones every --evict-steps steps, and reports the per-step times and the tiles held.
+ *  Last, digs the same tunnels into a level streamed in the opposite order and never evicted, and checks that
+ *  both end with the same terrain.
+ */
+
+struct BenchOptions
+{
+    std::vector<Size> sizes;
+    Size walk_size = {16384, 16384};
+    int steps = 4000;
+    int evict_steps = 100;
+    int seed = 1;
+    long long full_limit = 4096ll * 4096;
+    int threads = 0; /* Size of the thread pool, parallelism_degree by default */
+};
+
+static Rect Around(Position pos, int margin)
+{
+    return Rect{pos - Size{margin, margin}, Size{2 * margin + 1, 2 * margin + 1}};
+}
+
+static void RunStartup(const BenchOptions & options, Size size)
+{
+    Random.Seed(options.seed);
+    Stopwatch<> streamed_elapsed;
+    auto streamed = levelgen::LevelGenerator::GenerateStreamed(levelgen::LevelGeneratorType::Caves, size);
+    streamed.level->MaterializeLevelTerrainAndBases();
+    auto streamed_time = streamed_elapsed.GetElapsed();
+    LevelStreamStats stats = streamed.level->GetStreamStats();
+
+    std::chrono::microseconds whole_time = {};
+    if (std::int64_t(size.x) * size.y <= options.full_limit)
+    {
+        Random.Seed(options.seed);
+        Stopwatch<> whole_elapsed;
+        auto whole = levelgen::LevelGenerator::Generate(levelgen::LevelGeneratorType::Caves, size);
+        whole.level->MaterializeLevelTerrainAndBases();
+        whole_time = whole_elapsed.GetElapsed();
+    }
+
+    std::printf("%6dx%-6d  streamed %9.3f ms  %6d of %8d tiles", size.x, size.y, streamed_time.count() / 1000.0,
+                stats.resident_tiles, streamed.level->GetTiles().GetTileTotal());
+    if (whole_time.count())
+        std::printf("   whole %9.3f ms", whole_time.count() / 1000.0);
+    std::printf("\n");
+}
+
+/* Positions of a tank that wanders away from the first base and keeps digging */
+static std::vector<Position> MakeWalk(const BenchOptions & options, Position start)
+{
+    RandomGenerator walk_random;
+    walk_random.Seed(options.seed);
+    std::vector<Position> walk;
+    Position pos = start;
+    Offset heading = {1, 1};
+    for (int step = 0; step < options.steps; ++step)
+    {
+        if (walk_random.Bool(50))
+            heading = Offset{walk_random.Int(-1, 1), walk_random.Int(-1, 1)};
+        pos = Position{std::clamp(pos.x + 3 * heading.x, 16, options.walk_size.x - 17),
+                       std::clamp(pos.y + 3 * heading.y, 16, options.walk_size.y - 17)};
+        walk.push_back(pos);
+    }
+    return walk;
+}
+
+/* Returns false when the walked level ended different from the one that was never evicted */
+static bool RunWalk(const BenchOptions & options)
+{
+    Random.Seed(options.seed);
+    auto generated = levelgen::LevelGenerator::GenerateStreamed(levelgen::LevelGeneratorType::Caves, options.walk_size);
+    Level * level = generated.level.get();
+    level->MaterializeLevelTerrainAndBases();
+    const std::vector<Position> walk = MakeWalk(options, level->GetSpawns()[0].GetPosition());
+
+    std::vector<std::chrono::microseconds> step_times;
+    Position min = walk[0], max = walk[0];
+    int peak_resident = 0;
+    for (std::size_t step = 0; step < walk.size(); ++step)
+    {
+        Stopwatch<> elapsed;
+        level->MaterializeTiles(Around(walk[step], tweak::world::StreamTankMargin));
+        level->DigTankTunnel(walk[step], false);
+        if (step % options.evict_steps == options.evict_steps - 1)
+            level->EvictTiles({Around(walk[step], tweak::world::StreamEvictMargin)});
+        step_times.push_back(elapsed.GetElapsed());
+
+        peak_resident = std::max(peak_resident, level->GetStreamStats().resident_tiles);
+        min = Position{std::min(min.x, walk[step].x), std::min(min.y, walk[step].y)};
+        max = Position{std::max(max.x, walk[step].x), std::max(max.y, walk[step].y)};
+    }
+
+    std::sort(step_times.begin(), step_times.end());
+    LevelStreamStats stats = level->GetStreamStats();
+    std::printf("\nWalk of %d steps over %dx%d, evicting every %d steps\n", options.steps, options.walk_size.x,
+                options.walk_size.y, options.evict_steps);
+    std::printf("step p50 %7.3f ms   p99 %7.3f ms   max %7.3f ms\n", step_times[step_times.size() / 2].count() / 1000.0,
+                step_times[step_times.size() * 99 / 100].count() / 1000.0, step_times.back().count() / 1000.0);
+    std::printf("resident %d tiles (peak %d), evicted with changes %d tiles in %lld kB, %d materialized, %d evicted\n",
+                stats.resident_tiles, peak_resident, stats.evicted_tiles,
+                static_cast<long long>(stats.evicted_bytes / 1024), stats.materialized, stats.evictions);
+
+    /* Same digging on a level streamed from the far corner of the walk, tile by tile and never evicted */
+    Random.Seed(options.seed);
+    auto reference = levelgen::LevelGenerator::GenerateStreamed(levelgen::LevelGeneratorType::Caves, options.walk_size);
+    reference.level->MaterializeLevelTerrainAndBases();
+    const Rect walked = Rect{min, Size{max.x - min.x + 1, max.y - min.y + 1}};
+    for (int y = walked.Bottom() + tweak::world::StreamTankMargin; y >= walked.Top() - tweak::world::StreamTankMargin;
+         y -= LevelTiles::TileSize)
+        for (int x = walked.Right() + tweak::world::StreamTankMargin;
+             x >= walked.Left() - tweak::world::StreamTankMargin; x -= LevelTiles::TileSize)
+            reference.level->MaterializeTiles(Rect{Position{x, y}, Size{1, 1}});
+    for (Position pos : walk)
+        reference.level->DigTankTunnel(pos, false);
+
+    const Rect hashed = Rect{walked.pos - Size{8, 8}, Size{walked.size.x + 16, walked.size.y + 16}};
+    level->MaterializeTiles(hashed);
+    reference.level->MaterializeTiles(hashed);
+    std::uint64_t hash = HashRect(level, hashed), reference_hash = HashRect(reference.level.get(), hashed);
+    std::printf("walked terrain %016llx, never evicted %016llx%s\n", static_cast<unsigned long long>(hash),
+                static_cast<unsigned long long>(reference_hash), hash == reference_hash ? "" : "   DIFFERS");
+    return hash == reference_hash;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.sizes.push_back(Size{atoi(argv[i + 1]), atoi(argv[i + 2])});
+            i += 2;
+        }
+        else if (!strcmp("--walk-size", argv[i]) && i + 2 < argc)
+        {
+            options.walk_size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--steps", argv[i]) && i + 1 < argc)
+            options.steps = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--evict-steps", argv[i]) && i + 1 < argc)
+            options.evict_steps = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.seed = atoi(argv[++i]);
+        else if (!strcmp("--full-limit", argv[i]) && i + 1 < argc)
+            options.full_limit = atoll(argv[++i]);
+        else if (!strcmp("--threads", argv[i]) && i + 1 < argc)
+            options.threads = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>]... [--walk-size <W> <H>] [--steps <N>] [--evict-steps <N>] "
+                        "[--seed <INT>] [--full-limit <pixels>] [--threads <N>]\n",
+                        argv[0]);
+            return 1;
+        }
+    }
+    if (options.sizes.empty())
+        options.sizes = {Size{1000, 500}, Size{1500, 750}, Size{4096, 4096}, Size{16384, 16384}, Size{32768, 32768}};
+    if (options.threads > 0)
+        tweak::perf::parallelism_degree = options.threads;
+
+    std::printf("Caves level start, seed %d\n", options.seed);
+    for (Size size : options.sizes)
+        RunStartup(options, size);
+    return RunWalk(options) ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "bench_util.h"
+#include "level.h"
+#include "level_pixel.h"
+#include "levelgen.h"
+#include "random.h"
+#include "trace.h"
+
+/*
+ * Level traversal benchmark
+ *  Runs the same per-pixel and 3x3 passes over an unmaterialized level, the way level generators do, once
+ *  pixel by pixel through GetVoxelRaw/SetVoxelRaw and once through the row traversal of Level::ForEachRow*.
+ *  Per-pixel passes are also run with x in the outer loop, the order Level::ForEachVoxel used to walk in.
+ */
+
+struct BenchOptions
+{
+    Size size = {4000, 3000};
+    int repeats = 5;
+    int seed = 1;
+};
+
+static LevelPixel Invert(LevelPixel pixel)
+{
+    return pixel == LevelPixel::LevelGenRock ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock;
+}
+
+static LevelPixel Smooth(LevelPixel pixel, int rock_neighbors)
+{
+    bool paint_rock = (pixel != LevelPixel::LevelGenDirt) ? (rock_neighbors >= 3) : (rock_neighbors > 4);
+    return paint_rock ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt;
+}
+
+static void InvertColumns(Level * level)
+{
+    Position pos;
+    for (pos.x = 0; pos.x < level->GetSize().x; ++pos.x)
+        for (pos.y = 0; pos.y < level->GetSize().y; ++pos.y)
+            level->SetVoxelRaw(pos, Invert(level->GetVoxelRaw(pos)));
+}
+
+static void InvertPixels(Level * level)
+{
+    Position pos;
+    for (pos.y = 0; pos.y < level->GetSize().y; ++pos.y)
+        for (pos.x = 0; pos.x < level->GetSize().x; ++pos.x)
+            level->SetVoxelRaw(pos, Invert(level->GetVoxelRaw(pos)));
+}
+
+static void InvertRows(Level * level)
+{
+    const int width = level->GetSize().x;
+    level->ForEachRow([width](int, LevelPixel * row) {
+        for (int x = 0; x < width; ++x)
+            row[x] = Invert(row[x]);
+    });
+}
+
+static int SmoothPixels(Level * level)
+{
+    int count = 0;
+    for (int y = 1; y < level->GetSize().y - 1; ++y)
+        for (int x = 1; x < level->GetSize().x - 1; ++x)
+        {
+            LevelPixel old = level->GetVoxelRaw(Position{x, y});
+            level->SetVoxelRaw(Position{x, y}, Smooth(old, levelgen::Queries::CountNeighborValues({x, y}, level)));
+            count += level->GetVoxelRaw(Position{x, y}) != old;
+        }
+    return count;
+}
+
+static int SmoothRows(Level * level)
+{
+    const int width = level->GetSize().x;
+    int count = 0;
+    level->ForEachRowNeighborhood(
+        [width, &count](const LevelRowNeighborhood & rows) {
+            for (int x = 1; x < width - 1; ++x)
+            {
+                LevelPixel old = rows.row[x];
+                int n = (char)rows.above[x - 1] + (char)rows.above[x] + (char)rows.above[x + 1] +
+                        (char)rows.row[x - 1] + (char)rows.row[x + 1] + (char)rows.below[x - 1] +
+                        (char)rows.below[x] + (char)rows.below[x + 1];
+                rows.row[x] = Smooth(old, n);
+                count += rows.row[x] != old;
+            }
+        },
+        1, level->GetSize().y - 2);
+    return count;
+}
+
+/* Runs the pass on a fresh copy of the same noise, returns average time per pass */
+template <typename PassFunc>
+static std::chrono::microseconds Measure(const BenchOptions & options, PassFunc pass_func, std::uint64_t & hash)
+{
+    Level level(options.size);
+    level.ForEachRow([&options](int y, LevelPixel * row) {
+        StreamRandom random = {std::uint64_t(options.seed), std::uint64_t(y)};
+        for (int x = 0; x < options.size.x; ++x)
+            row[x] = random.Bool(450) ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt;
+    });
+
+    Stopwatch<> elapsed;
+    for (int repeat = 0; repeat < options.repeats; ++repeat)
+        pass_func(&level);
+    auto result = elapsed.GetElapsed() / options.repeats;
+    hash = HashLevel(&level);
+    return result;
+}
+
+int main(int argc, char * argv[])
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp("--size", argv[i]) && i + 2 < argc)
+        {
+            options.size = Size{atoi(argv[i + 1]), atoi(argv[i + 2])};
+            i += 2;
+        }
+        else if (!strcmp("--repeats", argv[i]) && i + 1 < argc)
+            options.repeats = std::max(1, atoi(argv[++i]));
+        else if (!strcmp("--seed", argv[i]) && i + 1 < argc)
+            options.seed = atoi(argv[++i]);
+        else
+        {
+            std::printf("Usage: %s [--size <W> <H>] [--repeats <N>] [--seed <INT>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    std::printf("Level %dx%d, %d repeats\n", options.size.x, options.size.y, options.repeats);
+    bool is_same = true;
+    auto report = [&is_same](const char * name, std::chrono::microseconds elapsed, std::uint64_t hash,
+                             std::uint64_t reference_hash) {
+        is_same = is_same && hash == reference_hash;
+        std::printf("%-22s %9.3f ms%s\n", name, elapsed.count() / 1000.0, hash == reference_hash ? "" : "   DIFFERS");
+    };
+
+    std::uint64_t invert_hash, smooth_hash, hash;
+    auto elapsed = Measure(options, InvertColumns, invert_hash);
+    report("invert, columns", elapsed, invert_hash, invert_hash);
+    elapsed = Measure(options, InvertPixels, hash);
+    report("invert, pixels", elapsed, hash, invert_hash);
+    elapsed = Measure(options, InvertRows, hash);
+    report("invert, ForEachRow", elapsed, hash, invert_hash);
+
+    elapsed = Measure(options, SmoothPixels, smooth_hash);
+    report("smooth, pixels", elapsed, smooth_hash, smooth_hash);
+    elapsed = Measure(options, SmoothRows, hash);
+    report("smooth, neighborhood", elapsed, hash, smooth_hash);
+    return is_same ? 0 : 1;
+}
@@ -18,12 +18,27 @@ class CollisionSolver
     template <typename TankCollideFunc, typename HarvesterCollideFunc, typename TerrainCollideFunc>
     bool TestCollide(Position world_position, TankCollideFunc tank_collide, HarvesterCollideFunc machine_collide,
                  TerrainCollideFunc terrain_collide) const;
+    /* Tanks and machines only, for paths whose terrain was tested through the level's bit planes */
+    template <typename TankCollideFunc, typename HarvesterCollideFunc>
+    bool TestCollide(Position world_position, TankCollideFunc tank_collide,
+                     HarvesterCollideFunc machine_collide) const;
 };
 
 /* Return true from collision functions if you registered the collision */
 template <typename TankCollideFunc, typename MachineCollideFunc, typename TerrainCollideFunc>
 bool CollisionSolver::TestCollide(Position world_position, TankCollideFunc tank_collide,
                               MachineCollideFunc machine_collide, TerrainCollideFunc terrain_collide) const
+{
+    bool collided = TestCollide(world_position, tank_collide, machine_collide);
+    auto terrain_result = TestTerrain(world_position);
+    if (terrain_result != LevelPixel::Blank)
+        collided = collided || terrain_collide(terrain_result);
+    return collided;
+}
+
+template <typename TankCollideFunc, typename MachineCollideFunc>
+bool CollisionSolver::TestCollide(Position world_position, TankCollideFunc tank_collide,
+                                  MachineCollideFunc machine_collide) const
 {
     bool collided = false;
     auto tank_result = TestTank(world_position);
@@ -32,8 +47,5 @@ bool CollisionSolver::TestCollide(Position world_position, TankCollideFunc tank_
     auto machine_result = TestMachine(world_position);
     if (machine_result)
         collided = collided || machine_collide(*machine_result);
-    auto terrain_result = TestTerrain(world_position);
-    if (terrain_result != LevelPixel::Blank)
-        collided = collided || terrain_collide(terrain_result);
     return collided;
 }
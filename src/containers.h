@@ -1,5 +1,6 @@
 #pragma once
 
+#include "mapped_memory.h"
 #include "trace.h"
 #include <deque>
 #include <queue>
@@ -353,21 +354,25 @@ class MultiTypeContainer
 template <typename ValueType>
 class Container2D
 {
-    using Container = std::vector<ValueType>;
+    /* Mapped, so only pages that are ever touched take physical memory */
+    using Container = MappedArray<ValueType>;
     Container array;
     Size size;
 
   public:
-    Container2D(Size size) : array(size.x * size.y), size(size) {}
+    Container2D(Size size) : array(size.Area()), size(size) {}
     Container2D(const Container2D &) = delete; /* Expensive to copy, don't do it unintentionally */
 
-    ValueType & operator[](int i) { return array[i]; }
-    const ValueType & operator[](int i) const { return array[i]; }
-    ValueType & operator[](Position pos) { return array[pos.x + pos.y * this->size.x]; }
-    const ValueType & operator[](Position pos) const { return array[pos.x + pos.y * this->size.x]; }
+    ValueType & operator[](std::size_t i) { return array[i]; }
+    const ValueType & operator[](std::size_t i) const { return array[i]; }
+    ValueType & operator[](Position pos) { return array[this->size.Index(pos)]; }
+    const ValueType & operator[](Position pos) const { return array[this->size.Index(pos)]; }
 
-    typename Container::iterator begin() { return array.begin(); }
-    typename Container::iterator end() { return array.end(); }
-    typename Container::const_iterator cbegin() const { return array.cbegin(); }
-    typename Container::const_iterator cend() const { return array.cend(); }
+    ValueType * begin() { return array.begin(); }
+    ValueType * end() { return array.end(); }
+    const ValueType * cbegin() const { return array.begin(); }
+    const ValueType * cend() const { return array.end(); }
+
+    /* Elements [first, first + count) become undefined and stop taking physical memory */
+    void Discard(std::size_t first, std::size_t count) { array.Discard(first, count); }
 };
\ No newline at end of file
@@ -1,4 +1,6 @@
+#include <algorithm>
 #include <cstdlib>
+#include <utility>
 
 #include "exceptions.h"
 #include <aitwitch.h>
@@ -8,6 +10,8 @@
 #include <game.h>
 #include <gamelib.h>
 #include <level.h>
+#include <level_file.h>
+#include <level_provider.h>
 #include <levelgen.h>
 #include <projectile.h>
 #include <screen.h>
@@ -16,6 +20,7 @@
 #include <world.h>
 
 #include "game_system.h"
+#include "trace.h"
 
 #define ERR_OUT(msg) gamelib_error("PROGRAMMING ERROR: " msg)
 
@@ -110,26 +115,31 @@ Game::Game(GameConfig config)
     this->screen =
         std::make_unique<Screen>(this->config.video_config.is_fullscreen, GetSystem()->GetSurface());
 
-    /* Generate our random level: */
-    int TestIterations = 20;
-#ifdef _DEBUG
-    TestIterations = 1;
-#endif
-    std::chrono::milliseconds time_taken = {};
     std::unique_ptr<Level> level;
-    for (int i = 0; i != TestIterations; ++i)
+    if (this->config.level_file)
     {
-        gamelib_print("Generating level %d/%d...\n", i+1, TestIterations);
-        auto generated_level = levelgen::LevelGenerator::Generate(this->config.level_generator, this->config.level_size);
-        time_taken += generated_level.generation_time;
-        level = std::move(generated_level.level);
+        /* Pre-built level, no generation needed */
+        level = LevelFile::Load(this->config.level_file).level;
+        level->MaterializeLevelTerrainAndBases();
+    }
+    else if (this->config.is_streamed)
+    {
+        /* Only the surroundings of the bases get generated now, whatever the level size */
+        level = levelgen::LevelGenerator::GenerateStreamed(this->config.level_generator, this->config.level_size).level;
+        level->MaterializeLevelTerrainAndBases();
+    }
+    else if (this->config.level_provider)
+    {
+        /* Generated and materialized in the background while the game system started */
+        level = this->config.level_provider->Take();
+        this->config.level_provider = nullptr; /* The owner drops it once the game is created */
+    }
+    else
+    {
+        /* Generate our random level. Generation timing lives in tunneltanks_levelgen_bench. */
+        level = levelgen::LevelGenerator::Generate(this->config.level_generator, this->config.level_size).level;
+        level->MaterializeLevelTerrainAndBases();
     }
-    auto average_time = time_taken / TestIterations;
-    gamelib_print("***\r\nAverage level time: %lld.%03lld sec\n", average_time.count() / 1000,
-                  average_time.count() % 1000);
-
-    /* Create projectile list, tank list and materialize the level voxels */
-    level->MaterializeLevelTerrainAndBases();
 
     /* Debug the starting data, if we're debugging: */
     if (this->is_debug)
@@ -148,6 +158,10 @@ Game::Game(GameConfig config)
 bool Game::AdvanceStep()
 {
     assert(this->is_active);
+    Stopwatch<> step_elapsed;
+
+    /* A tick in flight reads the controllers. Don't pump events under it. */
+    FinishPendingTick();
 
     GameEvent temp;
 
@@ -176,19 +190,97 @@ bool Game::AdvanceStep()
         gamelib_event_done();
     }
 
+    if (this->config.is_pipelined)
+        AdvancePipelined();
+    else
+        AdvanceSequential();
+
+    TraceFrameTiming(step_elapsed.GetElapsed());
+    return true;
+}
+
+void Game::AdvanceSequential()
+{
+    this->presented_tick_start = std::chrono::steady_clock::now();
+    Stopwatch<> tick_elapsed;
+
     /* Do the world advance - apply controller input, move stuff, commit level bitmap to DrawBuffer */
     /* TODO: Don't get the surface this stupid way */
     world->Advance();
     world->Draw(&this->world->GetLevel()->GetSurfaces()->objects_surface);
+    this->tick_elapsed = tick_elapsed.GetElapsed();
+
     /* Draw our current state */
+    this->screen->CaptureState();
     this->screen->DrawCurrentMode();
+}
 
-    return true;
+/*
+ * Tick N + 1 is simulated while tick N is drawn. Both meet here, when neither of them runs:
+ *  - the terrain committed by tick N is copied into the terrain surface (Level::PresentTerrain)
+ *  - the objects tick N drew into the back surface become the drawn ones
+ *  - widgets copy the tank state they show
+ * Then drawing only reads presentation copies and the simulation only writes the world and the back surface.
+ * Frames show the world one tick later than in sequential mode.
+ */
+void Game::AdvancePipelined()
+{
+    LevelSurfaces * surfaces = this->world->GetLevel()->GetSurfaces();
+
+    this->world->GetLevel()->PresentTerrain();
+    surfaces->SwapObjectSurfaces();
+    this->screen->CaptureState();
+    this->presented_tick_start = this->pending_tick_start;
+
+    this->pending_tick_start = std::chrono::steady_clock::now();
+    this->has_pending_tick = true;
+    ThreadPool::Get().Submit(this->pending_tick, 1, this->tick_task);
+
+    this->screen->DrawCurrentMode();
+}
+
+void Game::FinishPendingTick()
+{
+    if (!this->has_pending_tick)
+        return;
+
+    ThreadPool::Get().Wait(this->pending_tick);
+    this->has_pending_tick = false;
+    if (this->tick_exception)
+        std::rethrow_exception(std::exchange(this->tick_exception, nullptr));
+}
+
+void Game::TraceFrameTiming(std::chrono::microseconds step_elapsed)
+{
+    /* The slower of step and tick bounds the tick rate. Latency is the age of the world state on screen
+     * when the frame is done, counted from the start of its tick. */
+    this->steps_elapsed += step_elapsed;
+    this->ticks_elapsed += this->tick_elapsed;
+    this->latency_elapsed += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                                                                  this->presented_tick_start);
+    if (++this->steps_measured % 100 == 0)
+    {
+        auto step = this->steps_elapsed / this->steps_measured;
+        auto tick = this->ticks_elapsed / this->steps_measured;
+        auto latency = this->latency_elapsed / this->steps_measured;
+        DebugTrace<4>("Game::AdvanceStep (%s) takes on average %lld.%03lld ms, tick %lld.%03lld ms: at most %lld "
+                      "ticks/s, frames are %lld.%03lld ms behind\r\n",
+                      this->config.is_pipelined ? "pipelined" : "sequential", step.count() / 1000,
+                      step.count() % 1000, tick.count() / 1000, tick.count() % 1000,
+                      1'000'000ll / std::max<long long>(1, std::max(step, tick).count()), latency.count() / 1000,
+                      latency.count() % 1000);
+        this->steps_elapsed = this->ticks_elapsed = this->latency_elapsed = {};
+        this->steps_measured = 0;
+    }
 }
 
 /* Done with a game structure: */
 Game::~Game()
 {
+    /* Don't leave the world to a tick still running */
+    if (this->has_pending_tick)
+        ThreadPool::Get().Wait(this->pending_tick);
+
     if (this->is_active)
     {
         /* Debug if we need to: */
@@ -213,6 +305,26 @@ void Game::BeginGame()
         throw GameException("Don't know how to draw more than 2 players at once...");
     }
 
+    if (this->config.is_pipelined)
+    {
+        /* The terrain surface is drawn while the next tick runs. It only catches up in AdvancePipelined. */
+        world->GetLevel()->SetDeferredPresentation(true);
+        this->tick_task = [this](int, ThreadLocal *) {
+            Stopwatch<> tick_elapsed;
+            try
+            {
+                this->world->Advance();
+                this->world->Draw(&this->world->GetLevel()->GetSurfaces()->back_objects_surface);
+            }
+            catch (...)
+            {
+                this->tick_exception = std::current_exception();
+            }
+            this->tick_elapsed = tick_elapsed.GetElapsed();
+        };
+        this->pending_tick_start = std::chrono::steady_clock::now();
+    }
+
     this->is_active = true;
     world->BeginGame();
 }
@@ -221,6 +333,7 @@ void Game::GameOver() { assert(!"Implement game over!"); }
 
 void Game::ClearWorld()
 {
+    FinishPendingTick();
     world->Clear();
 }
 
@@ -1,8 +1,12 @@
 #pragma once
 #include <cassert>
+#include <chrono>
+#include <exception>
+#include <functional>
 #include <memory>
 #include <types.h>
 #include "game_config.h"
+#include "thread_pool.h"
 
 class TankList;
 
@@ -17,6 +21,21 @@ class Game
     std::unique_ptr<class World> world;
     std::unique_ptr<class GameMode> mode;
 
+    /* Pipelined mode: the next tick runs on the thread pool while the last one is drawn */
+    TaskGroup pending_tick;
+    bool has_pending_tick = false;
+    std::function<void(int, ThreadLocal *)> tick_task;
+    std::exception_ptr tick_exception;
+    std::chrono::steady_clock::time_point pending_tick_start = {};
+    std::chrono::steady_clock::time_point presented_tick_start = {}; /* Simulation start of the tick on screen */
+    std::chrono::microseconds tick_elapsed = {};
+
+    /* Frame timing, traced every 100 steps */
+    std::chrono::microseconds steps_elapsed = {};
+    std::chrono::microseconds ticks_elapsed = {};
+    std::chrono::microseconds latency_elapsed = {};
+    int steps_measured = 0;
+
   public:
     Game(GameConfig config);
     ~Game();
@@ -28,6 +47,10 @@ class Game
     void ClearWorld();
     World * GetWorld() { return world.get(); }
   private:
+    void AdvanceSequential();
+    void AdvancePipelined();
+    void FinishPendingTick(); /* Rethrows what the tick threw */
+    void TraceFrameTiming(std::chrono::microseconds step_elapsed);
 };
 
 inline std::unique_ptr<Game> global_game;
@@ -2,6 +2,8 @@
 #include "levelgen.h"
 #include "types.h"
 
+class LevelProvider;
+
 struct VideoConfig
 {
     Size resolution;
@@ -18,4 +20,8 @@ struct GameConfig
     int player_count;
     int rand_seed;
     bool use_ai = true;
+    const char * level_file = nullptr; /* Load the level from this file instead of generating it */
+    LevelProvider * level_provider = nullptr; /* Take the level from here instead of generating it */
+    bool is_pipelined = false; /* Simulate the next tick while the last one is drawn */
+    bool is_streamed = false; /* Materialize the level tile by tile around the tanks, see Level::MaterializeTiles */
 };
@@ -19,6 +19,9 @@ bool gamelib_get_can_fullscreen(); /* Returns 0 or 1. */
 bool gamelib_get_can_window();     /* Returns 0 or 1. */
 int gamelib_get_target_fps();      /* Usually returns 24. */
 
+/* Lets the calling thread yield to the game loop, for work done in the background. Best effort. */
+void gamelib_lower_thread_priority();
+
 /* Some platforms (Android) will be acting as the game loop, so the game loop
  * needs to happen in the gamelib: */
 typedef int (*draw_func)(void * data);
@@ -42,6 +42,7 @@ int gamelib_get_can_resize()     { return 0; }
 int gamelib_get_can_fullscreen() { return 1; }
 int gamelib_get_can_window()     { return 0; }
 int gamelib_get_target_fps()     { return GAME_FPS; } /* << TODO: Remove this? */
+void gamelib_lower_thread_priority() {}
 
 /* The C code doesn't maintain the main loop in the Android port, so we don't
  * need to implement this: */
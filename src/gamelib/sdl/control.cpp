@@ -53,6 +53,8 @@ bool gamelib_get_can_fullscreen() { return 1; }
 bool gamelib_get_can_window() { return 1; }
 int gamelib_get_target_fps() { return tweak::perf::TargetFps; }
 
+void gamelib_lower_thread_priority() { SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW); }
+
 /* TODO: Move to classes. ControllerAssigner? */
 static bool try_attach_gamepad(Tank * tank, int gamepad_num)
 {
@@ -14,7 +14,7 @@ void widgets::TankView::DrawStatic(Screen *screen)
 {
     int x, y;
     // int health = w->t->GetHealth();
-    int energy = this->tank->GetEnergy();
+    int energy = this->shown_energy;
 
     /* Don't do static if we have a lot of energy: */
     if (energy > tweak::screen::DrawStaticFuelThreshold)
@@ -26,9 +26,9 @@ void widgets::TankView::DrawStatic(Screen *screen)
     if (!this->counter)
     {
         int intensity = 1000 * energy / tweak::screen::DrawStaticFuelThreshold;
-        this->showing_static = !Random.Bool(intensity);
+        this->showing_static = !this->static_random.Bool(intensity);
         this->counter =
-            Random.Int(tweak::perf::TargetFps / 16, tweak::perf::TargetFps / 8) * this->showing_static ? 1u : 4u;
+            this->static_random.Int(tweak::perf::TargetFps / 16, tweak::perf::TargetFps / 8) * this->showing_static ? 1u : 4u;
     }
     else
         this->counter--;
@@ -37,12 +37,12 @@ void widgets::TankView::DrawStatic(Screen *screen)
         return;
 
     auto black_bar_random_gen = [this]() {
-        return Random.Int(1, this->screen_rect.size.x * this->screen_rect.size.y * tweak::screen::DrawStaticBlackBarSize / 1000);
+        return this->static_random.Int(1, this->screen_rect.size.x * this->screen_rect.size.y * tweak::screen::DrawStaticBlackBarSize / 1000);
     };
 
     /* Should we draw a black bar in the image? */
-    int black_counter = Random.Bool(tweak::screen::DrawStaticBlackBarOdds) ? black_bar_random_gen() : 0;
-    int drawing_black = black_counter && Random.Bool(tweak::screen::DrawStaticBlackBarOdds);
+    int black_counter = this->static_random.Bool(tweak::screen::DrawStaticBlackBarOdds) ? black_bar_random_gen() : 0;
+    int drawing_black = black_counter && this->static_random.Bool(tweak::screen::DrawStaticBlackBarOdds);
 
     /* Develop a static thing image for the window: */
     for (y = 0; y < this->screen_rect.size.y; y++) {
@@ -53,7 +53,7 @@ void widgets::TankView::DrawStatic(Screen *screen)
             if (!energy)
             {
                 screen->DrawPixel({x + this->screen_rect.pos.x, y + this->screen_rect.pos.y},
-                                  Palette.GetPrimary(TankColor(Random.Int(0, 7))));
+                                  Palette.GetPrimary(TankColor(this->static_random.Int(0, 7))));
                 continue;
             }
 
@@ -69,11 +69,11 @@ void widgets::TankView::DrawStatic(Screen *screen)
             }
 
             /* Make this semi-transparent: */
-            if (Random.Bool(tweak::screen::DrawStaticTransparency))
+            if (this->static_random.Bool(tweak::screen::DrawStaticTransparency))
                 continue;
 
             /* Finally, select a color (either black or random) and draw: */
-            color = drawing_black ? Palette.Get(Colors::Blank) : Palette.GetPrimary(TankColor(Random.Int(0, 7)));
+            color = drawing_black ? Palette.Get(Colors::Blank) : Palette.GetPrimary(TankColor(this->static_random.Int(0, 7)));
             screen->DrawPixel({x + this->screen_rect.pos.x, y + this->screen_rect.pos.y}, color);
         }
     }
@@ -82,7 +82,7 @@ void widgets::TankView::DrawStatic(Screen *screen)
 /* Will draw a window using the level's drawbuffer: */
 void TankView::Draw(Screen *screen)
 {
-    Position tank_pos = this->tank->GetPosition();
+    Position tank_pos = this->shown_position;
 
     for (int y = 0; y < this->screen_rect.size.y; y++) {
         for (int x = 0; x < this->screen_rect.size.x; x++)
@@ -105,6 +105,12 @@ void TankView::Draw(Screen *screen)
     this->DrawStatic(screen);
 }
 
+void TankView::CaptureState()
+{
+    this->shown_position = this->tank->GetPosition();
+    this->shown_energy = this->tank->GetEnergy();
+}
+
 Position TankView::TranslatePosition(ScreenPosition screen_pos) const
 {
     assert(this->screen_rect.IsInside(screen_pos));
@@ -131,8 +137,8 @@ void StatusBar::Draw(Screen *screen)
     int mid_h = (this->screen_rect.size.y % 2) ? 1u : 2u;
 
     /* How many pixels are filled in? */
-    int energy_filled = this->tank->GetEnergy();
-    int health_filled = this->tank->GetHealth();
+    int energy_filled = this->shown_energy;
+    int health_filled = this->shown_health;
     int half_energy_pixel = tweak::tank::StartingEnergy.amount / ((this->screen_rect.size.x - SharedLayout::status_border * 2) * 2);
 
     energy_filled += half_energy_pixel;
@@ -199,6 +205,12 @@ void StatusBar::Draw(Screen *screen)
     }
 }
 
+void StatusBar::CaptureState()
+{
+    this->shown_energy = this->tank->GetEnergy();
+    this->shown_health = this->tank->GetHealth();
+}
+
 void BitmapRender::Draw(Screen *screen)
 {
     this->data->Draw(screen, this->screen_rect.pos,
@@ -213,13 +225,15 @@ void LivesLeft::Draw(Screen *screen)
         int y_pos = 0;
         for (int life = 0; y_pos + 2 <= this->screen_rect.size.y; ++life)
         {
-            Color such_color = (life < tank->GetLives()) ? this->color : Palette.Get(Colors::Blank);
+            Color such_color = (life < this->shown_lives) ? this->color : Palette.Get(Colors::Blank);
             this->data->Draw(screen, ScreenPosition{this->screen_rect.pos} + Offset{0, y_pos}, such_color);
             y_pos += 1 + this->data->GetSize().y;
         }
     }
 }
 
+void LivesLeft::CaptureState() { this->shown_lives = this->tank->GetLives(); }
+
 void Crosshair::UpdateVisual()
 {
     this->screen_rect = ScreenRect{this->center.x - this->data->GetSize().x / 2, this->center.y - this->data->GetSize().y / 2,
@@ -256,8 +270,15 @@ void Crosshair::SetWorldPosition(Position position)
 
 void Crosshair::Draw(Screen *)
 {
-    if (!is_hidden)
-        Parent::Draw(this->screen);
+    if (this->is_shown)
+        this->data->Draw(this->screen, this->shown_rect.pos,
+                         ImageRect{{0, 0}, {this->data->GetSize().x, this->data->GetSize().y}}, this->color);
+}
+
+void Crosshair::CaptureState()
+{
+    this->shown_rect = this->screen_rect;
+    this->is_shown = !this->is_hidden;
 }
 
 void ResourcesMinedDisplay::Draw(Screen * screen)
@@ -270,13 +291,19 @@ void ResourcesMinedDisplay::Draw(Screen * screen)
     ScreenRect text_rect = {this->screen_rect.Left() + 2, this->screen_rect.Top() + 2, this->screen_rect.size.x - 4,
                             this->screen_rect.size.y - 4};
     GetSystem()->GetFontRenderer()->Render(FontFace::Brodmin, screen, text_rect, 
-                                           std::to_string(this->tank->GetResources().GetDirt() / 10),
+                                           std::to_string(this->shown_dirt / 10),
                                            Palette.Get(Colors::StatusEnergy), HorizontalAlign::Right);
     text_rect.pos.y += 9;
     text_rect.size.y -= 9;
     GetSystem()->GetFontRenderer()->Render(FontFace::Brodmin, screen, text_rect,
-                                           std::to_string(this->tank->GetBase()->GetResources().GetDirt() / 10),
+                                           std::to_string(this->shown_base_dirt / 10),
                                            Palette.Get(Colors::StatusHealth), HorizontalAlign::Right);
 }
 
+void ResourcesMinedDisplay::CaptureState()
+{
+    this->shown_dirt = this->tank->GetResources().GetDirt();
+    this->shown_base_dirt = this->tank->GetBase()->GetResources().GetDirt();
+}
+
 } // namespace widgets
@@ -1,6 +1,7 @@
 #pragma once
 #include "bitmaps.h"
 #include "color_palette.h"
+#include "random.h"
 
 class Screen;
 class Tank;
@@ -26,19 +27,25 @@ class GuiWidget
     ScreenRect GetRect() const { return screen_rect; }
 
     virtual void Draw(class Screen * screen) = 0;
+    /* Copy the state Draw shows out of the world. Draw may run while the world advances the next tick. */
+    virtual void CaptureState() {}
 };
 
 /* Will draw a window using the level's drawbuffer: */
 class TankView : public GuiWidget
 {
     Tank * tank;
+    Position shown_position = {};
+    int shown_energy = 0;
 
     int counter = 0;
     int showing_static = 0;
+    RandomGenerator static_random; /* Not ::Random, drawing must not change the simulation */
 
   public:
     TankView(ScreenRect screen_rect, class Tank * tank) : GuiWidget(screen_rect), tank(tank) {}
     void Draw(Screen * screen) override;
+    void CaptureState() override;
     Position TranslatePosition(ScreenPosition screen_position) const;
     ScreenPosition TranslatePosition(Position screen_position) const;
 
@@ -52,6 +59,8 @@ class StatusBar : public GuiWidget
 {
     Tank * tank;
     bool decreases_to_left;
+    int shown_energy = 0;
+    int shown_health = 0;
 
   public:
     StatusBar(ScreenRect screen_rect, class Tank * tank, bool decrease_to_left)
@@ -59,6 +68,7 @@ class StatusBar : public GuiWidget
     {
     }
     void Draw(Screen * screen) override;
+    void CaptureState() override;
 };
 
 /* Will draw an arbitrary, static bitmap to screen*/
@@ -76,6 +86,7 @@ struct LivesLeft : public BitmapRender
 {
     Orientation direction;
     Tank * tank;
+    int shown_lives = 0;
 
   public:
     LivesLeft(ScreenRect rect, Orientation direction, Tank * tank)
@@ -85,6 +96,7 @@ struct LivesLeft : public BitmapRender
                direction == Orientation::Horizontal && rect.size.y == this->data->GetSize().y);
     }
     void Draw(Screen * screen) override;
+    void CaptureState() override;
 };
 
 class Crosshair : public BitmapRender
@@ -95,6 +107,8 @@ class Crosshair : public BitmapRender
     Screen * screen = nullptr;
     TankView * parent_view = nullptr;
     bool is_hidden = true;
+    ScreenRect shown_rect = {};
+    bool is_shown = false;
 
   public:
     Crosshair(ScreenPosition pos, Screen * screen, TankView * parent_view)
@@ -111,15 +125,19 @@ class Crosshair : public BitmapRender
     Position GetWorldPosition() const { return parent_view->TranslatePosition(GetScreenPosition()); }
     void SetWorldPosition(Position position);
     void Draw(Screen * screen) override;
+    void CaptureState() override;
 };
 
 class ResourcesMinedDisplay : public GuiWidget
 {
     Tank * tank;
     [[maybe_unused]] HorizontalAlign alignment;
+    int shown_dirt = 0;
+    int shown_base_dirt = 0;
   public:
     ResourcesMinedDisplay(ScreenRect screen_rect, HorizontalAlign alignment, Tank * tank) : GuiWidget(screen_rect), tank(tank), alignment(alignment) {}
     void Draw(Screen * screen) override;
+    void CaptureState() override;
 };
 
 } // namespace widgets
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "job_graph.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+
+#include "tweak.h"
+
+int JobGraph::Add(const char * name, Access access, std::function<void()> func)
+{
+    assert(!this->running_group);
+    const int index = int(this->jobs.size());
+    auto job = std::make_unique<Job>();
+    job->name = name;
+    job->access = access;
+    job->func = std::move(func);
+
+    const unsigned touches = access.reads | access.writes;
+    for (int earlier = 0; earlier < index; ++earlier)
+    {
+        Job & other = *this->jobs[earlier];
+        if ((access.writes & (other.access.reads | other.access.writes)) || (touches & other.access.writes))
+        {
+            job->dependencies.push_back(earlier);
+            other.dependents.push_back(index);
+        }
+    }
+
+    this->jobs.push_back(std::move(job));
+    this->tasks.clear();
+    for (int i = 0; i < int(this->jobs.size()); ++i)
+        this->tasks.push_back(JobTask{this, i});
+    return index;
+}
+
+void JobGraph::Run()
+{
+    ThreadPool & pool = ThreadPool::Get();
+    TaskGroup group;
+    this->running_group = &group;
+    this->first_exception = nullptr;
+    this->run_start = Clock::now();
+
+    for (auto & job : this->jobs)
+        job->pending_dependencies.store(int(job->dependencies.size()), std::memory_order_relaxed);
+    /* The first root runs on this thread, so a graph without parallelism never touches the pool */
+    int first_root = -1;
+    for (int i = 0; i < int(this->jobs.size()); ++i)
+    {
+        if (!this->jobs[i]->dependencies.empty())
+            continue;
+        if (first_root < 0)
+            first_root = i;
+        else
+            pool.Submit(group, 1, this->tasks[i]);
+    }
+    if (first_root >= 0)
+        RunJob(first_root);
+    pool.Wait(group);
+
+    this->run_time = Since(this->run_start);
+    this->running_group = nullptr;
+    if (this->first_exception)
+        std::rethrow_exception(this->first_exception);
+}
+
+void JobGraph::RunJob(int index)
+{
+    /* The first job released by a finished one continues on this thread, only the others are submitted */
+    while (index >= 0)
+    {
+        Job & job = *this->jobs[index];
+        job.started = Since(this->run_start);
+        try
+        {
+            job.func();
+        }
+        catch (...)
+        {
+            std::unique_lock lock(this->exception_mutex);
+            if (!this->first_exception)
+                this->first_exception = std::current_exception();
+        }
+        job.finished = Since(this->run_start);
+
+        /* Released jobs join the group before this one leaves it, so the run can't end early. Jobs that took
+         * less than a dispatch last time run here too, after the others were handed out. */
+        index = -1;
+        for (int dependent : job.dependents)
+        {
+            Job & released = *this->jobs[dependent];
+            if (released.pending_dependencies.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                continue;
+            if (released.finished - released.started < tweak::perf::JobDispatchCost)
+                released.is_run_here = true;
+            else if (index < 0)
+                index = dependent;
+            else
+                ThreadPool::Get().Submit(*this->running_group, 1, this->tasks[dependent]);
+        }
+        for (int dependent : job.dependents)
+        {
+            if (!this->jobs[dependent]->is_run_here)
+                continue;
+            this->jobs[dependent]->is_run_here = false;
+            if (index < 0)
+                index = dependent;
+            else
+                RunJob(dependent);
+        }
+    }
+}
+
+std::chrono::microseconds JobGraph::Since(Clock::time_point start) const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start);
+}
+
+std::vector<int> JobGraph::GetCriticalPath() const
+{
+    auto finished_later = [this](int a, int b) { return this->jobs[a]->finished < this->jobs[b]->finished; };
+
+    std::vector<int> path;
+    if (this->jobs.empty())
+        return path;
+    std::vector<int> all(this->jobs.size());
+    for (int i = 0; i < int(all.size()); ++i)
+        all[i] = i;
+    /* Walk back from the job that finished last through the dependency that released it */
+    int job = *std::max_element(all.begin(), all.end(), finished_later);
+    while (true)
+    {
+        path.push_back(job);
+        const std::vector<int> & dependencies = this->jobs[job]->dependencies;
+        if (dependencies.empty())
+            break;
+        job = *std::max_element(dependencies.begin(), dependencies.end(), finished_later);
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+std::string JobGraph::DescribeCriticalPath() const
+{
+    std::string description;
+    for (int job : GetCriticalPath())
+    {
+        char step[128];
+        auto elapsed = GetJobTime(job);
+        std::snprintf(step, sizeof(step), "%s%s %lld.%03lld ms", description.empty() ? "" : " > ",
+                      this->jobs[job]->name, static_cast<long long>(elapsed.count() / 1000),
+                      static_cast<long long>(elapsed.count() % 1000));
+        description += step;
+    }
+    return description;
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+/*
+ * JobGraph: a fixed set of jobs run together on the thread pool, in dependency order
+ *  Each job declares which shared state it reads and which it writes, as bit masks. A job depends on every job
+ *  added before it that writes what it touches or touches what it writes, so the graph keeps the results
+ *  of running the jobs one after another in the order they were added. Jobs that don't conflict run at the
+ *  same time. A job released by a finished one continues on the same thread, and so do jobs that took less
+ *  than a dispatch on the last run, so only work that really runs side by side pays for the pool.
+ *  Every run records when each job started and finished, so the chain of jobs that decided the length of
+ *  the run can be traced afterwards.
+ */
+class JobGraph
+{
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    /* Bit masks of state the job reads and writes. Writing implies reading. */
+    struct Access
+    {
+        unsigned reads = 0;
+        unsigned writes = 0;
+    };
+
+  private:
+    struct Job
+    {
+        const char * name;
+        Access access;
+        std::function<void()> func;
+        std::vector<int> dependencies;
+        std::vector<int> dependents;
+
+        std::atomic<int> pending_dependencies = 0;
+        bool is_run_here = false; /* Released cheap, runs on the thread that released it */
+        std::chrono::microseconds started = {}; /* Relative to the start of the run */
+        std::chrono::microseconds finished = {};
+    };
+
+    /* Task submitted to the pool for a job */
+    struct JobTask
+    {
+        JobGraph * graph;
+        int job;
+        void operator()(int, ThreadLocal *) const { graph->RunJob(job); }
+    };
+
+    std::vector<std::unique_ptr<Job>> jobs;
+    std::vector<JobTask> tasks;
+
+    /* State of the current run */
+    TaskGroup * running_group = nullptr;
+    Clock::time_point run_start;
+    std::mutex exception_mutex;
+    std::exception_ptr first_exception;
+    std::chrono::microseconds run_time = {};
+
+  public:
+    JobGraph() = default;
+    JobGraph(const JobGraph &) = delete;
+    JobGraph & operator=(const JobGraph &) = delete;
+
+    /* Jobs can be added only between runs. Returns the index of the job. */
+    int Add(const char * name, Access access, std::function<void()> func);
+    /* Run every job once and wait for all of them. The first exception thrown by a job is rethrown after
+     * the rest of the jobs finished. */
+    void Run();
+
+    /* Jobs of the longest chain of the last run, first to last. Each waited for the previous one to finish. */
+    std::vector<int> GetCriticalPath() const;
+    /* "name 0.123 ms > name 0.456 ms ..." for the critical path of the last run */
+    std::string DescribeCriticalPath() const;
+    std::chrono::microseconds GetRunTime() const { return this->run_time; }
+    std::chrono::microseconds GetJobTime(int job) const { return this->jobs[job]->finished - this->jobs[job]->started; }
+
+  private:
+    void RunJob(int job);
+    std::chrono::microseconds Since(Clock::time_point start) const;
+};
@@ -17,13 +17,26 @@
 
 
 Level::Level(Size size)
-    : size(size), data(size), surfaces(size)
+    : size(size), data(size), surfaces(size), tiles(size), planes(size),
+      dirt_adjacency_data(size, &this->planes)
 {
     surfaces.terrain_surface.SetDefaultColor(static_cast<Color>(Palette.Get(Colors::Rock)));
     surfaces.objects_surface.SetDefaultColor({});
     std::fill(this->data.begin(), this->data.end(), LevelPixel::LevelGenRock);
 }
 
+Level::Level(Size size, std::unique_ptr<LevelTileSource> && tile_source, std::uint64_t seed)
+    : size(size), data(size), surfaces(size), tiles(size), planes(size),
+      dirt_adjacency_data(size, &this->planes),
+      streaming(std::make_unique<LevelStreaming>(std::move(tile_source), seed, this->tiles.GetTileTotal()))
+{
+    /* Level data stays untouched until tiles get materialized */
+    surfaces.terrain_surface.SetDefaultColor(static_cast<Color>(Palette.Get(Colors::Rock)));
+    surfaces.objects_surface.SetDefaultColor({});
+}
+
+Level::~Level() { assert(this->snapshots.empty() && "Snapshots must not outlive their level"); }
+
 void Level::OnConnectWorld(World *)
 {
 }
@@ -36,30 +49,82 @@ void Level::BeginGame()
     }
 }
 
-void Level::SetLevelData(int i, LevelPixel value)
+void Level::SetLevelData(std::size_t i, LevelPixel value, bool is_committed)
 {
-    this->data[i] = value;
-    /*if (this->is_ready)
-        this->dirt_adjacency_data.Invalidate(i);*/
+    SetLevelData(Position{int(i % this->size.x), int(i / this->size.x)}, value, is_committed);
 }
 
-void Level::SetLevelData(Position pos, LevelPixel value)
+void Level::SetLevelData(Position pos, LevelPixel value, bool is_committed)
 {
-    this->data[pos.y * this->size.x + pos.x] = value;
-    /*if (this->is_ready)
-        this->dirt_adjacency_data.Invalidate(pos);*/
+    LevelPixel & pixel = this->data[this->size.Index(pos)];
+    if (this->is_ready)
+    {
+        if (!this->snapshots.empty())
+            PreserveTile(this->tiles.GetTileIndex(pos));
+        if (is_committed)
+            this->tiles.MarkWritten(pos);
+        else
+            this->tiles.MarkChanged(pos);
+        this->planes.Set(pos, value);
+        /* Neighbor counts only change when dirt appears or disappears */
+        if (Pixel::IsDirt(pixel) != Pixel::IsDirt(value))
+            this->dirt_adjacency_data.Invalidate(pos);
+    }
+    pixel = value;
 }
 
 void Level::SetPixel(Position pos, LevelPixel voxel)
 {
     assert(IsInBounds(pos));
 
-    SetLevelData(pos.y * this->size.x + pos.x, voxel);
-    CommitPixel(pos);
+    SetLevelData(pos, voxel, true);
+    if (this->is_batching_edits)
+        this->tick_edits.Set(this->size.Index(pos), voxel);
+    else
+        CommitPixel(pos);
+}
+
+void Level::BeginEdits()
+{
+    assert(!this->is_batching_edits);
+    this->is_batching_edits = true;
+}
+
+int Level::CommitEdits()
+{
+    assert(this->is_batching_edits);
+    this->is_batching_edits = false;
+
+    this->tick_edits.Coalesce();
+    this->tick_edits.ForEachSpan(this->size.x,
+                                 [this](Position start, int length) { CommitRect(Rect{start, Size{length, 1}}); });
+    int committed = this->tick_edits.GetCount();
+    this->tick_edits.Clear();
+    return committed;
+}
+
+void Level::ApplyEdits(LevelEditBatch & batch)
+{
+    batch.Coalesce();
+    for (const LevelEditBatch::Edit & edit : batch.GetEdits())
+    {
+        SetLevelData(edit.offset, edit.value, true);
+        if (this->is_batching_edits)
+            this->tick_edits.Set(edit.offset, edit.value);
+    }
+    if (!this->is_batching_edits)
+        batch.ForEachSpan(this->size.x, [this](Position start, int length) { CommitRect(Rect{start, Size{length, 1}}); });
+    batch.Clear();
 }
 
 void Level::SetVoxelRaw(Position pos, LevelPixel voxel) { SetLevelData(pos, voxel); }
 
+void Level::FillVoxelsRaw(Position pos, int count, LevelPixel voxel)
+{
+    assert(!this->is_ready && pos.x + count <= this->size.x);
+    std::fill_n(&this->data[pos], count, voxel);
+}
+
 /*
 void Level::SetVoxelRaw(int offset, LevelPixel voxel)
 {
@@ -69,32 +134,72 @@ void Level::SetVoxelRaw(int offset, LevelPixel voxel)
 
 int Level::CountNeighbors(Position pos, LevelPixel value)
 {
-    return !!(value == GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y - 1)))) +
-           !!(value == GetVoxelRaw((pos.x + GetSize().x * (pos.y - 1)))) +
-           !!(value == GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y - 1)))) +
-           !!(value == GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y)))) +
-           !!(value == GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y)))) +
-           !!(value == GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y + 1)))) +
-           !!(value == GetVoxelRaw((pos.x + GetSize().x * (pos.y + 1)))) +
-           !!(value == GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y + 1))));
+    return !!(value == GetVoxelRaw(Position{pos.x - 1, pos.y - 1})) +
+           !!(value == GetVoxelRaw(Position{pos.x, pos.y - 1})) +
+           !!(value == GetVoxelRaw(Position{pos.x + 1, pos.y - 1})) +
+           !!(value == GetVoxelRaw(Position{pos.x - 1, pos.y})) +
+           !!(value == GetVoxelRaw(Position{pos.x + 1, pos.y})) +
+           !!(value == GetVoxelRaw(Position{pos.x - 1, pos.y + 1})) +
+           !!(value == GetVoxelRaw(Position{pos.x, pos.y + 1})) +
+           !!(value == GetVoxelRaw(Position{pos.x + 1, pos.y + 1}));
 }
 
 void Level::MaterializeLevelTerrainAndBases()
 {
     assert(!is_ready);
+    if (this->streaming)
+    {
+        /* Only the surroundings of the bases, the rest comes as tanks get near */
+        this->is_ready = true;
+        const int margin = tweak::world::StreamTankMargin;
+        for (const TankBase & base : this->tank_bases)
+            MaterializeTiles(Rect{base.GetPosition() - Size{margin, margin}, Size{2 * margin + 1, 2 * margin + 1}});
+        this->CreateBases();
+        return;
+    }
     this->GenerateDirtAndRocks();
     this->CreateBases();
+    this->RebuildPlanes();
+    this->RefreshDirtAdjacency();
     this->is_ready = true;
 }
 
+void Level::RebuildPlanes()
+{
+    parallel_for(
+        [this](int from_y, int until_y, ThreadLocal *) {
+            this->planes.Rebuild(this->data, from_y, until_y);
+            return 0;
+        },
+        0, this->size.y - 1);
+}
+
+void Level::RefreshDirtAdjacency(WorkerCount worker_count)
+{
+    /* Row bands never share bytes of the cache */
+    parallel_for(
+        [this](int from_y, int until_y, ThreadLocal *) {
+            return this->dirt_adjacency_data.Refresh(
+                Rect{Position{0, from_y}, Size{this->size.x, until_y - from_y + 1}});
+        },
+        0, this->size.y - 1, worker_count);
+}
+
+bool Level::IsPixelInPlane(Position pos, LevelPlane plane) const
+{
+    assert(this->is_ready);
+    if (!IsInBounds(pos))
+        return LevelBitPlanes::GetPlaneMask(LevelPixel::Rock) & (1u << static_cast<int>(plane));
+    return this->planes.Get(plane, pos);
+}
+
 LevelPixel Level::GetPixel(Position pos) const
 {
     if (!IsInBounds(pos))
         return LevelPixel::Rock;
-    return this->data[pos.y * this->size.x + pos.x];
+    return this->data[this->size.Index(pos)];
 }
 
-LevelPixel Level::GetVoxelRaw(Position pos) const { return this->data[pos.y * this->size.x + pos.x]; }
 
 //LevelPixel Level::GetVoxelRaw(int address) const
 //{
@@ -103,16 +208,19 @@ LevelPixel Level::GetVoxelRaw(Position pos) const { return this->data[pos.y * th
 
 void Level::GenerateDirtAndRocks()
 {
-    Position pos;
-    for (pos.y = 0; pos.y < this->size.y; pos.y++)
-        for (pos.x = 0; pos.x < this->size.x; pos.x++)
+    /* One random stream per row keeps the result independent of how rows are split between workers */
+    const std::uint64_t seed = std::uint64_t(ThreadRandom().Int(0, std::numeric_limits<int>::max()));
+    ForEachRowParallel([this, seed](int y, LevelPixel * row, ThreadLocal *) {
+        StreamRandom random = {seed, std::uint64_t(y)};
+        for (int x = 0; x < this->size.x; ++x)
         {
-            auto spot = this->GetPixel(pos);
-            if (spot != LevelPixel::LevelGenDirt)
-                this->SetPixel(pos, LevelPixel::Rock);
+            if (row[x] != LevelPixel::LevelGenDirt)
+                row[x] = LevelPixel::Rock;
             else
-                this->SetPixel(pos, Random.Bool(500) ? LevelPixel::DirtLow : LevelPixel::DirtHigh);
+                row[x] = random.Bool(500) ? LevelPixel::DirtLow : LevelPixel::DirtHigh;
         }
+        return 0;
+    });
 }
 
 void Level::CreateBase(Position pos, TankColor color)
@@ -120,22 +228,13 @@ void Level::CreateBase(Position pos, TankColor color)
     if (color >= tweak::world::MaxPlayers)
         return;
 
-    for (int y = -tweak::base::BaseSize / 2; y <= tweak::base::BaseSize / 2; y++)
-    {
-        for (int x = -tweak::base::BaseSize / 2; x <= tweak::base::BaseSize / 2; x++)
-        {
-            Position pix = pos + Offset{x, y};
-            if (abs(x) == tweak::base::BaseSize / 2 || abs(y) == tweak::base::BaseSize / 2)
-            { // Outline
-                if (x >= -tweak::base::DoorSize / 2 && x <= tweak::base::DoorSize / 2)
-                    SetPixel(pix, LevelPixel::BaseBarrier);
-                else
-                    SetPixel(pix, static_cast<LevelPixel>(static_cast<char>(LevelPixel::BaseMin) + color));
-            }
-            else
-                SetPixel(pix, LevelPixel::Blank);
-        }
-    }
+    /* Outline of the base color with a door of barrier at the top and the bottom, blank inside */
+    const int half = tweak::base::BaseSize / 2, door_half = tweak::base::DoorSize / 2;
+    const Rect outline = {pos - Size{half, half}, Size{2 * half + 1, 2 * half + 1}};
+    FillShape(RectShape{outline}, static_cast<LevelPixel>(static_cast<char>(LevelPixel::BaseMin) + color));
+    FillShape(RectShape{Rect{outline.pos + Offset{1, 1}, Size{2 * half - 1, 2 * half - 1}}}, LevelPixel::Blank);
+    for (int y : {outline.Top(), outline.Bottom()})
+        FillShape(RectShape{Rect{pos.x - door_half, y, 2 * door_half + 1, 1}}, LevelPixel::BaseBarrier);
 }
 
 /* TODO: Rethink the method for adding bases, as the current method DEMANDS that
@@ -170,43 +269,108 @@ void Level::SetSpawn(TankColor color, Position position)
 
 DigResult Level::DigTankTunnel(Position pos, bool dig_with_torch)
 {
+    static const StampMask tunnel = StampMask::RoundedSquare(3);
     auto result = DigResult{};
 
-    for (int ty = pos.y - 3; ty <= pos.y + 3; ty++)
-        for (int tx = pos.x - 3; tx <= pos.x + 3; tx++)
+    RewriteShape(StampShape{tunnel, pos}, [&result, dig_with_torch](LevelPixel pixel) {
+        if (Pixel::IsDiggable(pixel))
         {
-            LevelPixel pixel = GetPixel({tx, ty});
-
-            /* Don't take out the corners: */
-            if ((tx == pos.x - 3 || tx == pos.x + 3) && (ty == pos.y - 3 || ty == pos.y + 3))
-                continue;
-
-            if (Pixel::IsDiggable(pixel))
-            {
-                SetPixel({tx, ty}, LevelPixel::Blank);
-                if (Pixel::IsDirt(pixel))
-                    ++result.dirt;
-            }
-            else if (Pixel::IsTorchable(pixel) && dig_with_torch && Random.Bool(tweak::world::DigThroughRockChance))
-            {
-                SetPixel({tx, ty}, LevelPixel::Blank);
-                if (Pixel::IsMineral(pixel))
-                    ++result.minerals;
-            }
+            if (Pixel::IsDirt(pixel))
+                ++result.dirt;
+            return LevelPixel::Blank;
         }
+        if (Pixel::IsTorchable(pixel) && dig_with_torch && Random.Bool(tweak::world::DigThroughRockChance))
+        {
+            if (Pixel::IsMineral(pixel))
+                ++result.minerals;
+            return LevelPixel::Blank;
+        }
+        return pixel;
+    });
 
     return result;
 }
 
 void Level::CommitAll()
 {
-    for (int y = 0; y < this->size.y; y++)
+    if (this->streaming)
+    {
+        for (int tile = 0; tile < this->tiles.GetTileTotal(); ++tile)
+            if (this->streaming->IsResident(tile))
+                CommitRect(this->tiles.GetTileRect(tile));
+        return;
+    }
+    if (this->is_deferring_presentation)
+        return CommitRect(Rect{Position{0, 0}, this->size});
+
+    parallel_for(
+        [this](int from_y, int until_y, ThreadLocal *) {
+            CommitRect(Rect{Position{0, from_y}, Size{this->size.x, until_y - from_y + 1}});
+            return 0;
+        },
+        0, this->size.y - 1);
+}
+
+int Level::CommitChangedTiles()
+{
+    return this->tiles.ConsumeDirty([this](int, Rect tile_rect) { CommitRect(tile_rect); });
+}
+
+void Level::SetDeferredPresentation(bool is_deferred)
+{
+    if (!is_deferred)
+        PresentTerrain();
+    this->is_deferring_presentation = is_deferred;
+}
+
+int Level::PresentTerrain()
+{
+    int presented = 0;
+    for (PresentationStep step : this->presentation_queue)
     {
-        for (int x = 0; x < this->size.x; x++)
+        if (step.is_discard)
         {
-            CommitPixel({x, y});
+            DiscardSurfacePages(step.rect);
+            continue;
         }
+        MaterializeRect(step.rect);
+        presented += step.rect.size.x * step.rect.size.y;
     }
+    this->presentation_queue.clear();
+    return presented;
+}
+
+void Level::CommitRect(Rect rect)
+{
+    if (this->is_deferring_presentation)
+        this->presentation_queue.push_back(PresentationStep{rect});
+    else
+        MaterializeRect(rect);
+}
+
+void Level::DiscardSurfaceRect(Rect rect)
+{
+    /* The surface may be drawn right now. It gives its pages back between frames, in order with the commits. */
+    if (this->is_deferring_presentation)
+        this->presentation_queue.push_back(PresentationStep{rect, true});
+    else
+        DiscardSurfacePages(rect);
+}
+
+void Level::DiscardSurfacePages(Rect rect)
+{
+    if (rect.size.x == this->size.x)
+        return this->surfaces.terrain_surface.Discard(this->size.Index(rect.pos),
+                                                      std::size_t(rect.size.x) * rect.size.y);
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+        this->surfaces.terrain_surface.Discard(this->size.Index(Position{rect.Left(), y}), std::size_t(rect.size.x));
+}
+
+void Level::MaterializeRect(Rect rect)
+{
+    for (int y = rect.Top(); y <= rect.Bottom(); y++)
+        MaterializeRow(&this->data[this->size.Index(Position{rect.Left(), y})],
+                       this->surfaces.terrain_surface.GetRawRow(y) + rect.Left(), rect.size.x);
 }
 
 bool Level::IsInBounds(Position pos) const
@@ -214,12 +378,18 @@ bool Level::IsInBounds(Position pos) const
     return !(pos.x < 0 || pos.y < 0 || pos.x >= this->size.x || pos.y >= this->size.y);
 }
 
-void Level::CommitPixel(Position pos) { surfaces.terrain_surface.SetPixel(pos, GetVoxelColor(this->GetPixel(pos))); }
+void Level::CommitPixel(Position pos)
+{
+    if (this->is_deferring_presentation)
+        CommitRect(Rect{pos, Size{1, 1}});
+    else
+        surfaces.terrain_surface.SetPixel(pos, GetVoxelColor(this->GetPixel(pos)));
+}
 
 void Level::CommitPixels(const std::vector<Position> & positions)
 {
     for (auto & position : positions)
-        surfaces.terrain_surface.SetPixel(position, GetVoxelColor(this->GetPixel(position)));
+        CommitPixel(position);
 }
 
 /* TODO: This needs to be done in a different way, as this approach will take 
@@ -238,7 +408,26 @@ TankBase * Level::CheckBaseCollision(Position pos)
     return nullptr;
 }
 
+const std::array<RenderedPixel, 256> & Level::GetVoxelColorTable()
+{
+    /* Built on first use, the palette is a global of another translation unit */
+    static const std::array<RenderedPixel, 256> table = [] {
+        std::array<RenderedPixel, 256> colors = {};
+        for (int i = 0; i < 256; ++i)
+            colors[i] = ComputeVoxelColor(static_cast<LevelPixel>(static_cast<char>(i)));
+        return colors;
+    }();
+    return table;
+}
+
 Color Level::GetVoxelColor(LevelPixel voxel)
+{
+    RenderedPixel color = GetVoxelColorTable()[static_cast<unsigned char>(voxel)];
+    assert(color.a != 0 && "Unknown voxel.");
+    return color;
+}
+
+Color Level::ComputeVoxelColor(LevelPixel voxel)
 {
     if (voxel == LevelPixel::DirtHigh)
         return Palette.Get(Colors::DirtHigh);
@@ -268,11 +457,8 @@ Color Level::GetVoxelColor(LevelPixel voxel)
         return Palette.Get(Colors::EnergyFieldHigh);
     else if (Pixel::IsBase(voxel))
         return Palette.GetTank(static_cast<char>(voxel) - static_cast<char>(LevelPixel::BaseMin))[0];
-    else
-    {
-        assert(!"Unknown voxel.");
+    else /* Unknown voxel, stays transparent */
         return {};
-    }
 }
 
 /* Dumps a level into a BMP file: */
@@ -282,8 +468,14 @@ void Level::DumpBitmap(const char * filename) const
     {
         auto color_data = ColorBitmap{this->size};
 
-        for (int i = 0; i < this->size.y * this->size.x; i++)
-            color_data[i] = static_cast<Color>(GetVoxelColor(this->GetVoxelRaw(i)));
+        parallel_for(
+            [this, &color_data](int from_y, int until_y, ThreadLocal *) {
+                for (int y = from_y; y <= until_y; ++y)
+                    MaterializeRow(&this->data[this->size.Index(Position{0, y})], &color_data[y * this->size.x],
+                                   this->size.x);
+                return 0;
+            },
+            0, this->size.y - 1);
 
         {
             [[maybe_unused]] auto trace = MeasureFunction<5>("DumpBitmap");
@@ -291,3 +483,187 @@ void Level::DumpBitmap(const char * filename) const
         }
     }
 }
+
+int Level::MaterializeTiles(Rect rect)
+{
+    assert(this->streaming && this->is_ready);
+    const Position first = {std::max(rect.Left(), 0), std::max(rect.Top(), 0)};
+    const Position last = {std::min(rect.Right(), this->size.x - 1), std::min(rect.Bottom(), this->size.y - 1)};
+    if (first.x > last.x || first.y > last.y)
+        return 0;
+
+    std::vector<int> loaded;
+    const int first_tile = this->tiles.GetTileIndex(first), last_tile = this->tiles.GetTileIndex(last);
+    const int tile_count_x = this->tiles.GetTileCount().x;
+    for (int row = first_tile / tile_count_x; row <= last_tile / tile_count_x; ++row)
+        for (int column = first_tile % tile_count_x; column <= last_tile % tile_count_x; ++column)
+            if (!this->streaming->IsResident(column + row * tile_count_x))
+                loaded.push_back(column + row * tile_count_x);
+    if (loaded.empty())
+        return 0;
+
+    /* Tiles are disjoint in the level data and in whole words of the planes */
+    parallel_for(
+        [this, &loaded](int from, int until, ThreadLocal *) {
+            for (int i = from; i <= until; ++i)
+            {
+                const Rect tile_rect = this->tiles.GetTileRect(loaded[i]);
+                this->streaming->Load(loaded[i], tile_rect, &this->data[tile_rect.pos], this->size.x);
+                this->planes.Rebuild(this->data, tile_rect);
+                this->dirt_adjacency_data.Invalidate(tile_rect);
+            }
+            return 0;
+        },
+        0, int(loaded.size()) - 1);
+
+    for (int tile : loaded)
+    {
+        this->streaming->MarkResident(tile);
+        this->tiles.MarkReplaced(tile);
+        CommitRect(this->tiles.GetTileRect(tile));
+    }
+    return int(loaded.size());
+}
+
+int Level::EvictTiles(const std::vector<Rect> & keep)
+{
+    assert(this->streaming && this->is_ready);
+    /* Snapshots would keep tiles that are not there anymore */
+    assert(this->snapshots.empty());
+
+    int evicted = 0;
+    int discarded_row = -1;
+    for (int tile = 0; tile < this->tiles.GetTileTotal(); ++tile)
+    {
+        const Rect tile_rect = this->tiles.GetTileRect(tile);
+        const int tile_row = tile / this->tiles.GetTileCount().x;
+        if (discarded_row >= 0 && discarded_row != tile_row)
+        {
+            DiscardTileRow(discarded_row);
+            discarded_row = -1;
+        }
+        if (!this->streaming->IsResident(tile) ||
+            std::any_of(keep.begin(), keep.end(), [tile_rect](Rect rect) { return rect.Intersects(tile_rect); }))
+            continue;
+
+        this->streaming->Evict(tile, tile_rect, &this->data[tile_rect.pos], this->size.x);
+        this->planes.Clear(tile_rect);
+        this->dirt_adjacency_data.Invalidate(tile_rect);
+        this->tiles.MarkReplaced(tile);
+        discarded_row = tile_row;
+        ++evicted;
+    }
+    if (discarded_row >= 0)
+        DiscardTileRow(discarded_row);
+    return evicted;
+}
+
+void Level::DiscardTileRow(int tile_row)
+{
+    const int tile_count_x = this->tiles.GetTileCount().x;
+    const Rect row_rect = this->tiles.GetTileRect(tile_row * tile_count_x);
+
+    /* Pages are rows of the level, so only runs of non-resident tiles free anything */
+    for (int column = 0; column < tile_count_x;)
+    {
+        if (this->streaming->IsResident(column + tile_row * tile_count_x))
+        {
+            ++column;
+            continue;
+        }
+        const int from_x = this->tiles.GetTileRect(column + tile_row * tile_count_x).Left();
+        while (column < tile_count_x && !this->streaming->IsResident(column + tile_row * tile_count_x))
+            ++column;
+        const int until_x = column < tile_count_x ? this->tiles.GetTileRect(column + tile_row * tile_count_x).Left()
+                                                  : this->size.x;
+        if (from_x == 0 && until_x == this->size.x)
+        {
+            /* Whole band is gone, its planes are cleared and its adjacency can be computed again */
+            this->data.Discard(this->size.Index(row_rect.pos), std::size_t(this->size.x) * row_rect.size.y);
+            DiscardSurfaceRect(Rect{row_rect.pos, Size{this->size.x, row_rect.size.y}});
+            this->planes.Discard(row_rect.Top(), row_rect.Bottom());
+            this->dirt_adjacency_data.Discard(row_rect.Top(), row_rect.Bottom());
+            return;
+        }
+        for (int y = row_rect.Top(); y <= row_rect.Bottom(); ++y)
+            this->data.Discard(this->size.Index(Position{from_x, y}), std::size_t(until_x - from_x));
+        DiscardSurfaceRect(Rect{Position{from_x, row_rect.Top()}, Size{until_x - from_x, row_rect.size.y}});
+    }
+}
+
+std::unique_ptr<LevelSnapshot> Level::TakeSnapshot()
+{
+    assert(this->is_ready && !this->streaming);
+    std::unique_ptr<LevelSnapshot> snapshot{new LevelSnapshot(this)};
+
+    std::lock_guard lock(this->snapshot_mutex);
+    /* Every tile is now unpreserved for the new generation */
+    ++this->snapshot_generation;
+    this->snapshots.push_back(snapshot.get());
+    return snapshot;
+}
+
+void Level::ReleaseSnapshot(LevelSnapshot * snapshot)
+{
+    std::lock_guard lock(this->snapshot_mutex);
+    std::erase(this->snapshots, snapshot);
+}
+
+void Level::PreserveTile(int tile)
+{
+    const LevelTiles::Version generation = this->snapshot_generation;
+    if (this->tiles.GetPreservedGeneration(tile) == generation)
+        return;
+
+    std::lock_guard lock(this->snapshot_mutex);
+    /* Another writer into the same tile may have copied it while we waited */
+    if (this->tiles.GetPreservedGeneration(tile) == generation)
+        return;
+
+    const Rect rect = this->tiles.GetTileRect(tile);
+    auto copy = std::make_shared<LevelPixel[]>(LevelSnapshot::TileSize * LevelSnapshot::TileSize);
+    for (int y = 0; y < rect.size.y; ++y)
+        std::copy_n(&this->data[this->size.Index(Position{rect.pos.x, rect.pos.y + y})], rect.size.x,
+                    &copy[y * LevelSnapshot::TileSize]);
+
+    for (LevelSnapshot * snapshot : this->snapshots)
+        if (!snapshot->tiles[tile])
+            snapshot->tiles[tile] = copy;
+    this->tiles.SetPreservedGeneration(tile, generation);
+}
+
+int Level::RestoreSnapshot(const LevelSnapshot & snapshot)
+{
+    assert(snapshot.level == this);
+
+    int restored = 0;
+    for (int tile = 0; tile < int(snapshot.tiles.size()); ++tile)
+    {
+        const LevelSnapshot::TileData & saved = snapshot.tiles[tile];
+        if (!saved)
+            continue;
+
+        /* Restoring is a write like any other, other live snapshots have to keep the current tile */
+        PreserveTile(tile);
+        const Rect rect = this->tiles.GetTileRect(tile);
+        for (int y = 0; y < rect.size.y; ++y)
+            std::copy_n(&saved[y * LevelSnapshot::TileSize], rect.size.x,
+                        &this->data[this->size.Index(Position{rect.pos.x, rect.pos.y + y})]);
+        this->tiles.MarkChanged(rect.pos);
+        this->planes.Rebuild(this->data, rect);
+        this->dirt_adjacency_data.Invalidate(rect);
+        ++restored;
+    }
+    return restored;
+}
+
+void Level::RestoreLevelData(const std::vector<LevelPixel> & pixels)
+{
+    assert(this->is_ready && !this->streaming && this->snapshots.empty());
+    assert(pixels.size() == std::size_t(this->size.x) * this->size.y);
+
+    std::copy(pixels.begin(), pixels.end(), this->data.begin());
+    this->tiles.MarkAllChanged();
+    RebuildPlanes();
+    this->dirt_adjacency_data.InvalidateAll();
+}
@@ -2,11 +2,20 @@
 
 #include "containers.h"
 #include "level_adjacency.h"
+#include "level_bitplanes.h"
+#include "level_edit_batch.h"
+#include "level_raster.h"
+#include "level_snapshot.h"
+#include "level_streaming.h"
+#include "level_tiles.h"
 #include "parallelism.h"
 #include "render_surface.h"
 #include "tank_base.h"
 #include "types.h"
+#include <array>
+#include <cassert>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 class World;
@@ -27,11 +36,24 @@ struct DigResult
 
 struct LevelSurfaces
 {
-    LevelSurfaces(Size size) : terrain_surface(size, false), objects_surface(size, true) {}
+    LevelSurfaces(Size size) : terrain_surface(size, false), objects_surface(size, true), back_objects_surface(size, true) {}
     /* Holds rendered texture of the terrain, materializing each LevelPixel into color */
     WorldRenderSurface terrain_surface; 
     /* Holds a layer of frequently changed objects that will be drawn on top of terrain*/
     WorldRenderSurface objects_surface; 
+    /* Objects of the next tick, drawn while objects_surface is being presented */
+    WorldRenderSurface back_objects_surface;
+
+    void SwapObjectSurfaces() { std::swap(this->objects_surface, this->back_objects_surface); }
+};
+
+/* Level row y with the rows around it, for 3x3 kernels. Above and below are null on the level edge. */
+struct LevelRowNeighborhood
+{
+    int y;
+    const LevelPixel * above;
+    LevelPixel * row;
+    const LevelPixel * below;
 };
 
 class Level
@@ -40,47 +62,142 @@ class Level
     Size size;
     Container2D<LevelPixel> data; /* Holds logical terrain pixels - enum LevelPixel : char */
     LevelSurfaces surfaces; /* Holds terrain and object surfaces for drawing */
+    LevelTiles tiles; /* Per-tile versions and dirty flags of the level data */
+    LevelBitPlanes planes; /* Packed pixel classification, valid once the level is materialized */
+    DirtAdjacencyData dirt_adjacency_data; /* Cached dirt neighbor counts, built on top of planes */
 
-    //DirtAdjacencyData dirt_adjacency_data;
     std::vector<TankBase> tank_bases;
     bool is_ready = false;
 
+    std::unique_ptr<LevelStreaming> streaming; /* Set for levels materialized tile by tile */
+
+    LevelEditBatch tick_edits; /* SetPixel writes made since BeginEdits, waiting for CommitEdits */
+    bool is_batching_edits = false;
+
+    /* Terrain surface work waiting for PresentTerrain, in order: commits and discards of evicted tiles */
+    struct PresentationStep
+    {
+        Rect rect;
+        bool is_discard = false;
+    };
+    std::vector<PresentationStep> presentation_queue;
+    bool is_deferring_presentation = false;
+
+    /* Live snapshots. Tiles are copied into them before the first write after the snapshot was taken. */
+    std::vector<LevelSnapshot *> snapshots;
+    LevelTiles::Version snapshot_generation = 0;
+    std::mutex snapshot_mutex;
+
+    friend class LevelSnapshot;
+
   private:
-    void SetLevelData(int i, LevelPixel value);
-    void SetLevelData(Position pos, LevelPixel value);
+    /* Committed writes are copied to the terrain surface by their caller, so they leave the tile clean */
+    void SetLevelData(std::size_t i, LevelPixel value, bool is_committed = false);
+    void SetLevelData(Position pos, LevelPixel value, bool is_committed = false);
 
   public:
     Level(Size size);
+    /* Streamed level: terrain comes from the source, and only around the places MaterializeTiles is called for */
+    Level(Size size, std::unique_ptr<LevelTileSource> && tile_source, std::uint64_t seed);
+    ~Level();
     void OnConnectWorld(World * world);
     void BeginGame();
 
     Size GetSize() const { return this->size; }
     LevelSurfaces * GetSurfaces() { return &this->surfaces; }
     const Container2D<LevelPixel> & GetLevelData() const { return this->data; }
+    const LevelTiles & GetTiles() const { return this->tiles; }
+    const LevelBitPlanes & GetPlanes() const { return this->planes; }
 
     /* Voxel get-set-reference operations */
     void SetPixel(Position pos, LevelPixel voxel);
     LevelPixel GetPixel(Position pos) const;
 
     void SetVoxelRaw(Position pos, LevelPixel voxel);
-    void SetVoxelRaw(int offset, LevelPixel voxel) { SetLevelData(offset, voxel); }
-    LevelPixel GetVoxelRaw(Position pos) const;
-    LevelPixel GetVoxelRaw(int offset) const { return this->data[offset]; }
+    void SetVoxelRaw(std::size_t offset, LevelPixel voxel) { SetLevelData(offset, voxel); }
+    LevelPixel GetVoxelRaw(Position pos) const { return this->data[pos]; }
+    LevelPixel GetVoxelRaw(std::size_t offset) const { return this->data[offset]; }
+    const LevelPixel * GetLevelRow(int y) const { return &this->data[Position{0, y}]; }
+    /* Write a run of pixels of one row. Only for filling in terrain before the level is materialized. */
+    void FillVoxelsRaw(Position pos, int count, LevelPixel voxel);
+    /* Shape writes (level_raster.h). Every pixel of the shape inside the level becomes pixel_func(current), in
+     * row-major order of the spans. Changed pixels are committed in one rectangle per shape, or join the edit batch. */
+    template <typename Shape, typename PixelFunc> /* LevelPixel(LevelPixel current) */
+    void RewriteShape(const Shape & shape, PixelFunc pixel_func);
+    template <typename Shape>
+    void FillShape(const Shape & shape, LevelPixel value)
+    {
+        RewriteShape(shape, [value](LevelPixel) { return value; });
+    }
+
+    /* Edit batching. Between BeginEdits and CommitEdits, SetPixel still writes level data right away,
+     * but the terrain surface is updated only by CommitEdits, once per pixel and in row spans. */
+    void BeginEdits();
+    int CommitEdits(); /* Returns number of distinct pixels committed */
+    /* Write all edits of the batch and commit them, or queue them for CommitEdits when batching */
+    void ApplyEdits(LevelEditBatch & batch);
 
     /* Terrain surface interaction */
     void CommitPixel(Position pos);
     void CommitPixels(const std::vector<Position>& positions);
+    template <typename Shape>
+    void CommitShape(const Shape & shape); /* One rectangle around the part of the shape inside the level */
     void CommitAll();
+    int CommitChangedTiles(); /* Commits only tiles written raw since the last call. Returns the number of tiles. */
+    /* Deferred presentation. While deferring, commits only queue their rectangles and PresentTerrain copies
+     * them into the terrain surface, so the surface can be drawn while the next tick writes level data. */
+    void SetDeferredPresentation(bool is_deferred);
+    int PresentTerrain(); /* Returns the number of pixels presented */
     void DumpBitmap(const char * filename) const;
 
+    /* Streaming. Tiles that are not resident have no terrain in the level data, the bit planes or the terrain
+     * surface: nothing collides with them, grows into them or draws them. Level data and terrain surface pages
+     * that only non-resident tiles use are given back to the system. */
+    bool IsStreamed() const { return this->streaming != nullptr; }
+    bool IsTileResident(int tile) const { return !this->streaming || this->streaming->IsResident(tile); }
+    /* Make all tiles touching the rectangle resident. Returns the number of tiles that were not. */
+    int MaterializeTiles(Rect rect);
+    /* Evict resident tiles that touch none of the rectangles. Returns the number of tiles evicted. */
+    int EvictTiles(const std::vector<Rect> & keep);
+    LevelStreamStats GetStreamStats() const
+    {
+        return this->streaming ? this->streaming->GetStats() : LevelStreamStats{};
+    }
+
+    /* Copy-on-write snapshots of the terrain. Taking one is O(tiles) and copies no pixels. Not for streamed levels.
+     * Must not be called while other threads write into the level. */
+    std::unique_ptr<LevelSnapshot> TakeSnapshot();
+    /* Write back the tiles that changed since the snapshot was taken. The terrain surface catches up
+     * on the next CommitChangedTiles. Returns the number of tiles restored. */
+    int RestoreSnapshot(const LevelSnapshot & snapshot);
+    /* Rollback without snapshots: overwrite all level data with a full copy of it, rebuild all bit planes and
+     * invalidate all adjacency. The terrain surface catches up on the next CommitChangedTiles. */
+    void RestoreLevelData(const std::vector<LevelPixel> & pixels);
+
     /* Color lookup. Can be somewhere else. */
     static Color GetVoxelColor(LevelPixel voxel);
+    /* Colors of a run of pixels, through a table indexed by the pixel value */
+    template <typename PixelType>
+    static void MaterializeRow(const LevelPixel * voxels, PixelType * colors, int count);
 
     /* Count neighbors is used when level building and for ad-hoc queries (e.g. dirt regeneration) */
     int CountNeighbors(Position pos, LevelPixel neighbor_value);
     template <typename CountFunc>
     int CountNeighborValues(Position pos, CountFunc count_func);
-    //uint8_t DirtPixelsAdjacent(Position pos) { return this->dirt_adjacency_data.Get(pos); }
+    uint8_t DirtPixelsAdjacent(Position pos) { return this->dirt_adjacency_data.Get(pos); }
+    /* Recompute all invalidated dirt neighbor counts */
+    void RefreshDirtAdjacency(WorkerCount worker_count = {});
+
+    /* Bit plane queries. Out-of-bounds pixels are treated as rock. */
+    bool IsPixelInPlane(Position pos, LevelPlane plane) const;
+    int CountNeighborsInPlane(Position pos, LevelPlane plane) const { return this->planes.CountNeighbors(plane, pos); }
+    int CountPixelsInPlane(Rect rect, LevelPlane plane) const { return this->planes.CountInRect(plane, rect); }
+    /* First pixel in plane the segment from-to passes through, not counting the pixel of from */
+    std::optional<Position> FirstCollisionAlongRay(PositionF from, PositionF to,
+                                                   LevelPlane plane = LevelPlane::Collision) const
+    {
+        return this->planes.FirstAlongRay(plane, from, to);
+    }
 
     void MaterializeLevelTerrainAndBases();
 
@@ -89,21 +206,49 @@ class Level
     template <typename VoxelFunc>
     void ForEachVoxelParallel(VoxelFunc func, WorkerCount worker_count = {});
 
+    /* Traversal in memory order, a whole row of GetSize().x pixels per call. Rows are written directly,
+     * so these are only for level generation, before the level is materialized. */
+    template <typename RowFunc> /* void(int y, LevelPixel * row) */
+    void ForEachRow(RowFunc row_func);
+    template <typename RowFunc> /* Result(int y, LevelPixel * row, ThreadLocal * local), results are summed */
+    auto ForEachRowParallel(RowFunc row_func, WorkerCount worker_count = {});
+    /* Rows [from_y, until_y] with their neighbors. Writes to a row are visible to the next row through above,
+     * and to the first row of the next slice of a parallel run as below, same as with GetVoxelRaw. */
+    template <typename RowFunc> /* void(const LevelRowNeighborhood & rows) */
+    void ForEachRowNeighborhood(RowFunc row_func, int from_y, int until_y);
+    template <typename RowFunc> /* Result(const LevelRowNeighborhood & rows, ThreadLocal * local) */
+    auto ForEachRowNeighborhoodParallel(RowFunc row_func, int from_y, int until_y, WorkerCount worker_count = {});
+
     /* Tank-related stuff */
     TankBase * GetSpawn(TankColor color);
     /* TODO: Don't allow modification of the vector */
     std::vector<TankBase> & GetSpawns() { return this->tank_bases; }
+    const std::vector<TankBase> & GetSpawns() const { return this->tank_bases; }
     void SetSpawn(TankColor color, std::unique_ptr<TankBase> && tank_base);
     void SetSpawn(TankColor color, Position position);
     DigResult DigTankTunnel(Position pos, bool dig_with_torch);
     TankBase * CheckBaseCollision(Position pos);
 
+    bool IsInBounds(Position pos) const;
+    bool IsInBounds(Rect rect) const { return IsInBounds(rect.pos) && IsInBounds(Position{rect.Right(), rect.Bottom()}); }
+
   private:
+    static Color ComputeVoxelColor(LevelPixel voxel);
+    static const std::array<RenderedPixel, 256> & GetVoxelColorTable();
+
     /* Level generation */
     void GenerateDirtAndRocks();
     void CreateBases();
 
-    bool IsInBounds(Position pos) const;
+    void RebuildPlanes();
+    void PreserveTile(int tile); /* Copy the tile into live snapshots that do not hold it yet */
+    void ReleaseSnapshot(LevelSnapshot * snapshot);
+    void CommitRect(Rect rect); /* Row batched copy of level colors into the terrain surface */
+    void DiscardTileRow(int tile_row); /* Give back the pages of runs of non-resident tiles in a row of tiles */
+    void DiscardSurfaceRect(Rect rect); /* Terrain surface part of DiscardTileRow, queued while deferring */
+    void MaterializeRect(Rect rect);
+    void DiscardSurfacePages(Rect rect);
+
     void CreateBase(Position pos, TankColor color);
 };
 
@@ -111,11 +256,11 @@ class SafePixelAccessor
 {
     Level * level;
     Position position;
-    int index;
+    std::size_t index;
 
   public:
     SafePixelAccessor(Level * level, Position pos, Size size)
-        : level(level), position(pos), index(pos.x + pos.y * size.x)
+        : level(level), position(pos), index(size.Index(pos))
     {
     }
     Position GetPosition() const { return this->position; }
@@ -127,8 +272,8 @@ template <typename VoxelFunc> // requires{ voxelFunc(Position, SafePixelAccessor
 void Level::ForEachVoxel(VoxelFunc voxelFunc)
 {
     Position pos;
-    for (pos.x = 0; pos.x < this->GetSize().x; ++pos.x)
-        for (pos.y = 0; pos.y < this->GetSize().y; ++pos.y)
+    for (pos.y = 0; pos.y < this->GetSize().y; ++pos.y)
+        for (pos.x = 0; pos.x < this->GetSize().x; ++pos.x)
         {
             voxelFunc(SafePixelAccessor(this, pos, this->GetSize()));
         }
@@ -138,26 +283,136 @@ void Level::ForEachVoxelParallel(VoxelFunc voxelFunc, WorkerCount worker_count)
 {
     auto parallel_slice = [this, voxelFunc](int min, int max, ThreadLocal * threadLocal) {
         Position pos;
-        for (pos.x = min; pos.x <= max; ++pos.x)
-            for (pos.y = 0; pos.y < this->GetSize().y; ++pos.y)
+        for (pos.y = min; pos.y <= max; ++pos.y)
+            for (pos.x = 0; pos.x < this->GetSize().x; ++pos.x)
             {
                 voxelFunc(this->GetVoxelRaw(pos), SafePixelAccessor(this, pos, this->GetSize()), threadLocal);
             }
         return 0;
     };
 
-    parallel_for(parallel_slice, 0, this->GetSize().x - 1, worker_count);
+    parallel_for(parallel_slice, 0, this->GetSize().y - 1, worker_count);
+}
+
+template <typename Shape, typename PixelFunc>
+void Level::RewriteShape(const Shape & shape, PixelFunc pixel_func)
+{
+    Position changed_min = {this->size.x, this->size.y}, changed_max = {-1, -1};
+    shape.ForEachSpan([this, &pixel_func, &changed_min, &changed_max](RasterSpan span) {
+        if (!ClipSpan(span, this->size))
+            return;
+        std::size_t offset = this->size.Index(span.pos);
+        for (int x = span.pos.x; x < span.pos.x + span.length; ++x, ++offset)
+        {
+            LevelPixel current = this->data[offset];
+            LevelPixel value = pixel_func(current);
+            if (value == current)
+                continue;
+            SetLevelData(Position{x, span.pos.y}, value, true);
+            if (this->is_batching_edits)
+                this->tick_edits.Set(offset, value);
+            changed_min = {std::min(changed_min.x, x), std::min(changed_min.y, span.pos.y)};
+            changed_max = {std::max(changed_max.x, x), std::max(changed_max.y, span.pos.y)};
+        }
+    });
+    /* The terrain surface is materialized together with the level */
+    if (this->is_ready && !this->is_batching_edits && changed_max.x >= 0)
+        CommitRect(Rect{changed_min, Size{changed_max.x - changed_min.x + 1, changed_max.y - changed_min.y + 1}});
+}
+
+template <typename Shape>
+void Level::CommitShape(const Shape & shape)
+{
+    Position min = {this->size.x, this->size.y}, max = {-1, -1};
+    shape.ForEachSpan([this, &min, &max](RasterSpan span) {
+        if (!ClipSpan(span, this->size))
+            return;
+        min = {std::min(min.x, span.pos.x), std::min(min.y, span.pos.y)};
+        max = {std::max(max.x, span.pos.x + span.length - 1), std::max(max.y, span.pos.y)};
+    });
+    if (max.x >= 0)
+        CommitRect(Rect{min, Size{max.x - min.x + 1, max.y - min.y + 1}});
+}
+
+template <typename RowFunc>
+void Level::ForEachRow(RowFunc row_func)
+{
+    assert(!this->is_ready);
+    for (int y = 0; y < this->size.y; ++y)
+        row_func(y, &this->data[Position{0, y}]);
+}
+
+template <typename RowFunc>
+auto Level::ForEachRowParallel(RowFunc row_func, WorkerCount worker_count)
+{
+    assert(!this->is_ready);
+    return parallel_for(
+        [this, &row_func](int from_y, int until_y, ThreadLocal * local) {
+            std::invoke_result_t<RowFunc, int, LevelPixel *, ThreadLocal *> result = {};
+            for (int y = from_y; y <= until_y; ++y)
+                result += row_func(y, &this->data[Position{0, y}], local);
+            return result;
+        },
+        0, this->size.y - 1, worker_count);
+}
+
+template <typename RowFunc>
+void Level::ForEachRowNeighborhood(RowFunc row_func, int from_y, int until_y)
+{
+    assert(!this->is_ready);
+    for (int y = from_y; y <= until_y; ++y)
+    {
+        LevelPixel * row = &this->data[Position{0, y}];
+        row_func(LevelRowNeighborhood{y, y > 0 ? row - this->size.x : nullptr, row,
+                                      y < this->size.y - 1 ? row + this->size.x : nullptr});
+    }
+}
+
+template <typename RowFunc>
+auto Level::ForEachRowNeighborhoodParallel(RowFunc row_func, int from_y, int until_y, WorkerCount worker_count)
+{
+    assert(!this->is_ready);
+    return parallel_for(
+        [this, &row_func](int from_y, int until_y, ThreadLocal * local) {
+            std::invoke_result_t<RowFunc, const LevelRowNeighborhood &, ThreadLocal *> result = {};
+            for (int y = from_y; y <= until_y; ++y)
+            {
+                LevelPixel * row = &this->data[Position{0, y}];
+                result += row_func(LevelRowNeighborhood{y, y > 0 ? row - this->size.x : nullptr, row,
+                                                        y < this->size.y - 1 ? row + this->size.x : nullptr},
+                                   local);
+            }
+            return result;
+        },
+        from_y, until_y, worker_count);
+}
+
+template <typename PixelType>
+void Level::MaterializeRow(const LevelPixel * voxels, PixelType * colors, int count)
+{
+    const std::array<RenderedPixel, 256> & table = GetVoxelColorTable();
+    int x = 0;
+    /* Independent lookups per iteration, so the loads overlap */
+    for (; x + 4 <= count; x += 4)
+    {
+        colors[x + 0] = table[static_cast<unsigned char>(voxels[x + 0])];
+        colors[x + 1] = table[static_cast<unsigned char>(voxels[x + 1])];
+        colors[x + 2] = table[static_cast<unsigned char>(voxels[x + 2])];
+        colors[x + 3] = table[static_cast<unsigned char>(voxels[x + 3])];
+    }
+    for (; x < count; ++x)
+        colors[x] = table[static_cast<unsigned char>(voxels[x])];
 }
 
 template <typename CountFunc>
 int Level::CountNeighborValues(Position pos, CountFunc count_func)
 {
-    return count_func(GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y - 1)))) +
-           count_func(GetVoxelRaw((pos.x + GetSize().x * (pos.y - 1)))) +
-           count_func(GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y - 1)))) +
-           count_func(GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y)))) +
-           count_func(GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y)))) +
-           count_func(GetVoxelRaw((pos.x - 1 + GetSize().x * (pos.y + 1)))) +
-           count_func(GetVoxelRaw((pos.x + GetSize().x * (pos.y + 1)))) +
-           count_func(GetVoxelRaw((pos.x + 1 + GetSize().x * (pos.y + 1))));
+    return count_func(GetVoxelRaw(Position{pos.x - 1, pos.y - 1})) +
+           count_func(GetVoxelRaw(Position{pos.x, pos.y - 1})) +
+           count_func(GetVoxelRaw(Position{pos.x + 1, pos.y - 1})) +
+           count_func(GetVoxelRaw(Position{pos.x - 1, pos.y})) +
+           count_func(GetVoxelRaw(Position{pos.x + 1, pos.y})) +
+           count_func(GetVoxelRaw(Position{pos.x - 1, pos.y + 1})) +
+           count_func(GetVoxelRaw(Position{pos.x, pos.y + 1})) +
+           count_func(GetVoxelRaw(Position{pos.x + 1, pos.y + 1}));
 }
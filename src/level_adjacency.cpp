@@ -1,14 +1,43 @@
 #include "level_adjacency.h"
-#include "level.h"
+#include <algorithm>
 
-DirtAdjacencyData::DirtAdjacencyData(Size size, Container2D<LevelPixel> * level_data)
-    : LevelAdjacencyData<uint8_t>(size), level_data(level_data)
+void LevelAdjacencyData::Invalidate(Rect rect)
 {
+    /* Neighborhood reaches one pixel further. Clip per axis so the row edges never wrap to the next row. */
+    const int from_x = std::max(0, rect.Left() - 1), until_x = std::min(this->size.x - 1, rect.Right() + 1);
+    const int from_y = std::max(0, rect.Top() - 1), until_y = std::min(this->size.y - 1, rect.Bottom() + 1);
+    if (from_x > until_x || from_y > until_y)
+        return;
+
+    for (int y = from_y; y <= until_y; ++y)
+    {
+        std::uint8_t * row = &this->array[std::size_t(y) * this->bytes_per_row];
+        int x = from_x;
+        /* Odd leading pixel shares its byte with a pixel outside of the rectangle */
+        if (x % 2 == 1)
+        {
+            std::atomic_ref<std::uint8_t>(row[x / 2]).fetch_and(0x0F, std::memory_order_relaxed);
+            ++x;
+        }
+        for (; x + 1 <= until_x; x += 2)
+            std::atomic_ref<std::uint8_t>(row[x / 2]).store(0, std::memory_order_relaxed);
+        if (x == until_x)
+            std::atomic_ref<std::uint8_t>(row[x / 2]).fetch_and(0xF0, std::memory_order_relaxed);
+    }
+}
+
+void LevelAdjacencyData::InvalidateAll() { std::fill(this->array.begin(), this->array.end(), 0); }
+
+void LevelAdjacencyData::Discard(int from_y, int until_y)
+{
+    const std::size_t first = std::size_t(from_y) * this->bytes_per_row;
+    const std::size_t count = std::size_t(until_y - from_y + 1) * this->bytes_per_row;
+    /* Bytes sharing a page with other rows are not discarded, invalidate them the usual way first */
+    std::fill_n(this->array.begin() + first, count, std::uint8_t{0});
+    this->array.Discard(first, count);
 }
 
-uint8_t DirtAdjacencyData::Get(Position pos)
+DirtAdjacencyData::DirtAdjacencyData(Size size, const LevelBitPlanes * planes)
+    : LevelAdjacencyData(size), planes(planes)
 {
-    return Parent::Get(pos, [this](Position pos) {
-        return uint8_t(Pixel::IsDirt(this->level_data->operator[](pos.x + pos.y * this->size.x)) ? 1 : 0);
-    });
 }
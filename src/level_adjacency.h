@@ -1,130 +1,142 @@
 ﻿#pragma once
+#include <atomic>
 #include <cstdint>
 #include <vector>
 
 
 #include "containers.h"
+#include "level_bitplanes.h"
 #include "level_pixel.h"
+#include "mapped_memory.h"
 #include "types.h"
 
 /*
  * Adjacency Data
  * Caches possibly expensive lookups into level_data, invalidated on each write to level_data
- *   Note: the invalidates can get expensive if we use too many maps
- * -1 is a reserved value for marking invalid / needing refresh
+ *   Values are 4 bits wide, two pixels share a byte. Each row starts on a new byte so rows never share bytes.
+ *   0xF is a reserved value for marking invalid / needing refresh
+ *   Nibbles are stored inverted, so untouched zero pages of the mapping read as invalid without being filled
+ *   Invalidation, lazy Get and Refresh of disjoint rectangles may all run from several threads at once. Get and
+ *   StoreIfInvalid must not run while the planes of the neighborhood are written: a count computed then is cached
+ *   and stays stale until the next Invalidate of that area. Regrowth decides on all pixels before it applies any
+ *   of its writes, which keeps the two apart.
  */
-template <typename ValueType>
 class LevelAdjacencyData
 {
+  public:
+    constexpr static std::uint8_t Invalid = 0xF;
+    constexpr static std::uint8_t MaxValue = Invalid - 1;
+
   protected:
-    using Container = std::vector<ValueType>;
-    Container array;
     Size size;
-
-    /* Take care not to interfere with this value */
-    constexpr static ValueType Invalid = std::numeric_limits<ValueType>::max();
+    int bytes_per_row;
+    MappedArray<std::uint8_t> array;
 
   protected:
-    LevelAdjacencyData(Size size) : size(size)
+    LevelAdjacencyData(Size size)
+        : size(size), bytes_per_row((size.x + 1) / 2), array(std::size_t(bytes_per_row) * size.y)
     {
-        array.resize(size.x * size.y, Invalid);
     }
 
   public:
-    template <typename AccumulationFuncType>
-    ValueType Get(Position pos, AccumulationFuncType neighbor_accum_func);
-    void Set(int i, ValueType value) { this->array[i] = value; }
-    void Set(Position pos, ValueType value) { this->array[pos.x + pos.y * this->size.x] = value; }
-    void Invalidate(int i) { Invalidate(Position{i % size.x, i / size.x}); };
-    void Invalidate(Position pos);
-
-    template <typename AccumulationFuncType>
-    static ValueType AccumulateFromNeighbors(Position pos, Size size, AccumulationFuncType accumulation_func);
+    template <typename ComputeFunc> /* uint8_t(Position pos) */
+    std::uint8_t Get(Position pos, ComputeFunc compute_func);
+    std::uint8_t GetCached(Position pos) const { return GetNibble(Byte(pos), pos.x); }
+
+    /* Invalidate all pixels whose neighborhood includes pos */
+    void Invalidate(Position pos) { Invalidate(Rect{pos, Size{1, 1}}); }
+    /* Invalidate all pixels whose neighborhood touches the rectangle */
+    void Invalidate(Rect rect);
+    void InvalidateAll();
+    /* Invalidate rows [from_y, until_y] and give the memory only they use back to the system */
+    void Discard(int from_y, int until_y);
+
+    /* Recompute all invalid pixels inside of the rectangle */
+    template <typename ComputeFunc>
+    int Refresh(Rect rect, ComputeFunc compute_func);
+
+  private:
+    std::atomic_ref<std::uint8_t> Byte(Position pos)
+    {
+        return std::atomic_ref<std::uint8_t>(this->array[std::size_t(pos.y) * this->bytes_per_row + pos.x / 2]);
+    }
+    std::atomic_ref<const std::uint8_t> Byte(Position pos) const
+    {
+        return std::atomic_ref<const std::uint8_t>(this->array[std::size_t(pos.y) * this->bytes_per_row + pos.x / 2]);
+    }
+    static int Shift(int x) { return (x % 2) * 4; }
+    template <typename ByteRef>
+    static std::uint8_t GetNibble(ByteRef byte, int x)
+    {
+        return ((byte.load(std::memory_order_relaxed) >> Shift(x)) & 0xF) ^ 0xF;
+    }
+    /* Store value only if the nibble is still invalid. Other nibble of the byte may change meanwhile. */
+    void StoreIfInvalid(Position pos, std::uint8_t value);
 };
 
-class DirtAdjacencyData : public LevelAdjacencyData<uint8_t>
+/*
+ * DirtAdjacencyData: number of dirt pixels among the 8 neighbors, computed from the dirt bit plane
+ */
+class DirtAdjacencyData : public LevelAdjacencyData
 {
-    using Parent = LevelAdjacencyData<uint8_t>;
-    Container2D<LevelPixel> * level_data;
+    const LevelBitPlanes * planes;
 
   public:
-    DirtAdjacencyData(Size size, Container2D<LevelPixel> * level_data);
-    uint8_t Get(Position pos);
+    DirtAdjacencyData(Size size, const LevelBitPlanes * planes);
+    std::uint8_t Get(Position pos)
+    {
+        return LevelAdjacencyData::Get(pos, [this](Position pos) { return Compute(pos); });
+    }
+    int Refresh(Rect rect)
+    {
+        return LevelAdjacencyData::Refresh(rect, [this](Position pos) { return Compute(pos); });
+    }
+
+  private:
+    std::uint8_t Compute(Position pos) const
+    {
+        return std::uint8_t(this->planes->CountNeighbors(LevelPlane::Dirt, pos));
+    }
 };
 
-template <typename ValueType>
-template <typename AccumulationFuncType>
-ValueType LevelAdjacencyData<ValueType>::Get(Position pos, AccumulationFuncType neighbor_accum_func)
+template <typename ComputeFunc>
+std::uint8_t LevelAdjacencyData::Get(Position pos, ComputeFunc compute_func)
 {
-    uint8_t & ret_val = this->array[pos.x + pos.y * this->size.x];
-    if (ret_val == Invalid)
+    std::uint8_t value = GetNibble(Byte(pos), pos.x);
+    if (value == Invalid)
     {
-        ret_val = AccumulateFromNeighbors(pos, this->size, neighbor_accum_func);
+        value = compute_func(pos);
+        StoreIfInvalid(pos, value);
     }
-    return ret_val;
+    return value;
 }
 
-template <typename ValueType>
-void LevelAdjacencyData<ValueType>::Invalidate(Position pos)
+template <typename ComputeFunc>
+int LevelAdjacencyData::Refresh(Rect rect, ComputeFunc compute_func)
 {
-    /* This might invalidate even pixels not really touching. But I think it's better to have as few conditional statements as possible. */
-    Set(std::max(0, pos.x - 1 + this->size.x * (pos.y - 1)), Invalid);
-    Set(std::max(0, pos.x + this->size.x * (pos.y - 1)), Invalid);
-    Set(std::max(0, pos.x + 1 + this->size.x * (pos.y - 1)), Invalid);
-    Set(std::max(0, pos.x - 1 + this->size.x * (pos.y)), Invalid);
-    Set(pos.x + this->size.x * (pos.y), Invalid);
-    Set(std::min(int(this->array.size()) - 1, pos.x + 1 + this->size.x * (pos.y)), Invalid);
-    Set(std::min(int(this->array.size()) - 1, pos.x - 1 + this->size.x * (pos.y + 1)), Invalid);
-    Set(std::min(int(this->array.size()) - 1, pos.x + this->size.x * (pos.y + 1)), Invalid);
-    Set(std::min(int(this->array.size()) - 1, pos.x + 1 + this->size.x * (pos.y + 1)), Invalid);
+    int refreshed = 0;
+    Position pos;
+    for (pos.y = rect.Top(); pos.y <= rect.Bottom(); ++pos.y)
+        for (pos.x = rect.Left(); pos.x <= rect.Right(); ++pos.x)
+        {
+            if (GetNibble(Byte(pos), pos.x) == Invalid)
+            {
+                StoreIfInvalid(pos, compute_func(pos));
+                ++refreshed;
+            }
+        }
+    return refreshed;
 }
 
-template <typename ValueType>
-template <typename AccumulationFuncType>
-ValueType LevelAdjacencyData<ValueType>::AccumulateFromNeighbors(Position pos, Size size,
-                                                                 AccumulationFuncType accumulation_func)
+inline void LevelAdjacencyData::StoreIfInvalid(Position pos, std::uint8_t value)
 {
-    ValueType value_sum = {};
-    value_sum += accumulation_func(Position{std::max(pos.x - 1, 0),          std::max(pos.y - 1, 0)});
-    value_sum += accumulation_func(Position{pos.x,                                       std::max(pos.y - 1, 0)});
-    value_sum += accumulation_func(Position{std::min(pos.x + 1, size.x - 1), std::max(pos.y - 1, 0)});
-    value_sum += accumulation_func(Position{std::max(pos.x - 1, 0),          pos.y});
-    /* Center */
-    value_sum += accumulation_func(Position{std::min(pos.x + 1, size.x - 1), pos.y});
-    value_sum += accumulation_func(Position{std::max(pos.x - 1, 0),          std::min(pos.y + 1, size.y - 1)});
-    value_sum += accumulation_func(Position{pos.x,                                       std::min(pos.y + 1, size.y - 1)});
-    value_sum += accumulation_func(Position{std::min(pos.x + 1, size.x - 1), std::min(pos.y + 1, size.y - 1)});
-    return value_sum;
-
-    /*
-    Position neighbor;
-    auto max_x = std::min(pos.x + 1, size.x - 1);
-    auto max_y = std::min(pos.y + 1, size.y - 1);
-    for (neighbor.x = std::max(0, pos.x - 1); neighbor.x <= max_x; ++neighbor.x)
-        for (neighbor.y = std::max(0, pos.y - 1); neighbor.y <= max_y; ++neighbor.y)
-            value_sum += accumulation_func(neighbor);
-
-    return value_sum;
-    */
+    auto byte = Byte(pos);
+    const int shift = Shift(pos.x);
+    std::uint8_t expected = byte.load(std::memory_order_relaxed);
+    while (((expected >> shift) & 0xF) == (Invalid ^ 0xF))
+    {
+        std::uint8_t desired = std::uint8_t((expected & ~(0xF << shift)) | ((value ^ 0xF) << shift));
+        if (byte.compare_exchange_weak(expected, desired, std::memory_order_relaxed))
+            break;
+    }
 }
-
-
-
-//template <typename ComputeFunc>
-//uint8_t LevelAdjacencyDataCompressed::operator[](int i) const
-//{
-//    uint8_t val = this->array[i / 2];
-//    if (i % 2 == 1)
-//        return val >> 4;
-//    return val & 0xF;
-//}
-//
-//template <typename ComputeFunc>
-//void LevelAdjacencyDataCompressed::Set(int i, uint8_t value)
-//{
-//    assert(value <= 0xF);
-//    uint8_t & val = this->array[i / 2];
-//    if (i % 2 == 1)
-//        val = (val & 0xF) | (value << 4);
-//    val = val & (0xF0 | (value & 0xF));
-//}
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "level_bitplanes.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+/* Plane membership for all 256 possible pixel values, so building planes needs no comparison chains */
+struct PlaneMaskTable
+{
+    std::array<unsigned, 256> masks = {};
+    PlaneMaskTable()
+    {
+        for (int i = 0; i < 256; ++i)
+        {
+            auto pixel = static_cast<LevelPixel>(static_cast<char>(i));
+            unsigned mask = 0;
+            mask |= Pixel::IsDirt(pixel) ? 1u << static_cast<int>(LevelPlane::Dirt) : 0;
+            mask |= Pixel::IsBlockingCollision(pixel) ? 1u << static_cast<int>(LevelPlane::Blocking) : 0;
+            mask |= Pixel::IsAnyCollision(pixel) ? 1u << static_cast<int>(LevelPlane::Collision) : 0;
+            mask |= Pixel::IsDiggable(pixel) ? 1u << static_cast<int>(LevelPlane::Diggable) : 0;
+            mask |= Pixel::IsEmpty(pixel) ? 1u << static_cast<int>(LevelPlane::Empty) : 0;
+            mask |= (Pixel::IsEmpty(pixel) || Pixel::IsScorched(pixel))
+                        ? 1u << static_cast<int>(LevelPlane::Regrowable) : 0;
+            masks[i] = mask;
+        }
+    }
+};
+const PlaneMaskTable plane_mask_table;
+} // namespace
+
+LevelBitPlanes::LevelBitPlanes(Size size) : size(size), words_per_row((size.x + WordBits - 1) / WordBits)
+{
+    for (auto & plane : this->planes)
+        plane = MappedArray<Word>(std::size_t(this->words_per_row) * size.y);
+}
+
+unsigned LevelBitPlanes::GetPlaneMask(LevelPixel pixel)
+{
+    return plane_mask_table.masks[static_cast<unsigned char>(pixel)];
+}
+
+void LevelBitPlanes::Rebuild(const Container2D<LevelPixel> & data, int from_y, int until_y)
+{
+    Rebuild(data, Rect{Position{0, from_y}, Size{this->size.x, until_y - from_y + 1}});
+}
+
+void LevelBitPlanes::Rebuild(const Container2D<LevelPixel> & data, Rect rect)
+{
+    static_assert(PlaneCount <= 8, "Plane masks of eight pixels are packed into one word, a byte each");
+    const int from_word = rect.Left() / WordBits, until_word = rect.Right() / WordBits;
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        for (int word = from_word; word <= until_word; ++word)
+        {
+            std::array<Word, PlaneCount> values = {};
+            const int from_x = word * WordBits;
+            const int count = std::min(WordBits, this->size.x - from_x);
+            const LevelPixel * pixels = &data[this->size.Index(Position{from_x, y})];
+            for (int group = 0; group * 8 < count; ++group)
+            {
+                Word masks = 0;
+                for (int i = 0; i < 8 && group * 8 + i < count; ++i)
+                    masks |= Word(GetPlaneMask(pixels[group * 8 + i])) << (8 * i);
+                /* Gather bit `plane` of every byte into eight adjacent bits, without carries between them */
+                for (int plane = 0; plane < PlaneCount; ++plane)
+                    values[plane] |= (((masks >> plane) & 0x0101010101010101ull) * 0x0102040810204080ull >> 56)
+                                     << (8 * group);
+            }
+            for (int plane = 0; plane < PlaneCount; ++plane)
+                this->planes[plane][std::size_t(y) * this->words_per_row + word] = values[plane];
+        }
+    }
+}
+
+void LevelBitPlanes::Clear(Rect rect)
+{
+    const int from_word = rect.Left() / WordBits, until_word = rect.Right() / WordBits;
+    for (auto & plane : this->planes)
+        for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+            std::fill(&plane[std::size_t(y) * this->words_per_row + from_word],
+                      &plane[std::size_t(y) * this->words_per_row + until_word] + 1, Word{0});
+}
+
+void LevelBitPlanes::Discard(int from_y, int until_y)
+{
+    for (auto & plane : this->planes)
+        plane.Discard(std::size_t(from_y) * this->words_per_row, std::size_t(until_y - from_y + 1) * this->words_per_row);
+}
+
+int LevelBitPlanes::CountInRect(LevelPlane plane, Rect rect) const
+{
+    int count = 0;
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        const Word * row = GetRow(plane, y);
+        for (int x = rect.Left(); x <= rect.Right(); x += WordBits)
+            count += std::popcount(GetBits(row, x, std::min(WordBits, rect.Right() - x + 1)));
+    }
+    return count;
+}
+
+std::optional<Position> LevelBitPlanes::FirstAlongRay(LevelPlane plane, PositionF from, PositionF to) const
+{
+    const Position start = {int(std::floor(from.x)), int(std::floor(from.y))};
+    const Position end = {int(std::floor(to.x)), int(std::floor(to.y))};
+    const int step_x = to.x < from.x ? -1 : 1, step_y = to.y < from.y ? -1 : 1;
+    const bool is_inside = std::min(start.x, end.x) >= 0 && std::min(start.y, end.y) >= 0 &&
+                           std::max(start.x, end.x) < this->size.x && std::max(start.y, end.y) < this->size.y;
+    const Word * plane_words = this->planes[static_cast<int>(plane)].data();
+
+    /* Test pixels [first_x, last_x] of row y in the order the ray visits them. Sets hit_x on collision. */
+    int hit_x = 0;
+    auto test_span = [&](int y, int first_x, int last_x) -> bool {
+        if (!is_inside)
+        {
+            /* Spans can reach out of the level, test pixel by pixel */
+            const bool is_outside_hit = GetPlaneMask(LevelPixel::Rock) & (1u << static_cast<int>(plane));
+            for (hit_x = first_x; hit_x != last_x + step_x; hit_x += step_x)
+            {
+                bool is_pixel_inside = hit_x >= 0 && hit_x < this->size.x && y >= 0 && y < this->size.y;
+                if (is_pixel_inside ? Get(plane, Position{hit_x, y}) : is_outside_hit)
+                    return true;
+            }
+            return false;
+        }
+
+        const Word * row = plane_words + std::size_t(y) * this->words_per_row;
+        const int left = std::min(first_x, last_x), right = std::max(first_x, last_x);
+        /* Most spans fit into one word */
+        if (left / WordBits == right / WordBits)
+        {
+            const int count = right - left + 1;
+            Word bits = row[left / WordBits] >> (left % WordBits);
+            if (count < WordBits)
+                bits &= (Word{1} << count) - 1;
+            if (!bits)
+                return false;
+            hit_x = left + (step_x > 0 ? std::countr_zero(bits) : WordBits - 1 - std::countl_zero(bits));
+            return true;
+        }
+        if (step_x > 0)
+        {
+            for (int x = left; x <= right; x += WordBits)
+                if (Word bits = GetBits(row, x, std::min(WordBits, right - x + 1)))
+                    return hit_x = x + std::countr_zero(bits), true;
+        }
+        else
+        {
+            for (int x = right; x >= left; x -= WordBits)
+            {
+                int count = std::min(WordBits, x - left + 1);
+                if (Word bits = GetBits(row, x - count + 1, count))
+                    return hit_x = x - (count - 1) + (WordBits - 1 - std::countl_zero(bits)), true;
+            }
+        }
+        return false;
+    };
+
+    /* The starting pixel is not tested. It always comes first in its row. */
+    int first_x = start.x + step_x;
+    if (start.y == end.y)
+    {
+        if (start.x != end.x && test_span(start.y, first_x, end.x))
+            return Position{hit_x, start.y};
+        return std::nullopt;
+    }
+
+    /* x where the segment leaves the current row. Consecutive rows share the pixel column of the crossing. */
+    const double slope = (double(to.x) - from.x) / (double(to.y) - from.y);
+    double leave_x = from.x + ((step_y > 0 ? start.y + 1 : start.y) - double(from.y)) * slope;
+    for (int y = start.y;; y += step_y, leave_x += step_y * slope)
+    {
+        /* Truncation is floor inside of the level, and std::floor is a library call on baseline x86-64 */
+        int last_x = y == end.y ? end.x : (leave_x >= 0 ? int(leave_x) : int(std::floor(leave_x)));
+        if ((last_x - first_x) * step_x >= 0 && test_span(y, first_x, last_x))
+            return Position{hit_x, y};
+        if (y == end.y)
+            return std::nullopt;
+        first_x = last_x;
+    }
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "containers.h"
+#include "level_pixel.h"
+#include "mapped_memory.h"
+#include "types.h"
+
+/*
+ * LevelPlane: classes of pixels that are tracked in packed 1-bit-per-pixel planes
+ */
+enum class LevelPlane
+{
+    Dirt,       /* Pixel::IsDirt */
+    Blocking,   /* Pixel::IsBlockingCollision */
+    Collision,  /* Pixel::IsAnyCollision */
+    Diggable,   /* Pixel::IsDiggable */
+    Empty,      /* Pixel::IsEmpty */
+    Regrowable, /* Pixel::IsEmpty or Pixel::IsScorched: dirt can grow back here */
+    Count,
+};
+
+/*
+ * LevelBitPlanes
+ *  Packed bit masks classifying every pixel of the level. Each row starts on a new 64-bit word, bits past the
+ *  row end are always zero. Lets neighbour counts and region tests run as word operations and popcounts
+ *  instead of comparison chains per pixel.
+ */
+class LevelBitPlanes
+{
+  public:
+    using Word = std::uint64_t;
+    constexpr static int WordBits = 64;
+    constexpr static int PlaneCount = static_cast<int>(LevelPlane::Count);
+
+  private:
+    Size size;
+    int words_per_row;
+    std::array<MappedArray<Word>, PlaneCount> planes; /* Mapped, so huge levels start without touching them */
+
+  public:
+    LevelBitPlanes(Size size);
+
+    /* Recompute rows [from_y, until_y] from level data */
+    void Rebuild(const Container2D<LevelPixel> & data, int from_y, int until_y);
+    /* Rebuild whole words covering the rectangle */
+    void Rebuild(const Container2D<LevelPixel> & data, Rect rect);
+    /* Clear whole words covering the rectangle, its pixels are in no plane */
+    void Clear(Rect rect);
+    /* Give the memory of cleared rows [from_y, until_y] back to the system, they stay cleared */
+    void Discard(int from_y, int until_y);
+    /* Update a single pixel. Safe to call from several threads at once. */
+    void Set(Position pos, LevelPixel pixel);
+
+    int GetWordsPerRow() const { return this->words_per_row; }
+    const Word * GetRow(LevelPlane plane, int y) const
+    {
+        return &this->planes[static_cast<int>(plane)][std::size_t(y) * this->words_per_row];
+    }
+    bool Get(LevelPlane plane, Position pos) const
+    {
+        return (GetRow(plane, pos.y)[pos.x / WordBits] >> (pos.x % WordBits)) & 1;
+    }
+
+    /* Number of pixels in plane among the 8 neighbors of pos. Out-of-bounds pixels don't count. */
+    int CountNeighbors(LevelPlane plane, Position pos) const;
+    /* Number of pixels in plane inside of rectangle. Rectangle must be inside of the level. */
+    int CountInRect(LevelPlane plane, Rect rect) const;
+
+    /* First pixel in plane that the segment passes through, walking from `from` to `to`. The pixel holding
+     * `from` is not tested, same as with Raycaster::Cast. Out-of-bounds pixels are treated as rock.
+     * Works a row at a time: the pixels of the segment within one row are tested as a single bit span. */
+    std::optional<Position> FirstAlongRay(LevelPlane plane, PositionF from, PositionF to) const;
+
+    /* Word of row y covering pixels [word * 64, word * 64 + 63], shifted by one pixel left and right:
+     *  bit i of left is pixel (x - 1), bit i of right is pixel (x + 1). Out-of-bounds pixels read as zero. */
+    void GetNeighborWords(LevelPlane plane, int y, int word, Word & left, Word & center, Word & right) const;
+
+    /* Plane membership of a pixel value as a bit mask indexed by LevelPlane */
+    static unsigned GetPlaneMask(LevelPixel pixel);
+
+  private:
+    /* Bits [start, start + count) of a row, count <= 64. Bits outside of the row read as zero. */
+    Word GetBits(const Word * row, int start, int count) const;
+};
+
+/*
+ * BitSlicedCounter: counts up to 15 one-bit inputs for 64 lanes at once.
+ *  Lane i of bit_n holds bit n of the sum of lane i of all added words.
+ */
+struct BitSlicedCounter
+{
+    using Word = LevelBitPlanes::Word;
+    Word bit_0 = 0, bit_1 = 0, bit_2 = 0, bit_3 = 0;
+
+    void Add(Word input)
+    {
+        Word carry_0 = bit_0 & input;
+        bit_0 ^= input;
+        Word carry_1 = bit_1 & carry_0;
+        bit_1 ^= carry_0;
+        Word carry_2 = bit_2 & carry_1;
+        bit_2 ^= carry_1;
+        bit_3 |= carry_2;
+    }
+    /* Lanes where the sum is at least 3 */
+    Word AtLeast3() const { return bit_3 | bit_2 | (bit_1 & bit_0); }
+    /* Lanes where the sum is at least 5 */
+    Word AtLeast5() const { return bit_3 | (bit_2 & (bit_1 | bit_0)); }
+};
+
+inline void LevelBitPlanes::GetNeighborWords(LevelPlane plane, int y, int word, Word & left, Word & center,
+                                             Word & right) const
+{
+    const Word * row = GetRow(plane, y);
+    center = row[word];
+    left = (center << 1) | (word > 0 ? row[word - 1] >> (WordBits - 1) : 0);
+    right = (center >> 1) | (word + 1 < this->words_per_row ? row[word + 1] << (WordBits - 1) : 0);
+}
+
+inline LevelBitPlanes::Word LevelBitPlanes::GetBits(const Word * row, int start, int count) const
+{
+    Word mask = count == WordBits ? ~Word{0} : (Word{1} << count) - 1;
+    if (start < 0)
+        return (GetBits(row, 0, count + start) << -start) & mask;
+
+    int word = start / WordBits;
+    int bit = start % WordBits;
+    if (word >= this->words_per_row)
+        return 0;
+    Word value = row[word] >> bit;
+    if (bit + count > WordBits && word + 1 < this->words_per_row)
+        value |= row[word + 1] << (WordBits - bit);
+    return value & mask;
+}
+
+inline int LevelBitPlanes::CountNeighbors(LevelPlane plane, Position pos) const
+{
+    int count = 0;
+    if (pos.y > 0)
+        count += std::popcount(GetBits(GetRow(plane, pos.y - 1), pos.x - 1, 3));
+    count += std::popcount(GetBits(GetRow(plane, pos.y), pos.x - 1, 3) & 0b101);
+    if (pos.y < this->size.y - 1)
+        count += std::popcount(GetBits(GetRow(plane, pos.y + 1), pos.x - 1, 3));
+    return count;
+}
+
+inline void LevelBitPlanes::Set(Position pos, LevelPixel pixel)
+{
+    const unsigned plane_mask = GetPlaneMask(pixel);
+    const std::size_t word = std::size_t(pos.y) * this->words_per_row + pos.x / WordBits;
+    const Word bit = Word{1} << (pos.x % WordBits);
+    for (int plane = 0; plane < PlaneCount; ++plane)
+    {
+        /* Writers of neighboring pixels can share the word. Only touch it atomically and only when it changes. */
+        auto value = std::atomic_ref<Word>(this->planes[plane][word]);
+        bool is_set = value.load(std::memory_order_relaxed) & bit;
+        bool should_set = plane_mask & (1u << plane);
+        if (should_set && !is_set)
+            value.fetch_or(bit, std::memory_order_relaxed);
+        else if (!should_set && is_set)
+            value.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
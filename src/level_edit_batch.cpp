@@ -0,0 +1,22 @@
+#include "level_edit_batch.h"
+#include <algorithm>
+
+void LevelEditBatch::Coalesce()
+{
+    if (this->is_coalesced)
+        return;
+
+    /* Stable sort keeps writes to the same pixel in the order they were made. Keep the last one of each. */
+    std::stable_sort(this->edits.begin(), this->edits.end(),
+                     [](const Edit & left, const Edit & right) { return left.offset < right.offset; });
+    auto last = this->edits.begin();
+    for (auto it = this->edits.begin(); it != this->edits.end(); ++it)
+    {
+        if (it != this->edits.begin() && it->offset == (last - 1)->offset)
+            *(last - 1) = *it;
+        else
+            *last++ = *it;
+    }
+    this->edits.erase(last, this->edits.end());
+    this->is_coalesced = true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+
+#include "level_pixel.h"
+#include "types.h"
+
+/*
+ * LevelEditBatch
+ *  Terrain writes collected over a tick. Coalesce() orders them by level offset and keeps only the last
+ *  write of every pixel, so the terrain surface can be updated in one pass of row spans instead of
+ *  once per write.
+ *  A batch is not thread safe. Each producer fills its own and hands it over to Level::ApplyEdits.
+ */
+class LevelEditBatch
+{
+  public:
+    struct Edit
+    {
+        std::size_t offset;
+        LevelPixel value;
+    };
+
+  private:
+    std::vector<Edit> edits;
+    bool is_coalesced = true;
+
+  public:
+    void Set(std::size_t offset, LevelPixel value)
+    {
+        this->edits.push_back({offset, value});
+        this->is_coalesced = false;
+    }
+    void Clear()
+    {
+        this->edits.clear();
+        this->is_coalesced = true;
+    }
+    bool IsEmpty() const { return this->edits.empty(); }
+    int GetCount() const { return int(this->edits.size()); }
+
+    /* Sort by offset and drop all but the last write to each pixel */
+    void Coalesce();
+    const std::vector<Edit> & GetEdits() const { return this->edits; }
+
+    /* Call SpanFunc(Position start, int length) for every run of consecutive edited pixels of a row.
+     * Batch must be coalesced. */
+    template <typename SpanFunc>
+    void ForEachSpan(std::size_t row_width, SpanFunc span_func) const;
+};
+
+template <typename SpanFunc>
+void LevelEditBatch::ForEachSpan(std::size_t row_width, SpanFunc span_func) const
+{
+    std::size_t i = 0;
+    while (i < this->edits.size())
+    {
+        const std::size_t start = this->edits[i].offset;
+        std::size_t end = i + 1;
+        while (end < this->edits.size() && this->edits[end].offset == start + (end - i) &&
+               this->edits[end].offset % row_width != 0)
+            ++end;
+        span_func(Position{int(start % row_width), int(start / row_width)}, int(end - i));
+        i = end;
+    }
+}
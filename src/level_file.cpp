@@ -0,0 +1,240 @@
+#include "level_file.h"
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "exceptions.h"
+#include "gamelib.h"
+#include "level.h"
+#include "level_pixel.h"
+#include "level_tiles.h"
+#include "mapped_memory.h"
+#include "parallelism.h"
+#include "trace.h"
+#include "tweak.h"
+
+static_assert(std::endian::native == std::endian::little, "Level files are read and written in place");
+
+namespace
+{
+
+constexpr char FileMagic[4] = {'T', 'T', 'L', 'V'};
+constexpr std::uint32_t FileVersion = 1;
+constexpr int MaxRunLength = 256;
+
+struct FileHeader
+{
+    char magic[4];
+    std::uint32_t version;
+    std::int32_t width;
+    std::int32_t height;
+    std::uint32_t generator;
+    std::int32_t seed;
+    std::uint32_t generation_time_ms;
+    std::uint32_t spawn_count;
+    std::uint32_t tile_size;
+    std::uint32_t tile_count;
+};
+
+struct FileSpawn
+{
+    std::int32_t x;
+    std::int32_t y;
+};
+
+std::vector<std::uint8_t> EncodeTile(const Level & level, Rect rect)
+{
+    std::vector<std::uint8_t> encoded;
+    LevelPixel run_value = {};
+    int run_length = 0;
+    auto flush = [&]() {
+        if (run_length)
+        {
+            encoded.push_back(std::uint8_t(run_length - 1));
+            encoded.push_back(std::uint8_t(run_value));
+        }
+    };
+
+    /* Runs continue from one row of the tile to the next */
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        const LevelPixel * row = &level.GetLevelData()[level.GetSize().Index(Position{rect.Left(), y})];
+        for (int x = 0; x < rect.size.x; ++x)
+        {
+            if (run_length == MaxRunLength || (run_length && row[x] != run_value))
+            {
+                flush();
+                run_length = 0;
+            }
+            run_value = row[x];
+            ++run_length;
+        }
+    }
+    flush();
+    return encoded;
+}
+
+/* Returns false when the data does not hold exactly the pixels of the tile */
+bool DecodeTile(Level * level, Rect rect, const std::uint8_t * encoded, std::size_t encoded_size)
+{
+    Position pos = rect.pos;
+    for (std::size_t i = 0; i + 1 < encoded_size; i += 2)
+    {
+        int run_length = encoded[i] + 1;
+        LevelPixel value = LevelPixel(encoded[i + 1]);
+        while (run_length)
+        {
+            if (pos.y > rect.Bottom())
+                return false;
+            int count = std::min(run_length, rect.Right() - pos.x + 1);
+            level->FillVoxelsRaw(pos, count, value);
+            run_length -= count;
+            pos.x += count;
+            if (pos.x > rect.Right())
+                pos = Position{rect.Left(), pos.y + 1};
+        }
+    }
+    return encoded_size % 2 == 0 && pos.y == rect.Bottom() + 1;
+}
+
+} // namespace
+
+void LevelFile::Save(const Level & level, const LevelFileInfo & info, const char * file_name)
+{
+    [[maybe_unused]] auto trace = MeasureFunction<3>("LevelFile::Save");
+
+    const LevelTiles & tiles = level.GetTiles();
+    std::vector<std::vector<std::uint8_t>> encoded_tiles(tiles.GetTileTotal());
+    parallel_for(
+        [&](int min, int max, ThreadLocal *) {
+            for (int tile = min; tile <= max; ++tile)
+                encoded_tiles[tile] = EncodeTile(level, tiles.GetTileRect(tile));
+            return 0;
+        },
+        0, tiles.GetTileTotal() - 1);
+
+    FileHeader header = {};
+    std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+    header.version = FileVersion;
+    header.width = level.GetSize().x;
+    header.height = level.GetSize().y;
+    header.generator = std::uint32_t(info.generator);
+    header.seed = info.seed;
+    header.generation_time_ms = std::uint32_t(info.generation_time.count());
+    header.spawn_count = std::uint32_t(level.GetSpawns().size());
+    header.tile_size = LevelTiles::TileSize;
+    header.tile_count = std::uint32_t(tiles.GetTileTotal());
+
+    std::vector<FileSpawn> spawns;
+    for (const TankBase & base : level.GetSpawns())
+        spawns.push_back(FileSpawn{base.GetPosition().x, base.GetPosition().y});
+
+    std::vector<std::uint64_t> tile_ends;
+    std::uint64_t tile_data_size = 0;
+    for (const std::vector<std::uint8_t> & encoded : encoded_tiles)
+        tile_ends.push_back(tile_data_size += encoded.size());
+
+    const std::size_t spawns_size = spawns.size() * sizeof(FileSpawn);
+    const std::size_t tile_ends_size = tile_ends.size() * sizeof(std::uint64_t);
+    MappedMemory file{file_name, MappedMemory::FileAccess::ReadWrite,
+                      sizeof(FileHeader) + spawns_size + tile_ends_size + std::size_t(tile_data_size)};
+
+    auto * out = static_cast<std::uint8_t *>(file.GetData());
+    std::memcpy(out, &header, sizeof(FileHeader));
+    out += sizeof(FileHeader);
+    std::memcpy(out, spawns.data(), spawns_size);
+    out += spawns_size;
+    std::memcpy(out, tile_ends.data(), tile_ends_size);
+    out += tile_ends_size;
+    for (const std::vector<std::uint8_t> & encoded : encoded_tiles)
+    {
+        std::memcpy(out, encoded.data(), encoded.size());
+        out += encoded.size();
+    }
+}
+
+levelgen::GeneratedLevel LevelFile::Load(const char * file_name, LevelFileInfo * info)
+{
+    Stopwatch<std::chrono::milliseconds> elapsed;
+
+    MappedMemory file{file_name, MappedMemory::FileAccess::ReadOnly};
+    const auto * in = static_cast<const std::uint8_t *>(file.GetData());
+    const std::size_t file_size = file.GetSize();
+
+    FileHeader header;
+    if (file_size < sizeof(FileHeader))
+        throw GameException("Level file is too short.");
+    std::memcpy(&header, in, sizeof(FileHeader));
+    if (std::memcmp(header.magic, FileMagic, sizeof(FileMagic)) != 0)
+        throw GameException("Not a level file.");
+    if (header.version != FileVersion)
+        throw GameException("Unsupported level file version.");
+    if (header.width <= 0 || header.height <= 0 || header.tile_size != LevelTiles::TileSize ||
+        header.spawn_count != std::uint32_t(tweak::world::MaxPlayers))
+        throw GameException("Level file header is corrupt.");
+
+    /* Check the tables fit in the file before allocating the level */
+    const Size size = {header.width, header.height};
+    const std::uint64_t tile_count = ((std::uint64_t(size.x) + LevelTiles::TileSize - 1) / LevelTiles::TileSize) *
+                                     ((std::uint64_t(size.y) + LevelTiles::TileSize - 1) / LevelTiles::TileSize);
+    if (header.tile_count != tile_count)
+        throw GameException("Level file header is corrupt.");
+
+    const std::size_t spawns_offset = sizeof(FileHeader);
+    const std::size_t tile_ends_offset = spawns_offset + header.spawn_count * sizeof(FileSpawn);
+    const std::size_t tile_data_offset = tile_ends_offset + header.tile_count * sizeof(std::uint64_t);
+    if (file_size < tile_data_offset)
+        throw GameException("Level file is too short.");
+
+    auto level = std::make_unique<Level>(size);
+    const LevelTiles & tiles = level->GetTiles();
+
+    for (std::uint32_t i = 0; i < header.spawn_count; ++i)
+    {
+        FileSpawn spawn;
+        std::memcpy(&spawn, in + spawns_offset + i * sizeof(FileSpawn), sizeof(FileSpawn));
+        if (!level->IsInBounds(Position{spawn.x, spawn.y}))
+            throw GameException("Level file spawn is out of the level.");
+        level->SetSpawn(TankColor(i), Position{spawn.x, spawn.y});
+    }
+
+    std::vector<std::uint64_t> tile_ends(header.tile_count);
+    std::memcpy(tile_ends.data(), in + tile_ends_offset, tile_ends.size() * sizeof(std::uint64_t));
+    std::uint64_t tile_start = 0;
+    for (std::uint64_t tile_end : tile_ends)
+    {
+        if (tile_end < tile_start || tile_end > file_size - tile_data_offset)
+            throw GameException("Level file tile table is corrupt.");
+        tile_start = tile_end;
+    }
+
+    /* Tiles never share pixels, so they decode independently */
+    const std::uint8_t * tile_data = in + tile_data_offset;
+    int corrupt_tiles = parallel_for(
+        [&](int min, int max, ThreadLocal *) {
+            int corrupt = 0;
+            for (int tile = min; tile <= max; ++tile)
+            {
+                std::uint64_t start = tile ? tile_ends[tile - 1] : 0;
+                if (!DecodeTile(level.get(), tiles.GetTileRect(tile), tile_data + start,
+                                std::size_t(tile_ends[tile] - start)))
+                    ++corrupt;
+            }
+            return corrupt;
+        },
+        0, tiles.GetTileTotal() - 1);
+    if (corrupt_tiles)
+        throw GameException("Level file terrain is corrupt.");
+
+    if (info)
+        *info = LevelFileInfo{.generator = levelgen::LevelGeneratorType(header.generator),
+                              .seed = header.seed,
+                              .generation_time = std::chrono::milliseconds(header.generation_time_ms)};
+
+    auto msecs = elapsed.GetElapsed();
+    gamelib_print("Level loaded in: %lld.%03lld sec\n", msecs.count() / 1000, msecs.count() % 1000);
+    return {.level = std::move(level),
+            .generation_time = std::chrono::duration_cast<std::chrono::milliseconds>(msecs),
+            .stages = {}};
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <chrono>
+#include <memory>
+
+#include "levelgen.h"
+
+class Level;
+
+/* What the level was generated with. Informational, loading does not depend on it. */
+struct LevelFileInfo
+{
+    levelgen::LevelGeneratorType generator = levelgen::LevelGeneratorType::None;
+    int seed = 0;
+    std::chrono::milliseconds generation_time = {};
+};
+
+/*
+ * LevelFile: native level format
+ *  Holds a level the way the generator left it, before materialization: generated terrain, tank spawns
+ *  and generator metadata. Terrain is split into 64x64 tiles, each run-length encoded on its own and
+ *  indexed by a table of offsets, so the loader maps the file and decodes tiles in parallel.
+ *
+ *  Layout, integers are little endian:
+ *    header        magic "TTLV", version, size, generator, seed, generation time, spawn and tile counts
+ *    spawns        x, y of each tank base
+ *    tile ends     64-bit end offset of each tile within the tile data
+ *    tile data     per tile, rows of the tile back to back as (run length - 1, pixel) byte pairs
+ */
+class LevelFile
+{
+  public:
+    /* Throws GameException when the file can't be written */
+    static void Save(const Level & level, const LevelFileInfo & info, const char * file_name);
+    /* Throws GameException when the file can't be read or is not a valid level file */
+    static levelgen::GeneratedLevel Load(const char * file_name, LevelFileInfo * info = nullptr);
+};
@@ -0,0 +1,147 @@
+#include "level_provider.h"
+
+#include <cstdint>
+
+#include "exceptions.h"
+#include "gamelib.h"
+#include "level.h"
+#include "level_bitplanes.h"
+#include "random.h"
+#include "render_surface.h"
+
+LevelProvider::LevelProvider(LevelProviderConfig config)
+    : config(config), pool(config.thread_count, ThreadPriority::Low), thread([this]() { BackgroundLoop(); })
+{
+}
+
+LevelProvider::~LevelProvider()
+{
+    {
+        std::unique_lock lock(this->mutex);
+        this->is_stopping = true;
+    }
+    this->changed.notify_all();
+    this->thread.join();
+}
+
+void LevelProvider::Queue(LevelRequest request)
+{
+    {
+        std::unique_lock lock(this->mutex);
+        this->entries.push_back(Entry{.request = request, .level = nullptr, .error = nullptr});
+    }
+    this->changed.notify_all();
+}
+
+std::unique_ptr<Level> LevelProvider::Take()
+{
+    std::unique_lock lock(this->mutex);
+    if (this->entries.empty())
+        throw GameException("No level queued");
+
+    /* Entries are only removed here, so the front stays put while it is being generated */
+    Entry & entry = this->entries.front();
+    if (!entry.level && !entry.error && !entry.is_generating)
+        Generate(entry, lock);
+    this->changed.wait(lock, [&entry]() { return entry.level || entry.error; });
+
+    std::unique_ptr<Level> level = std::move(entry.level);
+    std::exception_ptr error = entry.error;
+    this->entries.pop_front();
+    lock.unlock();
+    this->changed.notify_all();
+
+    if (error)
+        std::rethrow_exception(error);
+    return level;
+}
+
+int LevelProvider::GetReadyCount()
+{
+    std::unique_lock lock(this->mutex);
+    int count = 0;
+    for (const Entry & entry : this->entries)
+        count += entry.level != nullptr;
+    return count;
+}
+
+std::size_t LevelProvider::EstimateLevelBytes(Size size)
+{
+    /* Level data, dirt adjacency, bit planes and the terrain surface. Object surfaces stay untouched until played. */
+    const std::size_t pixels = std::size_t(size.x) * size.y;
+    return pixels * (sizeof(LevelPixel) + sizeof(std::uint8_t) + sizeof(RenderedPixel)) +
+           pixels * LevelBitPlanes::PlaneCount / 8;
+}
+
+void LevelProvider::BackgroundLoop()
+{
+    gamelib_lower_thread_priority();
+    ThreadPool::SetForCurrentThread(&this->pool);
+
+    std::unique_lock lock(this->mutex);
+    while (true)
+    {
+        Entry * entry = nullptr;
+        this->changed.wait(lock, [this, &entry]() { return this->is_stopping || (entry = FindNextToGenerate()); });
+        if (this->is_stopping)
+            return;
+        Generate(*entry, lock);
+    }
+}
+
+LevelProvider::Entry * LevelProvider::FindNextToGenerate()
+{
+    int ahead = 0;
+    std::size_t bytes = 0;
+    for (Entry & entry : this->entries)
+    {
+        if (entry.level || entry.is_generating)
+        {
+            ++ahead;
+            bytes += EstimateLevelBytes(entry.request.size);
+            continue;
+        }
+        if (entry.error)
+            continue;
+        /* Always allow one, a level bigger than the memory limit would never come otherwise */
+        bool is_within_limits =
+            ahead < this->config.max_ready && bytes + EstimateLevelBytes(entry.request.size) <= this->config.max_bytes;
+        return (ahead == 0 || is_within_limits) ? &entry : nullptr;
+    }
+    return nullptr;
+}
+
+void LevelProvider::Generate(Entry & entry, std::unique_lock<std::mutex> & lock)
+{
+    entry.is_generating = true;
+    const LevelRequest request = entry.request;
+    lock.unlock();
+
+    std::unique_ptr<Level> level;
+    std::exception_ptr error;
+    try
+    {
+        level = Build(request);
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    lock.lock();
+    entry.level = std::move(level);
+    entry.error = error;
+    entry.is_generating = false;
+    this->changed.notify_all();
+}
+
+std::unique_ptr<Level> LevelProvider::Build(const LevelRequest & request)
+{
+    RandomGenerator random;
+    random.Seed(request.seed);
+    RandomScope random_scope(random);
+
+    std::unique_ptr<Level> level = levelgen::LevelGenerator::Generate(request.generator, request.size).level;
+    level->MaterializeLevelTerrainAndBases();
+    return level;
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "levelgen.h"
+#include "thread_pool.h"
+#include "tweak.h"
+#include "types.h"
+
+class Level;
+
+struct LevelRequest
+{
+    levelgen::LevelGeneratorType generator;
+    Size size;
+    int seed;
+};
+
+struct LevelProviderConfig
+{
+    int max_ready = tweak::perf::PregeneratedLevels; /* Levels generated ahead, the one being generated included */
+    std::size_t max_bytes = tweak::perf::PregeneratedLevelBytes; /* Estimated memory of those levels */
+    int thread_count = int(tweak::perf::parallelism_degree); /* Workers of the background pool */
+};
+
+/*
+ * LevelProvider: generates queued levels in the background
+ *  Levels are generated and materialized in queue order on a thread of the provider, with lowered priority and
+ *  a thread pool of its own, so ticks of the game running meanwhile never wait behind generation work.
+ *  It stays at most max_ready levels and about max_bytes ahead of Take.
+ *  Each level draws from its own RandomGenerator seeded with the seed of its request, so it is the same level the
+ *  seed gives in the foreground, and ::Random is left alone.
+ */
+class LevelProvider
+{
+    struct Entry
+    {
+        LevelRequest request;
+        std::unique_ptr<Level> level;
+        std::exception_ptr error;
+        bool is_generating = false;
+    };
+
+    LevelProviderConfig config;
+    ThreadPool pool;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Entry> entries; /* In the order Take returns them */
+    bool is_stopping = false;
+    std::thread thread;
+
+  public:
+    explicit LevelProvider(LevelProviderConfig config = {});
+    ~LevelProvider(); /* Waits for the level being generated */
+    LevelProvider(const LevelProvider &) = delete;
+    LevelProvider & operator=(const LevelProvider &) = delete;
+
+    void Queue(LevelRequest request);
+    /* Next queued level, materialized. Generates it on the calling thread when the background did not start on it
+     * yet. Throws GameException when nothing is queued, rethrows what generating the level threw. */
+    std::unique_ptr<Level> Take();
+    int GetReadyCount();
+
+    /* Rough memory of a materialized level with its terrain surface drawn */
+    static std::size_t EstimateLevelBytes(Size size);
+
+  private:
+    void BackgroundLoop();
+    Entry * FindNextToGenerate(); /* Null when there is nothing to do or the limits are reached */
+    void Generate(Entry & entry, std::unique_lock<std::mutex> & lock); /* Unlocks while generating */
+    static std::unique_ptr<Level> Build(const LevelRequest & request);
+};
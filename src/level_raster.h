@@ -0,0 +1,192 @@
+#pragma once
+#include "types.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+/*
+ * Shapes for Level::RewriteShape
+ *  A shape hands out its pixels as horizontal spans through ForEachSpan(void(RasterSpan)). Spans may reach out of
+ *  the level, the level clips them. Apart from PointsShape, a shape never hands out one pixel twice.
+ */
+
+/* Pixels [pos.x, pos.x + length) of row pos.y */
+struct RasterSpan
+{
+    Position pos;
+    int length;
+};
+
+/* Cut the span down to a level of the given size. Returns false when nothing is left. */
+inline bool ClipSpan(RasterSpan & span, Size size)
+{
+    if (span.pos.y < 0 || span.pos.y >= size.y)
+        return false;
+    int from = std::max(span.pos.x, 0);
+    int until = std::min(span.pos.x + span.length, size.x);
+    if (from >= until)
+        return false;
+    span = RasterSpan{Position{from, span.pos.y}, until - from};
+    return true;
+}
+
+/* Shape of one span per row around its center, built once and stamped anywhere */
+class StampMask
+{
+    struct Row
+    {
+        int from_x; /* Offsets from the center, inclusive */
+        int to_x;
+    };
+    int top = 0; /* Offset of the first row from the center */
+    std::vector<Row> rows;
+
+  public:
+    /* Square of 2 * radius + 1 pixels without its four corner pixels. Tank tunnels, and the pen of fat lines. */
+    static StampMask RoundedSquare(int radius)
+    {
+        StampMask mask;
+        mask.top = -radius;
+        for (int y = -radius; y <= radius; ++y)
+        {
+            int inset = (y == -radius || y == radius) && radius > 0;
+            mask.rows.push_back(Row{-radius + inset, radius - inset});
+        }
+        return mask;
+    }
+
+    int GetTop() const { return this->top; }
+    int GetHeight() const { return int(this->rows.size()); }
+    Row GetRow(int i) const { return this->rows[i]; }
+
+    template <typename SpanFunc>
+    void ForEachSpan(Position center, SpanFunc span_func) const
+    {
+        for (int i = 0; i < GetHeight(); ++i)
+            span_func(RasterSpan{Position{center.x + this->rows[i].from_x, center.y + this->top + i},
+                                 this->rows[i].to_x - this->rows[i].from_x + 1});
+    }
+};
+
+struct RectShape
+{
+    Rect rect;
+
+    template <typename SpanFunc>
+    void ForEachSpan(SpanFunc span_func) const
+    {
+        for (int y = this->rect.Top(); y <= this->rect.Bottom(); ++y)
+            span_func(RasterSpan{Position{this->rect.Left(), y}, this->rect.size.x});
+    }
+};
+
+struct StampShape
+{
+    const StampMask & mask;
+    Position center;
+
+    template <typename SpanFunc>
+    void ForEachSpan(SpanFunc span_func) const
+    {
+        this->mask.ForEachSpan(this->center, span_func);
+    }
+};
+
+/* Separate pixels, as spans of one */
+struct PointsShape
+{
+    const Position * points;
+    int count;
+
+    template <typename SpanFunc>
+    void ForEachSpan(SpanFunc span_func) const
+    {
+        for (int i = 0; i < this->count; ++i)
+            span_func(RasterSpan{this->points[i], 1});
+    }
+};
+
+/* Bresenham line between two pixels, optionally with a pen stamped at every pixel of it. The pen has to overlap
+ * itself on neighboring pixels (RoundedSquare of radius 1 and more does), so that the line is one span per row. */
+class LineShape
+{
+    Vector from;
+    Vector to;
+    const StampMask * pen;
+
+  public:
+    LineShape(Vector from, Vector to, const StampMask * pen = nullptr) : from(from), to(to), pen(pen) {}
+
+    template <typename PointFunc>
+    void ForEachPoint(PointFunc point_func) const
+    {
+        Vector a = this->from, b = this->to;
+
+        /* Swap x and y values when the graph gets too steep to operate normally: */
+        bool swap = std::abs(b.y - a.y) > std::abs(b.x - a.x);
+        if (swap)
+        {
+            std::swap(a.x, a.y);
+            std::swap(b.x, b.y);
+        }
+        /* Swap a and b so that a is to the left of b: */
+        if (a.x > b.x)
+            std::swap(a, b);
+
+        int dx = b.x - a.x;
+        int dy = std::abs(b.y - a.y);
+        int error = dx / 2;
+        int step_y = (a.y < b.y) ? 1 : -1;
+        for (int x = a.x, y = a.y; x <= b.x; x++)
+        {
+            point_func(swap ? Position{y, x} : Position{x, y});
+            error -= dy;
+            if (error < 0)
+            {
+                y += step_y;
+                error += dx;
+            }
+        }
+    }
+
+    template <typename SpanFunc>
+    void ForEachSpan(SpanFunc span_func) const
+    {
+        if (!this->pen)
+        {
+            /* Runs of pixels on one row become one span */
+            RasterSpan span = {Position{0, 0}, 0};
+            ForEachPoint([&span, &span_func](Position pos) {
+                if (span.length && pos.y == span.pos.y && pos.x == span.pos.x + span.length)
+                    ++span.length;
+                else
+                {
+                    if (span.length)
+                        span_func(span);
+                    span = RasterSpan{pos, 1};
+                }
+            });
+            if (span.length)
+                span_func(span);
+            return;
+        }
+
+        /* Widest reach of the pen on every row the line touches */
+        int top = std::min(this->from.y, this->to.y) + this->pen->GetTop();
+        std::vector<std::pair<int, int>> rows(std::abs(this->to.y - this->from.y) + this->pen->GetHeight(),
+                                              std::pair{INT_MAX, INT_MIN});
+        ForEachPoint([this, top, &rows](Position pos) {
+            for (int i = 0; i < this->pen->GetHeight(); ++i)
+            {
+                auto & row = rows[pos.y + this->pen->GetTop() + i - top];
+                row.first = std::min(row.first, pos.x + this->pen->GetRow(i).from_x);
+                row.second = std::max(row.second, pos.x + this->pen->GetRow(i).to_x);
+            }
+        });
+        for (int i = 0; i < int(rows.size()); ++i)
+            if (rows[i].first <= rows[i].second)
+                span_func(RasterSpan{Position{rows[i].first, top + i}, rows[i].second - rows[i].first + 1});
+    }
+};
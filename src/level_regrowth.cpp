@@ -0,0 +1,225 @@
+#include "level_regrowth.h"
+#include "level.h"
+#include "random.h"
+#include "tweak.h"
+
+LevelRegrowth::LevelRegrowth(Level * level, RegrowNeighborSource neighbor_source)
+    : level(level), neighbor_source(neighbor_source), seed(std::uint64_t(Random.GetSeed())),
+      tiles(level->GetTiles().GetTileTotal()), tile_row_visited(level->GetTiles().GetTileCount().y)
+{
+}
+
+int LevelRegrowth::GetCandidateCount() const
+{
+    int count = 0;
+    for (const TileFrontier & tile : this->tiles)
+        count += tile.candidate_count;
+    return count;
+}
+
+std::uint64_t LevelRegrowth::GetNeighborhoodVersion(int tile) const
+{
+    const LevelTiles & level_tiles = this->level->GetTiles();
+    const Size tile_count = level_tiles.GetTileCount();
+    const int tile_x = tile % tile_count.x;
+    const int tile_y = tile / tile_count.x;
+
+    std::uint64_t versions = 0;
+    for (int y = std::max(0, tile_y - 1); y <= std::min(tile_count.y - 1, tile_y + 1); ++y)
+        for (int x = std::max(0, tile_x - 1); x <= std::min(tile_count.x - 1, tile_x + 1); ++x)
+            versions += level_tiles.GetVersion(x + y * tile_count.x);
+    return versions;
+}
+
+void LevelRegrowth::RefreshTile(int tile)
+{
+    const LevelBitPlanes & planes = this->level->GetPlanes();
+    const Rect rect = this->level->GetTiles().GetTileRect(tile);
+    const int word = rect.pos.x / LevelBitPlanes::WordBits;
+
+    /* Base interiors regrow regardless of what they contain */
+    std::vector<Word> base_rows(rect.size.y);
+    for (const TankBase & base : this->level->GetSpawns())
+    {
+        Rect interior = base.GetInteriorRect();
+        int from_x = std::max(interior.Left(), rect.Left()), until_x = std::min(interior.Right(), rect.Right());
+        int from_y = std::max(interior.Top(), rect.Top()), until_y = std::min(interior.Bottom(), rect.Bottom());
+        if (from_x > until_x || from_y > until_y)
+            continue;
+        int width = until_x - from_x + 1;
+        Word mask = (width == LevelBitPlanes::WordBits ? ~Word{0} : (Word{1} << width) - 1) << (from_x - rect.pos.x);
+        for (int y = from_y; y <= until_y; ++y)
+            base_rows[y - rect.pos.y] |= mask;
+    }
+
+    TileFrontier & frontier = this->tiles[tile];
+    frontier.candidates.resize(rect.size.y);
+    frontier.candidate_count = 0;
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        /* Dirt neighbor count >= 3 for all 64 pixels of the row at once */
+        BitSlicedCounter dirt_neighbors;
+        for (int row = std::max(0, y - 1); row <= std::min(this->level->GetSize().y - 1, y + 1); ++row)
+        {
+            Word left, center, right;
+            planes.GetNeighborWords(LevelPlane::Dirt, row, word, left, center, right);
+            dirt_neighbors.Add(left);
+            dirt_neighbors.Add(right);
+            if (row != y)
+                dirt_neighbors.Add(center);
+        }
+
+        const Word base = base_rows[y - rect.pos.y];
+        const Word regrowable = planes.GetRow(LevelPlane::Regrowable, y)[word];
+        const Word dirt_grow = planes.GetRow(LevelPlane::Diggable, y)[word] & ~planes.GetRow(LevelPlane::Dirt, y)[word];
+        /* Growing dirt in bases already is what the base would turn it into */
+        const Word candidates = ((regrowable | base) & ~(base & dirt_grow) & dirt_neighbors.AtLeast3()) |
+                                (dirt_grow & ~base);
+
+        frontier.candidates[y - rect.pos.y] = candidates;
+        frontier.candidate_count += std::popcount(candidates);
+    }
+
+    if (frontier.candidate_count == 0)
+        frontier.candidates.clear();
+}
+
+RegrowStats LevelRegrowth::AdvanceTile(int tile, std::uint64_t pass_seed, RegrowOdds odds)
+{
+    /* Draws out of 1001 for every odds denominator, so that a full pass draws Int(0, 1000) */
+    const int draw_max = 1001 * odds.denominator - 1;
+    RegrowStats stats;
+    const Rect rect = this->level->GetTiles().GetTileRect(tile);
+    TileFrontier & frontier = this->tiles[tile];
+    StreamRandom random{pass_seed, std::uint64_t(tile)};
+    frontier.writes.clear();
+    for (int y = rect.Top(); y <= rect.Bottom(); ++y)
+    {
+        const LevelPixel * row = this->level->GetLevelRow(y);
+        const std::size_t row_offset = this->level->GetSize().Index(Position{0, y});
+        for (Word bits = frontier.candidates[y - rect.pos.y]; bits; bits &= bits - 1)
+        {
+            Position pos = {rect.pos.x + std::countr_zero(bits), y};
+            std::size_t offset = row_offset + pos.x;
+            LevelPixel pix = row[pos.x];
+            if (pix == LevelPixel::Blank || Pixel::IsScorched(pix) || this->level->CheckBaseCollision(pos))
+            {
+                int neighbors = this->neighbor_source == RegrowNeighborSource::AdjacencyCache
+                                    ? this->level->DirtPixelsAdjacent(pos)
+                                    : this->level->CountNeighborsInPlane(pos, LevelPlane::Dirt);
+                int modifier = (pix == LevelPixel::Blank) ? 4 : 1;
+                if (neighbors > 2 &&
+                    random.Int(0, draw_max) < tweak::world::DirtRegrowSpeed * neighbors * modifier * odds.numerator)
+                {
+                    if (pix != LevelPixel::DirtGrow)
+                        frontier.writes.push_back(PixelWrite{offset, LevelPixel::DirtGrow});
+                    ++stats.holes_decayed;
+                }
+            }
+            else if (pix == LevelPixel::DirtGrow)
+            {
+                if (random.Int(0, draw_max) < tweak::world::DirtRecoverSpeed * odds.numerator)
+                {
+                    frontier.writes.push_back(
+                        PixelWrite{offset, random.Bool(500) ? LevelPixel::DirtHigh : LevelPixel::DirtLow});
+                    ++stats.dirt_grown;
+                }
+            }
+        }
+    }
+    return stats;
+}
+
+void LevelRegrowth::ApplyTile(int tile)
+{
+    for (const PixelWrite & write : this->tiles[tile].writes)
+        this->level->SetVoxelRaw(write.offset, write.value);
+}
+
+RegrowStats LevelRegrowth::Pass(WorkerCount worker_count)
+{
+    return PassTileRows(0, this->level->GetTiles().GetTileCount().y - 1, RegrowOdds{}, worker_count);
+}
+
+RegrowStats LevelRegrowth::PassSlice(std::chrono::microseconds now, int slice_count, int tile_budget,
+                                     WorkerCount worker_count)
+{
+    /* Rows that waited longer than this don't catch up on all of it at once */
+    constexpr auto MaxCatchUp = 4 * std::chrono::microseconds{tweak::world::DirtRecoverInterval};
+
+    RegrowStats stats;
+    const int tile_rows = int(this->tile_row_visited.size());
+    const int rows_per_slice = (tile_rows + slice_count - 1) / std::max(1, slice_count);
+    for (int row = 0; row < rows_per_slice; ++row)
+    {
+        /* At least one row per call, so regrowth never stalls */
+        if (row && tile_budget && stats.tiles_active >= tile_budget)
+            break;
+
+        const int tile_row = this->next_tile_row;
+        auto since_visit = std::min(MaxCatchUp, now - this->tile_row_visited[tile_row]);
+        this->tile_row_visited[tile_row] = now;
+        this->next_tile_row = (tile_row + 1) % tile_rows;
+
+        RegrowOdds odds = {int(since_visit.count()),
+                           int(std::chrono::microseconds{tweak::world::DirtRecoverInterval}.count())};
+        stats += PassTileRows(tile_row, tile_row, odds, worker_count);
+    }
+    return stats;
+}
+
+RegrowStats LevelRegrowth::PassTileRows(int from_row, int until_row, RegrowOdds odds, WorkerCount worker_count)
+{
+    const int tiles_per_row = this->level->GetTiles().GetTileCount().x;
+    const int first_tile = from_row * tiles_per_row;
+    const int last_tile = (until_row + 1) * tiles_per_row - 1;
+
+    /* Find tiles whose surroundings changed since they were scanned. Versions are read before the rescan,
+     * so writes made by the pass itself show up as changes on the next one. */
+    this->stale_tiles.clear();
+    for (int tile = first_tile; tile <= last_tile; ++tile)
+    {
+        std::uint64_t versions = GetNeighborhoodVersion(tile);
+        if (versions != this->tiles[tile].seen_versions)
+        {
+            this->tiles[tile].seen_versions = versions;
+            this->stale_tiles.push_back(tile);
+        }
+    }
+
+    parallel_for(
+        [this](int min, int max, ThreadLocal *) {
+            for (int i = min; i <= max; ++i)
+                RefreshTile(this->stale_tiles[i]);
+            return 0;
+        },
+        0, int(this->stale_tiles.size()) - 1, worker_count);
+
+    this->active_tiles.clear();
+    for (int tile = first_tile; tile <= last_tile; ++tile)
+        if (this->tiles[tile].candidate_count)
+            this->active_tiles.push_back(tile);
+
+    /* Every tile reads neighbors across its border, so nothing is written until all tiles decided */
+    const std::uint64_t pass_seed = StreamRandom::Mix(this->seed + this->pass_count++);
+    RegrowStats stats = parallel_for(
+        [this, pass_seed, odds](int min, int max, ThreadLocal *) {
+            RegrowStats stats;
+            for (int i = min; i <= max; ++i)
+                stats += AdvanceTile(this->active_tiles[i], pass_seed, odds);
+            return stats;
+        },
+        0, int(this->active_tiles.size()) - 1, worker_count);
+
+    parallel_for(
+        [this](int min, int max, ThreadLocal *) {
+            for (int i = min; i <= max; ++i)
+                ApplyTile(this->active_tiles[i]);
+            return 0;
+        },
+        0, int(this->active_tiles.size()) - 1, worker_count);
+
+    stats.tiles_refreshed = int(this->stale_tiles.size());
+    stats.tiles_active = int(this->active_tiles.size());
+    return stats;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <chrono>
+#include <vector>
+
+#include "level_bitplanes.h"
+#include "level_tiles.h"
+#include "parallelism.h"
+#include "types.h"
+
+class Level;
+
+struct RegrowStats
+{
+    int holes_decayed = 0; /* Empty or scorched pixels that started to grow dirt */
+    int dirt_grown = 0;    /* Growing dirt that turned into dirt */
+    int tiles_refreshed = 0;
+    int tiles_active = 0;
+
+    RegrowStats & operator+=(const RegrowStats & other)
+    {
+        this->holes_decayed += other.holes_decayed;
+        this->dirt_grown += other.dirt_grown;
+        this->tiles_refreshed += other.tiles_refreshed;
+        this->tiles_active += other.tiles_active;
+        return *this;
+    }
+};
+
+/* Scale of the regrowth odds: numerator / denominator of the chance of a full pass */
+struct RegrowOdds
+{
+    int numerator = 1;
+    int denominator = 1;
+};
+
+/* Where regrowth gets dirt neighbor counts of frontier pixels from */
+enum class RegrowNeighborSource
+{
+    AdjacencyCache, /* Level::DirtPixelsAdjacent */
+    BitPlanes,      /* Level::CountNeighborsInPlane */
+};
+
+/*
+ * LevelRegrowth
+ *  Keeps the frontier of pixels that dirt regrowth can touch:
+ *   - blank, scorched or base pixels with at least 3 neighboring dirt pixels
+ *   - growing dirt outside of bases
+ *  The frontier is kept per level tile as one candidate bit word per tile row. A tile is rescanned only when
+ *  its version or the version of one of its 8 neighbors changed since the last scan, so a pass costs
+ *  in proportion to the disturbed terrain and not to the level area.
+ *  A pass is deterministic: all tiles decide against the terrain as it was before the pass and write only
+ *  once every tile decided, and each tile draws from its own random stream keyed by seed, pass and tile.
+ *  The result depends on the seed only, not on the worker count or on which worker took which tile.
+ *  Instead of a full pass every DirtRecoverInterval, regrowth can also advance a slice of tile rows per game
+ *  tick. Odds of each tile row are scaled by the game time since its last visit, so dirt grows back at the
+ *  same speed either way.
+ */
+class LevelRegrowth
+{
+    using Word = LevelBitPlanes::Word;
+    static_assert(LevelTiles::TileSize == LevelBitPlanes::WordBits, "Tile row must be exactly one plane word");
+
+    struct PixelWrite
+    {
+        std::size_t offset;
+        LevelPixel value;
+    };
+
+    struct TileFrontier
+    {
+        std::uint64_t seen_versions = ~std::uint64_t{0}; /* Sum of versions of the 3x3 tiles around when scanned */
+        int candidate_count = 0;
+        std::vector<Word> candidates; /* One word per tile row, empty when there are no candidates */
+        std::vector<PixelWrite> writes; /* Decided by the current pass, not applied yet */
+    };
+
+    Level * level;
+    RegrowNeighborSource neighbor_source;
+    std::uint64_t seed;
+    std::uint64_t pass_count = 0;
+    std::vector<TileFrontier> tiles;
+    std::vector<int> stale_tiles;
+    std::vector<int> active_tiles;
+
+    int next_tile_row = 0;
+    std::vector<std::chrono::microseconds> tile_row_visited; /* Game time of the last slice pass of each row */
+
+  public:
+    /* Random streams are keyed by the seed of the global Random */
+    LevelRegrowth(Level * level, RegrowNeighborSource neighbor_source = RegrowNeighborSource::AdjacencyCache);
+
+    /* Advance regrowth of all frontier pixels by one step */
+    RegrowStats Pass(WorkerCount worker_count = {});
+    /* Advance the next 1/slice_count of the tile rows, as of game time now. Stops early once the rows advanced
+     * held tile_budget active tiles, the rest is picked up by the next call. A zero budget never stops early.
+     * The budget counts work instead of time, so the rows a call covers depend only on the level. */
+    RegrowStats PassSlice(std::chrono::microseconds now, int slice_count, int tile_budget,
+                          WorkerCount worker_count = {});
+
+    /* Number of pixels on the frontier as of the last pass */
+    int GetCandidateCount() const;
+
+  private:
+    std::uint64_t GetNeighborhoodVersion(int tile) const;
+    void RefreshTile(int tile);
+    /* Advance frontier pixels of tile rows [from_row, until_row] by one step */
+    RegrowStats PassTileRows(int from_row, int until_row, RegrowOdds odds, WorkerCount worker_count);
+    /* Decide the writes of a tile without changing the level */
+    RegrowStats AdvanceTile(int tile, std::uint64_t pass_seed, RegrowOdds odds);
+    void ApplyTile(int tile);
+};
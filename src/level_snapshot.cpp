@@ -0,0 +1,58 @@
+#include "level_snapshot.h"
+#include <algorithm>
+
+#include "gamelib/sdl/bitmap.h"
+#include "level.h"
+#include "level_pixel.h"
+#include "parallelism.h"
+#include "trace.h"
+
+LevelSnapshot::LevelSnapshot(Level * level)
+    : level(level), size(level->GetSize()), tile_count(level->GetTiles().GetTileCount()),
+      tiles(level->GetTiles().GetTileTotal())
+{
+}
+
+LevelSnapshot::~LevelSnapshot() { this->level->ReleaseSnapshot(this); }
+
+const LevelPixel * LevelSnapshot::GetTileRowSpan(Position pos) const
+{
+    const TileData & tile = this->tiles[GetTileIndex(pos)];
+    if (!tile)
+        return &this->level->GetLevelData()[this->size.Index(pos)];
+    return &tile[(pos.y % TileSize) * TileSize + pos.x % TileSize];
+}
+
+LevelPixel LevelSnapshot::GetPixel(Position pos) const { return *GetTileRowSpan(pos); }
+
+int LevelSnapshot::GetPreservedTileCount() const
+{
+    return int(std::count_if(this->tiles.begin(), this->tiles.end(), [](const TileData & tile) { return bool(tile); }));
+}
+
+std::size_t LevelSnapshot::GetMemoryUsage() const
+{
+    /* Tile copies shared with other snapshots are counted in each of them */
+    return sizeof(*this) + this->tiles.capacity() * sizeof(TileData) +
+           std::size_t(GetPreservedTileCount()) * TileSize * TileSize * sizeof(LevelPixel);
+}
+
+void LevelSnapshot::DumpBitmap(const char * filename) const
+{
+    auto color_data = ColorBitmap{this->size};
+
+    parallel_for(
+        [this, &color_data](int from_y, int until_y, ThreadLocal *) {
+            for (int y = from_y; y <= until_y; ++y)
+                for (int x = 0; x < this->size.x; x += TileSize - x % TileSize)
+                {
+                    int count = std::min(TileSize - x % TileSize, this->size.x - x);
+                    Level::MaterializeRow(GetTileRowSpan(Position{x, y}), &color_data[y * this->size.x + x], count);
+                }
+            return 0;
+        },
+        0, this->size.y - 1);
+
+    [[maybe_unused]] auto trace = MeasureFunction<5>("DumpBitmap");
+    BmpFile::SaveToFile(color_data, filename);
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "level_tiles.h"
+#include "types.h"
+
+class Level;
+enum class LevelPixel : char;
+
+/*
+ * LevelSnapshot
+ *  Terrain of a level as it was when Level::TakeSnapshot was called. Taking a snapshot copies no pixels:
+ *  it starts with an empty slot per tile, meaning "same as the live level". The first write into a tile
+ *  after the snapshot was taken copies that one tile into the slot before the write lands, so a snapshot
+ *  costs memory only in proportion to the terrain that changed since.
+ *
+ *  Tile copies are shared by all snapshots that needed them at the time of the write.
+ *  A snapshot has to be destroyed before its level. Reading it while the level is being written to
+ *  from other threads is not supported.
+ */
+class LevelSnapshot
+{
+    friend class Level;
+
+  public:
+    constexpr static int TileSize = LevelTiles::TileSize;
+    /* TileSize x TileSize pixels, row stride is always TileSize even for smaller edge tiles */
+    using TileData = std::shared_ptr<const LevelPixel[]>;
+
+  private:
+    Level * level;
+    Size size;
+    Size tile_count;
+    std::vector<TileData> tiles; /* Empty slot: the tile did not change in the level since the snapshot */
+
+    LevelSnapshot(Level * level);
+
+  public:
+    ~LevelSnapshot();
+    LevelSnapshot(const LevelSnapshot &) = delete;
+    LevelSnapshot & operator=(const LevelSnapshot &) = delete;
+
+    Size GetSize() const { return this->size; }
+    LevelPixel GetPixel(Position pos) const;
+    /* Pointer to the pixels of row y from x up to the end of x's tile */
+    const LevelPixel * GetTileRowSpan(Position pos) const;
+
+    /* Number of tiles that had to be copied so far and memory held by the snapshot */
+    int GetPreservedTileCount() const;
+    std::size_t GetMemoryUsage() const;
+
+    void DumpBitmap(const char * filename) const;
+
+  private:
+    int GetTileIndex(Position pos) const
+    {
+        return (pos.x >> LevelTiles::TileSizeShift) + (pos.y >> LevelTiles::TileSizeShift) * this->tile_count.x;
+    }
+};
@@ -0,0 +1,108 @@
+#include "level_streaming.h"
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+#include "level_pixel.h"
+#include "random.h"
+
+LevelStreaming::LevelStreaming(std::unique_ptr<LevelTileSource> && source, std::uint64_t seed, int tile_total)
+    : source(std::move(source)), seed(seed), residency(tile_total, TileResidency::Virtual)
+{
+}
+
+void LevelStreaming::Generate(int tile, Rect rect, LevelPixel * pixels, int pitch) const
+{
+    std::array<LevelPixel, LevelTiles::TileSize * LevelTiles::TileSize> generated;
+    this->source->Generate(rect, generated.data());
+
+    /* Same texture as Level::GenerateDirtAndRocks, drawn from a stream of the tile instead of the row */
+    StreamRandom random = {this->seed, std::uint64_t(tile)};
+    for (int y = 0; y < rect.size.y; ++y)
+    {
+        const LevelPixel * from = &generated[std::size_t(y) * rect.size.x];
+        LevelPixel * row = pixels + std::size_t(y) * pitch;
+        for (int x = 0; x < rect.size.x; ++x)
+        {
+            if (from[x] != LevelPixel::LevelGenDirt)
+                row[x] = LevelPixel::Rock;
+            else
+                row[x] = random.Bool(500) ? LevelPixel::DirtLow : LevelPixel::DirtHigh;
+        }
+    }
+}
+
+void LevelStreaming::Load(int tile, Rect rect, LevelPixel * pixels, int pitch) const
+{
+    assert(!IsResident(tile));
+    auto found = this->evicted.find(tile);
+    if (found != this->evicted.end() && !found->second.pixels.empty())
+    {
+        for (int y = 0; y < rect.size.y; ++y)
+            std::copy_n(&found->second.pixels[std::size_t(y) * rect.size.x], rect.size.x,
+                        pixels + std::size_t(y) * pitch);
+        return;
+    }
+
+    Generate(tile, rect, pixels, pitch);
+    if (found != this->evicted.end())
+        for (PixelEdit edit : found->second.edits)
+            pixels[(edit.offset >> LevelTiles::TileSizeShift) * std::size_t(pitch) +
+                   (edit.offset & (LevelTiles::TileSize - 1))] = edit.value;
+}
+
+void LevelStreaming::MarkResident(int tile)
+{
+    assert(!IsResident(tile));
+    if (auto found = this->evicted.find(tile); found != this->evicted.end())
+    {
+        this->stats.evicted_bytes -= found->second.GetBytes();
+        --this->stats.evicted_tiles;
+        this->evicted.erase(found);
+    }
+    this->residency[tile] = TileResidency::Resident;
+    ++this->stats.resident_tiles;
+    ++this->stats.materialized;
+}
+
+std::size_t LevelStreaming::Evict(int tile, Rect rect, const LevelPixel * pixels, int pitch)
+{
+    assert(IsResident(tile));
+    std::array<LevelPixel, LevelTiles::TileSize * LevelTiles::TileSize> generated;
+    Generate(tile, rect, generated.data(), rect.size.x);
+
+    EvictedTile evicted_tile;
+    for (int y = 0; y < rect.size.y; ++y)
+    {
+        const LevelPixel * row = pixels + std::size_t(y) * pitch;
+        for (int x = 0; x < rect.size.x; ++x)
+            if (row[x] != generated[std::size_t(y) * rect.size.x + x])
+                evicted_tile.edits.push_back(
+                    PixelEdit{std::uint16_t(x + (y << LevelTiles::TileSizeShift)), row[x]});
+    }
+    /* Heavily changed tiles are smaller as they are */
+    if (evicted_tile.edits.size() * sizeof(PixelEdit) >= std::size_t(rect.size.x) * rect.size.y)
+    {
+        evicted_tile.edits = {};
+        evicted_tile.pixels.resize(std::size_t(rect.size.x) * rect.size.y);
+        for (int y = 0; y < rect.size.y; ++y)
+            std::copy_n(pixels + std::size_t(y) * pitch, rect.size.x,
+                        &evicted_tile.pixels[std::size_t(y) * rect.size.x]);
+    }
+    else
+        evicted_tile.edits.shrink_to_fit();
+
+    --this->stats.resident_tiles;
+    ++this->stats.evictions;
+    if (evicted_tile.edits.empty() && evicted_tile.pixels.empty())
+    {
+        this->residency[tile] = TileResidency::Virtual;
+        return 0;
+    }
+    const std::size_t bytes = evicted_tile.GetBytes();
+    this->residency[tile] = TileResidency::Evicted;
+    this->stats.evicted_bytes += bytes;
+    ++this->stats.evicted_tiles;
+    this->evicted.emplace(tile, std::move(evicted_tile));
+    return bytes;
+}
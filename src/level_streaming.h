@@ -0,0 +1,92 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "level_tiles.h"
+#include "types.h"
+
+enum class LevelPixel : char;
+
+/*
+ * LevelTileSource: terrain of a level that is generated piece by piece instead of all at once
+ *  Generate has to be a pure function of the rectangle and of the state the source was created with. Any
+ *  rectangle has to come out the same no matter which other rectangles were generated before, on which thread,
+ *  or whether it was generated before already.
+ */
+class LevelTileSource
+{
+  public:
+    virtual ~LevelTileSource() = default;
+    /* Write LevelGenDirt or LevelGenRock for every pixel of the rectangle, rect.size.x pixels per row */
+    virtual void Generate(Rect rect, LevelPixel * pixels) const = 0;
+};
+
+enum class TileResidency : std::uint8_t
+{
+    Virtual,  /* Never materialized, or evicted without changes. Its terrain is whatever the source generates. */
+    Resident, /* Level data, bit planes and the terrain surface hold the tile */
+    Evicted,  /* Kept only as its changes against the generated terrain */
+};
+
+struct LevelStreamStats
+{
+    int resident_tiles = 0;
+    int evicted_tiles = 0;         /* Evicted with changes */
+    std::size_t evicted_bytes = 0; /* Memory the changes of evicted tiles take */
+    int materialized = 0;          /* Tiles made resident since the level was created */
+    int evictions = 0;             /* Tiles evicted since the level was created */
+};
+
+/*
+ * LevelStreaming: bookkeeping of a level that is materialized tile by tile
+ *  Holds which tiles are resident and the compact form of tiles that were evicted after they changed: a list
+ *  of the pixels that differ from what the source generates, or the whole tile when that is smaller.
+ *  Generated terrain is textured with a random stream keyed by the seed and the tile, so a tile comes out the
+ *  same whenever and in whichever order it is materialized.
+ */
+class LevelStreaming
+{
+    struct PixelEdit
+    {
+        std::uint16_t offset; /* x + y * TileSize inside of the tile */
+        LevelPixel value;
+    };
+
+    struct EvictedTile
+    {
+        std::vector<PixelEdit> edits;
+        std::vector<LevelPixel> pixels; /* Whole tile instead of edits, rect.size.x per row */
+
+        std::size_t GetBytes() const
+        {
+            return this->edits.size() * sizeof(PixelEdit) + this->pixels.size() * sizeof(LevelPixel);
+        }
+    };
+
+    std::unique_ptr<LevelTileSource> source;
+    std::uint64_t seed;
+    std::vector<TileResidency> residency;
+    std::unordered_map<int, EvictedTile> evicted;
+    LevelStreamStats stats;
+
+  public:
+    LevelStreaming(std::unique_ptr<LevelTileSource> && source, std::uint64_t seed, int tile_total);
+
+    TileResidency GetResidency(int tile) const { return this->residency[tile]; }
+    bool IsResident(int tile) const { return this->residency[tile] == TileResidency::Resident; }
+    const LevelStreamStats & GetStats() const { return this->stats; }
+
+    /* Write the terrain of a tile that is not resident, row y of it starting at pixels + y * pitch.
+     * Safe to call for different tiles from several threads at once. */
+    void Load(int tile, Rect rect, LevelPixel * pixels, int pitch) const;
+    void MarkResident(int tile);
+    /* Keep what the tile changed against its generated terrain. Returns the bytes the tile takes now. */
+    std::size_t Evict(int tile, Rect rect, const LevelPixel * pixels, int pitch);
+
+  private:
+    /* Terrain and texture of the tile as it was before anything changed it */
+    void Generate(int tile, Rect rect, LevelPixel * pixels, int pitch) const;
+};
@@ -0,0 +1,23 @@
+#include "level_tiles.h"
+
+LevelTiles::LevelTiles(Size level_size)
+    : size(level_size),
+      tile_count((level_size.x + TileSize - 1) / TileSize, (level_size.y + TileSize - 1) / TileSize),
+      tiles(std::make_unique<TileState[]>(std::size_t(tile_count.x) * tile_count.y))
+{
+}
+
+Rect LevelTiles::GetTileRect(int tile) const
+{
+    Position origin = {(tile % this->tile_count.x) * TileSize, (tile / this->tile_count.x) * TileSize};
+    return Rect{origin, Size{std::min(TileSize, this->size.x - origin.x), std::min(TileSize, this->size.y - origin.y)}};
+}
+
+void LevelTiles::MarkAllChanged()
+{
+    for (int tile = 0; tile < GetTileTotal(); ++tile)
+    {
+        this->tiles[tile].version.fetch_add(1, std::memory_order_relaxed);
+        this->tiles[tile].is_dirty.store(true, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "types.h"
+
+/*
+ * LevelTiles
+ *  Coarse grid of square tiles laid over the row-major level data. Each tile carries
+ *   - version: bumped on every write into the tile. Consumers remember the version they saw last
+ *              and skip tiles that did not change since.
+ *   - dirty flag: the tile holds pixels that were written raw and not committed to the terrain surface yet.
+ *                 Writes that commit themselves only bump the version.
+ *   - preserved generation: the newest snapshot generation that already holds its own copy of the tile.
+ *  Both are maintained by Level::SetLevelData once the level is materialized.
+ */
+class LevelTiles
+{
+  public:
+    /* 64x64 tiles. One tile row is exactly one 64-bit word of a bit plane. */
+    constexpr static int TileSizeShift = 6;
+    constexpr static int TileSize = 1 << TileSizeShift;
+
+    using Version = std::uint32_t;
+
+  private:
+    struct TileState
+    {
+        std::atomic<Version> version = 0;
+        std::atomic<bool> is_dirty = false;
+        std::atomic<Version> preserved_generation = 0; /* Snapshot generation the tile was last preserved for */
+    };
+
+    Size size;
+    Size tile_count;
+    std::unique_ptr<TileState[]> tiles;
+
+  public:
+    LevelTiles(Size level_size);
+
+    Size GetTileCount() const { return this->tile_count; }
+    int GetTileTotal() const { return this->tile_count.x * this->tile_count.y; }
+    int GetTileIndex(Position pos) const
+    {
+        return (pos.x >> TileSizeShift) + (pos.y >> TileSizeShift) * this->tile_count.x;
+    }
+    /* Area of the level covered by the tile. Tiles on the right and bottom edge may be smaller. */
+    Rect GetTileRect(int tile) const;
+
+    /* Signal a write into the pixel that nothing commits on its own */
+    void MarkChanged(Position pos)
+    {
+        TileState & tile = this->tiles[GetTileIndex(pos)];
+        tile.version.fetch_add(1, std::memory_order_relaxed);
+        tile.is_dirty.store(true, std::memory_order_relaxed);
+    }
+    /* Signal a write into the pixel that reaches the terrain surface through its own commit */
+    void MarkWritten(Position pos)
+    {
+        this->tiles[GetTileIndex(pos)].version.fetch_add(1, std::memory_order_relaxed);
+    }
+    void MarkAllChanged();
+    /* Signal that the tile got new contents as a whole and its surface is already up to date with them */
+    void MarkReplaced(int tile)
+    {
+        this->tiles[tile].version.fetch_add(1, std::memory_order_relaxed);
+        this->tiles[tile].is_dirty.store(false, std::memory_order_relaxed);
+    }
+
+    Version GetVersion(int tile) const { return this->tiles[tile].version.load(std::memory_order_relaxed); }
+    bool IsDirty(int tile) const { return this->tiles[tile].is_dirty.load(std::memory_order_relaxed); }
+
+    /* Acquire/release so a writer that sees the tile preserved also sees the copy finished */
+    Version GetPreservedGeneration(int tile) const
+    {
+        return this->tiles[tile].preserved_generation.load(std::memory_order_acquire);
+    }
+    void SetPreservedGeneration(int tile, Version generation)
+    {
+        this->tiles[tile].preserved_generation.store(generation, std::memory_order_release);
+    }
+
+    /* Call TileFunc(int tile, Rect tile_rect) for every dirty tile and clear its dirty flag */
+    template <typename TileFunc>
+    int ConsumeDirty(TileFunc tile_func);
+};
+
+template <typename TileFunc>
+int LevelTiles::ConsumeDirty(TileFunc tile_func)
+{
+    int consumed = 0;
+    for (int tile = 0; tile < GetTileTotal(); ++tile)
+    {
+        if (this->tiles[tile].is_dirty.exchange(false, std::memory_order_relaxed))
+        {
+            tile_func(tile, GetTileRect(tile));
+            ++consumed;
+        }
+    }
+    return consumed;
+}
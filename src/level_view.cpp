@@ -16,6 +16,12 @@ LevelView::QueryResult LevelView::QueryPoint(Offset offset)
 
 LevelView::QueryResult LevelView::QueryCircle(Offset offset)
 {
+	/* Whole circle inside of the view and the level with nothing blocking inside: skip the per-pixel queries */
+	Rect circle_rect = Rect{tank->GetPosition() + offset + Offset{-3, -3}, Size{7, 7}};
+	if (abs(offset.x) + 3 < Width / 2 && abs(offset.y) + 3 < Height / 2 && this->lvl->IsInBounds(circle_rect) &&
+		!this->lvl->CountPixelsInPlane(circle_rect, LevelPlane::Blocking))
+		return QueryResult::Open;
+
 	for (int dy = offset.y - 3; dy <= offset.y + 3; dy++)
 		for (int dx = offset.x - 3; dx <= offset.x + 3; dx++) {
 			/* Don't take out the corners: */
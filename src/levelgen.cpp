@@ -1,14 +1,20 @@
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
-#include <array>
 #include <gamelib.h>
 #include <levelgen.h>
+#include <limits>
 #include <memory>
+#include <vector>
 
+#include <exceptions.h>
+#include <level.h>
 #include <levelgen_braid.h>
+#include <levelgen_caves.h>
 #include <levelgen_maze.h>
 #include <levelgen_simple.h>
 #include <levelgen_toast.h>
+#include <random.h>
 #include <trace.h>
 
 namespace levelgen
@@ -24,26 +30,41 @@ struct LevelGeneratorDesc
 
 /* === All the generator headers go here: =================================== */
 
-/* Add an entry for every generator: */
-std::array<LevelGeneratorDesc, 4> LevelGenerators = {
-    LevelGeneratorDesc{.id = LevelGeneratorType::Toast,
-                       .name = "toast",
-                       .generator = std::make_unique<levelgen::toast::ToastLevelGenerator>(),
-                       .desc = "Twisty, cavernous maps."},
-    LevelGeneratorDesc{.id = LevelGeneratorType::Braid,
-                       .name = "braid",
-                       .generator = std::make_unique<levelgen::braid::BraidLevelGenerator>(),
-                       .desc = "Maze-like maps with no dead ends."},
-    LevelGeneratorDesc{.id = LevelGeneratorType::Maze,
-                       .name = "maze",
-                       .generator = std::make_unique<levelgen::maze::MazeLevelGenerator>(),
-                       .desc = "Complicated maps with a maze surrounding the bases."},
-    LevelGeneratorDesc{.id = LevelGeneratorType::Simple,
-                       .name = "simple",
-                       .generator = std::make_unique<levelgen::simple::SimpleLevelGenerator>(),
-                       .desc = "Simple rectangular maps with ragged sides."},
-
-};
+/* Add an entry for every generator. The first one is the default. */
+std::vector<LevelGeneratorDesc> LevelGenerators = [] {
+    std::vector<LevelGeneratorDesc> generators;
+    generators.push_back(LevelGeneratorDesc{.id = LevelGeneratorType::Toast,
+                                            .name = "toast",
+                                            .generator = std::make_unique<levelgen::toast::ToastLevelGenerator>(),
+                                            .desc = "Twisty, cavernous maps."});
+    generators.push_back(LevelGeneratorDesc{.id = LevelGeneratorType::Braid,
+                                            .name = "braid",
+                                            .generator = std::make_unique<levelgen::braid::BraidLevelGenerator>(),
+                                            .desc = "Maze-like maps with no dead ends."});
+    generators.push_back(LevelGeneratorDesc{.id = LevelGeneratorType::Maze,
+                                            .name = "maze",
+                                            .generator = std::make_unique<levelgen::maze::MazeLevelGenerator>(),
+                                            .desc = "Complicated maps with a maze surrounding the bases."});
+    generators.push_back(LevelGeneratorDesc{.id = LevelGeneratorType::Simple,
+                                            .name = "simple",
+                                            .generator = std::make_unique<levelgen::simple::SimpleLevelGenerator>(),
+                                            .desc = "Simple rectangular maps with ragged sides."});
+    generators.push_back(LevelGeneratorDesc{.id = LevelGeneratorType::Caves,
+                                            .name = "caves",
+                                            .generator = std::make_unique<levelgen::caves::CavesLevelGenerator>(),
+                                            .desc = "Open caves of layered noise, any size. Can be streamed."});
+    return generators;
+}();
+
+static LevelGeneratorDesc * FindGenerator(LevelGeneratorType generator)
+{
+    /* If 'id' is null, go with the default: */
+    if (generator == LevelGeneratorType::None)
+        generator = LevelGenerators[0].id;
+    auto found = std::find_if(LevelGenerators.begin(), LevelGenerators.end(),
+                              [generator](const auto & desc) { return desc.id == generator; });
+    return found == LevelGenerators.end() ? &LevelGenerators[0] : &*found;
+}
 
 LevelGeneratorType LevelGenerator::FromName(const char * name)
 {
@@ -61,38 +82,100 @@ LevelGeneratorType LevelGenerator::FromName(const char * name)
     return LevelGeneratorType::None;
 }
 
-/* ========================================================================== */
-
-/* Linear search is ok here, since there aren't many level generators: */
-GeneratedLevel LevelGenerator::Generate(LevelGeneratorType generator, Size size)
+const char * LevelGenerator::GetName(LevelGeneratorType generator)
 {
-
-    /* If 'id' is null, go with the default: */
-    if (generator == LevelGeneratorType::None)
-        generator = LevelGenerators[0].id;
-
-    auto found = std::find_if(LevelGenerators.begin(), LevelGenerators.end(),
-                              [generator](const auto & desc) { return desc.id == generator; });
-    if (found == LevelGenerators.end())
+    for (auto & desc : LevelGenerators)
     {
-        /* Report what level generator we found: */
-        gamelib_print("Using default level generator: '%s'\n", LevelGenerators[0].id);
+        if (desc.id == generator)
+            return desc.name;
     }
-    gamelib_print("Using level generator: '%s'\n", found->name);
+    return "none";
+}
+
+/* ========================================================================== */
+
+/* Run generate_func(GenerationStages &) -> std::unique_ptr<Level> and report how long it took */
+template <typename GenerateFunc>
+static GeneratedLevel TimeGeneration(const LevelGeneratorDesc & desc, GenerateFunc generate_func)
+{
+    gamelib_print("Using level generator: '%s'\n", desc.name);
     {
         Stopwatch<std::chrono::milliseconds> s;
 
         /* Ok, now generate the level: */
-        std::unique_ptr<Level> level =  found->generator->Generate(size);
+        GenerationStages stages;
+        std::unique_ptr<Level> level = generate_func(stages);
 
         gamelib_print("Level generated in: ");
         auto msecs = s.GetElapsed();
         gamelib_print("%lld.%03lld sec\n", msecs.count() / 1000, msecs.count() % 1000);
 
-        return {.level = std::move(level), .generation_time = std::chrono::duration_cast<std::chrono::milliseconds>(msecs)};
+        return {.level = std::move(level),
+                .generation_time = std::chrono::duration_cast<std::chrono::milliseconds>(msecs),
+                .stages = std::move(stages)};
     }
 }
 
+/* Linear search is ok here, since there aren't many level generators: */
+GeneratedLevel LevelGenerator::Generate(LevelGeneratorType generator, Size size)
+{
+    LevelGeneratorDesc * desc = FindGenerator(generator);
+    return TimeGeneration(*desc, [desc, size](GenerationStages & stages) {
+        return desc->generator->Generate(size, stages);
+    });
+}
+
+GeneratedLevel LevelGenerator::GenerateStreamed(LevelGeneratorType generator, Size size)
+{
+    LevelGeneratorDesc * desc = FindGenerator(generator);
+    auto * tiled = dynamic_cast<TiledGeneratorAlgorithm *>(desc->generator.get());
+    if (!tiled)
+        throw GameException("This level generator can't stream levels.");
+    return TimeGeneration(*desc, [tiled, size](GenerationStages & stages) {
+        return tiled->GenerateStreamed(size, stages);
+    });
+}
+
+bool LevelGenerator::CanStream(LevelGeneratorType generator)
+{
+    return dynamic_cast<TiledGeneratorAlgorithm *>(FindGenerator(generator)->generator.get()) != nullptr;
+}
+
+/* Same seed draw as Level::GenerateDirtAndRocks */
+static std::uint64_t DrawTileSeed()
+{
+    return std::uint64_t(ThreadRandom().Int(0, std::numeric_limits<int>::max()));
+}
+
+std::unique_ptr<Level> TiledGeneratorAlgorithm::Generate(Size size, GenerationStages & stages)
+{
+    std::unique_ptr<Level> level = std::make_unique<Level>(size);
+    TiledLevel tiled;
+    TimeStage(stages, "create_tiles", [this, &tiled, size]() { tiled = CreateTiles(size, DrawTileSeed()); });
+    TimeStage(stages, "generate_tiles", [&level, &tiled, size]() {
+        level->ForEachRowParallel([&tiled, size](int y, LevelPixel * row, ThreadLocal *) {
+            tiled.source->Generate(Rect{0, y, size.x, 1}, row);
+            return 0;
+        });
+    });
+    for (int i = 0; i < int(tiled.spawns.size()); ++i)
+        level->SetSpawn(TankColor(i), tiled.spawns[i]);
+    return level;
+}
+
+std::unique_ptr<Level> TiledGeneratorAlgorithm::GenerateStreamed(Size size, GenerationStages & stages)
+{
+    const std::uint64_t seed = DrawTileSeed();
+    TiledLevel tiled;
+    TimeStage(stages, "create_tiles", [this, &tiled, size, seed]() { tiled = CreateTiles(size, seed); });
+    /* Texture of the tiles gets its own seed, the source may use the seed in any way */
+    std::unique_ptr<Level> level =
+        std::make_unique<Level>(size, std::move(tiled.source), StreamRandom::Mix(seed ^ 0x5EED));
+    for (int i = 0; i < int(tiled.spawns.size()); ++i)
+        level->SetSpawn(TankColor(i), tiled.spawns[i]);
+    return level;
+}
+
 /* Will print a specified number of spaces to the file: */
 static void put_chars(size_t i, char c)
 {
@@ -132,14 +215,14 @@ void LevelGenerator::PrintAllGenerators(FILE *)
 
 int Queries::CountNeighborValues(Position pos, Level * level)
 {
-    return (char)level->GetVoxelRaw((pos.x - 1 + level->GetSize().x * (pos.y - 1))) +
-           (char)level->GetVoxelRaw((pos.x + level->GetSize().x * (pos.y - 1))) +
-           (char)level->GetVoxelRaw((pos.x + 1 + level->GetSize().x * (pos.y - 1))) +
-           (char)level->GetVoxelRaw((pos.x - 1 + level->GetSize().x * (pos.y))) +
-           (char)level->GetVoxelRaw((pos.x + 1 + level->GetSize().x * (pos.y))) +
-           (char)level->GetVoxelRaw((pos.x - 1 + level->GetSize().x * (pos.y + 1))) +
-           (char)level->GetVoxelRaw((pos.x + level->GetSize().x * (pos.y + 1))) +
-           (char)level->GetVoxelRaw((pos.x + 1 + level->GetSize().x * (pos.y + 1)));
+    return (char)level->GetVoxelRaw(Position{pos.x - 1, pos.y - 1}) +
+           (char)level->GetVoxelRaw(Position{pos.x, pos.y - 1}) +
+           (char)level->GetVoxelRaw(Position{pos.x + 1, pos.y - 1}) +
+           (char)level->GetVoxelRaw(Position{pos.x - 1, pos.y}) +
+           (char)level->GetVoxelRaw(Position{pos.x + 1, pos.y}) +
+           (char)level->GetVoxelRaw(Position{pos.x - 1, pos.y + 1}) +
+           (char)level->GetVoxelRaw(Position{pos.x, pos.y + 1}) +
+           (char)level->GetVoxelRaw(Position{pos.x + 1, pos.y + 1});
 }
 
 } // namespace levelgen
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
+#include "level_streaming.h"
+#include "trace.h"
 #include "types.h"
 #include <chrono>
+#include <cstdint>
 #include <cstdio>
 #include <memory>
+#include <vector>
 class Level;
 
 namespace levelgen
@@ -15,19 +19,43 @@ enum class LevelGeneratorType
     Braid,
     Maze,
     Simple,
+    Caves,
 };
 
+/* Time one named step of a generator took */
+struct GenerationStage
+{
+    const char * name;
+    std::chrono::microseconds time;
+};
+using GenerationStages = std::vector<GenerationStage>;
+
+/* Run stage_func as a step of generation and append its time to stages */
+template <typename StageFunc>
+void TimeStage(GenerationStages & stages, const char * name, StageFunc && stage_func)
+{
+    Stopwatch<> elapsed;
+    stage_func();
+    stages.push_back(GenerationStage{name, elapsed.GetElapsed()});
+}
+
 struct GeneratedLevel
 {
     std::unique_ptr<Level> level;
     std::chrono::milliseconds generation_time;
+    GenerationStages stages; /* Steps the generator timed, in the order they ran */
 };
 
 class LevelGenerator
 {
   public:
     static GeneratedLevel Generate(LevelGeneratorType generator, Size size);
+    /* Level that generates its terrain tile by tile as it gets materialized, see Level::MaterializeTiles.
+     * Throws GameException for generators that can't do that. */
+    static GeneratedLevel GenerateStreamed(LevelGeneratorType generator, Size size);
+    static bool CanStream(LevelGeneratorType generator);
     static LevelGeneratorType FromName(const char * name);
+    static const char * GetName(LevelGeneratorType generator);
     static void PrintAllGenerators(FILE * out);
 };
 
@@ -35,9 +63,33 @@ class GeneratorAlgorithm
 {
   public:
     virtual ~GeneratorAlgorithm() = default;
-    /* Generate a level based on an id: */
+    /* Generate a level based on an id. The level has to depend only on the size and the state of ThreadRandom(),
+     * never on the number of workers, so that a seed gives the same map everywhere
+     * (tunneltanks_levelgen_bench --golden). */
   public:
-    virtual std::unique_ptr<Level> Generate(Size size) = 0;
+    virtual std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) = 0;
+};
+
+/* Terrain and spawns of a level made by a TiledGeneratorAlgorithm */
+struct TiledLevel
+{
+    std::unique_ptr<LevelTileSource> source;
+    std::vector<Position> spawns;
+};
+
+/*
+ * TiledGeneratorAlgorithm: generator of levels whose every part can be generated on its own
+ *  CreateTiles only decides what has to be known up front, like the spawns, and leaves the terrain to the
+ *  source. A streamed level then costs the same to start at any size.
+ */
+class TiledGeneratorAlgorithm : public GeneratorAlgorithm
+{
+  public:
+    virtual TiledLevel CreateTiles(Size size, std::uint64_t seed) = 0;
+
+    /* Whole level at once, with the terrain of the streamed one */
+    std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) override;
+    std::unique_ptr<Level> GenerateStreamed(Size size, GenerationStages & stages);
 };
 
 class Queries
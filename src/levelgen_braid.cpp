@@ -2,6 +2,7 @@
 #include <levelgenutil.h>
 #include <memalloc.h>
 #include <random.h>
+#include <vector>
 #include "levelgen_braid.h"
 
 namespace levelgen::braid
@@ -14,8 +15,8 @@ namespace levelgen::braid
 
 /* This generator will randomly shuffle all possible edges, and then add them
  * so long as it doesn't leave some part of the maze unreachable, or create a
- * dead-end path. This is in no way optimal, but I do like the maps that it
- * creates... */
+ * dead-end path. Walls that would cut something off are found by keeping the
+ * wall corners in a union-find, see WallCorners. */
 
 typedef struct Cell
 {
@@ -45,30 +46,37 @@ typedef struct Wall
     Dir d;
 } Wall;
 
-/* This is a recursive function used by braid_is_connected: */
-static void flood_fill(Braid * b, int x, int y)
+/* Colors every cell reachable from the first one. The stack is kept between calls: */
+static void flood_fill(Braid * b, std::vector<int> & stack)
 {
-
-    /* Skip if we've already been filled: */
-    if (b->data[y * b->size.x + x].flag)
-        return;
-
-    /* Color ourselves: */
-    b->data[y * b->size.x + x].flag = 1;
-
-    /* Try to recurse into our neighbors: */
-    if (x > 0 && !b->data[y * b->size.x + (x - 1)].right)
-        flood_fill(b, x - 1, y);
-    if (x < b->size.x - 1 && !b->data[y * b->size.x + x].right)
-        flood_fill(b, x + 1, y);
-    if (y > 0 && !b->data[y * b->size.x + x].up)
-        flood_fill(b, x, y - 1);
-    if (y < b->size.y - 1 && !b->data[(y + 1) * b->size.x + x].up)
-        flood_fill(b, x, y + 1);
+    stack.assign(1, 0);
+    b->data[0].flag = 1;
+    while (!stack.empty())
+    {
+        int i = stack.back();
+        int x = i % b->size.x, y = i / b->size.x;
+        stack.pop_back();
+
+        /* Color our uncolored neighbors, and visit them later: */
+        auto visit = [b, &stack](int neighbor) {
+            if (b->data[neighbor].flag)
+                return;
+            b->data[neighbor].flag = 1;
+            stack.push_back(neighbor);
+        };
+        if (x > 0 && !b->data[i - 1].right)
+            visit(i - 1);
+        if (x < b->size.x - 1 && !b->data[i].right)
+            visit(i + 1);
+        if (y > 0 && !b->data[i].up)
+            visit(i - b->size.x);
+        if (y < b->size.y - 1 && !b->data[i + b->size.x].up)
+            visit(i + b->size.x);
+    }
 }
 
 /* This will check a map for a cut-off region: */
-static int braid_is_connected(Braid * b)
+static int braid_is_connected(Braid * b, std::vector<int> & stack)
 {
     int i;
 
@@ -76,8 +84,8 @@ static int braid_is_connected(Braid * b)
     for (i = 0; i < b->size.x * b->size.y; i++)
         b->data[i].flag = 0;
 
-    /* Recursively color all of the nodes: */
-    flood_fill(b, 0, 0);
+    /* Color all of the nodes: */
+    flood_fill(b, stack);
 
     /* Check for an uncolored node: */
     for (i = 0; i < b->size.x * b->size.y; i++)
@@ -87,6 +95,41 @@ static int braid_is_connected(Braid * b)
     return 1;
 }
 
+/* Walls connect the corners of cells. A new wall cuts a region of cells off exactly when its two corners are
+ * connected by walls already, the border counts as a wall all around: */
+class WallCorners
+{
+    Size size;
+    DisjointSets corners;
+
+    int Corner(int x, int y) const { return y * (this->size.x + 1) + x; }
+
+  public:
+    explicit WallCorners(Size size) : size(size), corners((size.x + 1) * (size.y + 1))
+    {
+        for (int x = 0; x <= size.x; x++)
+        {
+            this->corners.Join(Corner(0, 0), Corner(x, 0));
+            this->corners.Join(Corner(0, 0), Corner(x, size.y));
+        }
+        for (int y = 0; y <= size.y; y++)
+        {
+            this->corners.Join(Corner(0, 0), Corner(0, y));
+            this->corners.Join(Corner(0, 0), Corner(size.x, y));
+        }
+    }
+
+    /* Adds the wall unless it would cut something off. Walls on the border never do: */
+    bool TryAdd(const Wall & w)
+    {
+        if ((w.d == DIR_UP && w.y == 0) || (w.d == DIR_RIGHT && w.x == this->size.x - 1))
+            return true;
+        if (w.d == DIR_UP)
+            return this->corners.Join(Corner(w.x, w.y), Corner(w.x + 1, w.y));
+        return this->corners.Join(Corner(w.x + 1, w.y), Corner(w.x + 1, w.y + 1));
+    }
+};
+
 /* This will check to see if adding a wall will make a node a dead end: */
 static int braid_node_dead_end(Braid * b, int x, int y, Dir d)
 {
@@ -133,7 +176,7 @@ static void wall_shuffle(Wall * w, int len)
     /* Run through the list once, shuffling everything: */
     for (i = 0; i < len; i++)
     {
-        int new_index = Random.Int(0, len - 1);
+        int new_index = ThreadRandom().Int(0, len - 1);
         Wall temp = w[i];
         w[i] = w[new_index];
         w[new_index] = temp;
@@ -141,11 +184,13 @@ static void wall_shuffle(Wall * w, int len)
 }
 
 /* Fills in a Braid object with a braid maze: */
-static void braid_populate(Braid * b)
+static void braid_populate(Braid * b, BraidConnectivity connectivity)
 {
     Wall * w;
     int i;
     int x, y;
+    WallCorners corners(b->size);
+    std::vector<int> stack;
 
     /* Set all walls to empty: */
     for (i = 0; i < b->size.x * b->size.y; i++)
@@ -182,14 +227,18 @@ static void braid_populate(Braid * b)
         if (braid_makes_dead_end(b, w[i].x, w[i].y, w[i].d))
             continue;
 
+        /* Check that this edge won't close a loop of walls: */
+        if (connectivity == BraidConnectivity::WallCorners && !corners.TryAdd(w[i]))
+            continue;
+
         /* Set this wall: */
         if (w[i].d == DIR_UP)
             b->data[w[i].y * b->size.x + w[i].x].up = 1;
         else if (w[i].d == DIR_RIGHT)
             b->data[w[i].y * b->size.x + w[i].x].right = 1;
 
-        /* Now check for isolated regions: */
-        if (!braid_is_connected(b))
+        /* Or check the whole maze for isolated regions: */
+        if (connectivity == BraidConnectivity::FloodFill && !braid_is_connected(b, stack))
         {
             /* Oops. Blocked something off. Undo that... */
             if (w[i].d == DIR_UP)
@@ -203,13 +252,13 @@ static void braid_populate(Braid * b)
     free_mem(w);
 }
 
-static Braid * braid_new(Size size)
+static Braid * braid_new(Size size, BraidConnectivity connectivity)
 {
     Braid * b = get_object(Braid);
     b->size = size;
     b->data = static_cast<Cell *>(get_mem(sizeof(Cell) * size.x * size.y));
 
-    braid_populate(b);
+    braid_populate(b, connectivity);
 
     return b;
 }
@@ -222,10 +271,20 @@ static void braid_free(Braid * b)
     free_mem(b);
 }
 
-std::unique_ptr<Level> BraidLevelGenerator::Generate(Size size)
+std::vector<std::uint8_t> GenerateBraidWalls(Size cells, BraidConnectivity connectivity)
+{
+    Braid * b = braid_new(cells, connectivity);
+    std::vector<std::uint8_t> walls(cells.x * cells.y);
+    for (int i = 0; i < cells.x * cells.y; i++)
+        walls[i] = std::uint8_t(b->data[i].up | b->data[i].right << 1);
+    braid_free(b);
+    return walls;
+}
+
+std::unique_ptr<Level> BraidLevelGenerator::Generate(Size size, GenerationStages &)
 {
     std::unique_ptr<Level> lvl = std::make_unique<Level>(size);
-	Braid *b = braid_new(lvl->GetSize() / CELL_SIZE);
+	Braid *b = braid_new(lvl->GetSize() / CELL_SIZE, BraidConnectivity::WallCorners);
 	
 	/* Reset all of the 'used' flags back to zero: */
 	for(int i=0; i<b->size.x * b->size.y; i++)
@@ -273,14 +332,14 @@ std::unique_ptr<Level> BraidLevelGenerator::Generate(Size size)
 		int x, y;
 		/* Pick a random spot for the base: */
 		do {
-			x = Random.Int(0, b->size.x-1); 
-			y = Random.Int(0, b->size.y-1);
+			x = ThreadRandom().Int(0, b->size.x-1); 
+			y = ThreadRandom().Int(0, b->size.y-1);
 		} while(b->data[y*b->size.x+x].flag);
 		
 		/* Mark our spot, and the ones around it as well: */
 		for(tx=-1; tx<=1; tx++)
 			for(ty=-1; ty<=1; ty++)
-				if(x+tx < b->size.x && y+ty < b->size.y)
+				if(x+tx >= 0 && y+ty >= 0 && x+tx < b->size.x && y+ty < b->size.y)
 					b->data[(y+ty)*b->size.x+(x+tx)].flag = 1;
 		
 		/* Now, add it to the level: */
@@ -1,15 +1,29 @@
 #pragma once
 #include "level.h"
 #include "levelgen.h"
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace levelgen::braid
 {
 
+/* How a new wall is tested for cutting the maze apart. FloodFill floods the whole maze for every wall,
+ * it is kept to compare against in tunneltanks_braid_bench. */
+enum class BraidConnectivity
+{
+    WallCorners,
+    FloodFill,
+};
+
+/* Walls of a braid maze of cells.x by cells.y cells, row by row. Bit 0 is the wall above the cell, bit 1 the wall
+ * right of it. */
+std::vector<std::uint8_t> GenerateBraidWalls(Size cells, BraidConnectivity connectivity);
+
 class BraidLevelGenerator : public GeneratorAlgorithm
 {
   public:
-    std::unique_ptr<Level> Generate(Size size) override;
+    std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) override;
 };
 
 } // namespace levelgen::braid
@@ -0,0 +1,119 @@
+#include "levelgen_caves.h"
+#include <algorithm>
+#include <cmath>
+
+#include "exceptions.h"
+#include "random.h"
+#include "tweak.h"
+
+namespace levelgen::caves
+{
+
+/* Rock blobs come from one noise field. Passages follow the middle contour of another, so they wind through
+ * the rock and cross each other, and the caves stay connected without a search over the whole level. */
+enum NoiseField : std::uint64_t
+{
+    RockField = 1,
+    PassageField = 2,
+    SpawnStream = 3,
+};
+
+static float Lattice(std::uint64_t seed, std::uint64_t field, int octave, int x, int y)
+{
+    std::uint64_t hash = StreamRandom::Mix(seed ^ StreamRandom::Mix(field * 0x100 + octave));
+    hash = StreamRandom::Mix(hash ^ (std::uint64_t(std::uint32_t(x)) << 32 | std::uint32_t(y)));
+    return float(hash >> 40) / float(1 << 24);
+}
+
+std::vector<CavesTileSource::LatticePatch> CavesTileSource::MakePatches(std::uint64_t field, Rect rect,
+                                                                         int scale) const
+{
+    std::vector<LatticePatch> octaves;
+    for (int octave = 0; octave < CavesParams::Octaves; ++octave, scale /= 2)
+    {
+        const Position first_cell = {rect.Left() / scale, rect.Top() / scale};
+        const Position last_cell = {rect.Right() / scale + 1, rect.Bottom() / scale + 1};
+        LatticePatch patch = {
+            .scale = scale, .first_cell = first_cell, .stride = last_cell.x - first_cell.x + 1, .values = {}};
+        for (int y = first_cell.y; y <= last_cell.y; ++y)
+            for (int x = first_cell.x; x <= last_cell.x; ++x)
+                patch.values.push_back(Lattice(this->seed, field, octave, x, y));
+        octaves.push_back(std::move(patch));
+    }
+    return octaves;
+}
+
+float CavesTileSource::Noise(const std::vector<LatticePatch> & octaves, Position pos)
+{
+    float sum = 0, amplitude = 1, total = 0;
+    for (const LatticePatch & patch : octaves)
+    {
+        const int scale = patch.scale;
+        const float * cell = &patch.values[std::size_t(pos.y / scale - patch.first_cell.y) * patch.stride +
+                                           (pos.x / scale - patch.first_cell.x)];
+        float fx = float(pos.x % scale) / scale, fy = float(pos.y % scale) / scale;
+        fx = fx * fx * (3 - 2 * fx);
+        fy = fy * fy * (3 - 2 * fy);
+        /* Spelled out instead of std::lerp, whose rounding differs between standard libraries */
+        const float top = cell[0] + (cell[1] - cell[0]) * fx;
+        const float bottom = cell[patch.stride] + (cell[patch.stride + 1] - cell[patch.stride]) * fx;
+        sum += (top + (bottom - top) * fy) * amplitude;
+        total += amplitude;
+        amplitude /= 2;
+    }
+    return sum / total;
+}
+
+bool CavesTileSource::IsDirt(Position pos, const NoisePatches & patches) const
+{
+    if (pos.x < CavesParams::BorderWidth || pos.y < CavesParams::BorderWidth ||
+        pos.x >= this->size.x - CavesParams::BorderWidth || pos.y >= this->size.y - CavesParams::BorderWidth)
+        return false;
+    for (Position spawn : this->spawns)
+        if ((pos.x - spawn.x) * (pos.x - spawn.x) + (pos.y - spawn.y) * (pos.y - spawn.y) <=
+            CavesParams::SpawnClearing * CavesParams::SpawnClearing)
+            return true;
+    return Noise(patches.rock, pos) < CavesParams::RockLevel ||
+           std::abs(Noise(patches.passage, pos) - 0.5f) < CavesParams::PassageWidth;
+}
+
+void CavesTileSource::Generate(Rect rect, LevelPixel * pixels) const
+{
+    /* Lattice values depend on the cell only, so the pixels come out the same for any rectangle */
+    const NoisePatches patches = {.rock = MakePatches(RockField, rect, CavesParams::RockScale),
+                                  .passage = MakePatches(PassageField, rect, CavesParams::PassageScale)};
+    Position pos;
+    for (pos.y = rect.Top(); pos.y <= rect.Bottom(); ++pos.y)
+        for (pos.x = rect.Left(); pos.x <= rect.Right(); ++pos.x)
+            *pixels++ = IsDirt(pos, patches) ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock;
+}
+
+TiledLevel CavesLevelGenerator::CreateTiles(Size size, std::uint64_t seed)
+{
+    /* Spawns are the only thing decided for the whole level, and only in its middle */
+    const int margin = CavesParams::BorderWidth + CavesParams::SpawnClearing;
+    const Size area = {std::min(size.x - 2 * margin, CavesParams::SpawnArea.x),
+                       std::min(size.y - 2 * margin, CavesParams::SpawnArea.y)};
+    const Position corner = {(size.x - area.x) / 2, (size.y - area.y) / 2};
+
+    StreamRandom random = {seed, SpawnStream};
+    std::vector<Position> spawns;
+    for (int attempt = 0; attempt < CavesParams::SpawnAttempts && area.x > 0 && area.y > 0 &&
+                          int(spawns.size()) < tweak::world::MaxPlayers;
+         ++attempt)
+    {
+        const Position point = {corner.x + random.Int(0, area.x - 1), corner.y + random.Int(0, area.y - 1)};
+        const bool is_far = std::all_of(spawns.begin(), spawns.end(), [point](Position spawn) {
+            const std::int64_t dx = point.x - spawn.x, dy = point.y - spawn.y;
+            return dx * dx + dy * dy >= std::int64_t(tweak::base::MinDistance) * tweak::base::MinDistance;
+        });
+        if (is_far)
+            spawns.push_back(point);
+    }
+    if (int(spawns.size()) != tweak::world::MaxPlayers)
+        throw GameException("Level is too small to place all bases far enough apart");
+
+    return TiledLevel{.source = std::make_unique<CavesTileSource>(size, seed, spawns), .spawns = spawns};
+}
+
+} // namespace levelgen::caves
@@ -0,0 +1,65 @@
+#pragma once
+#include "level.h"
+#include "levelgen.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace levelgen::caves
+{
+
+struct CavesParams
+{
+    constexpr static int BorderWidth = 8;
+    constexpr static int RockScale = 160;     /* Size of the coarsest blobs of rock */
+    constexpr static float RockLevel = 0.56f; /* Noise above this is rock. Lower gives more rock. */
+    constexpr static int PassageScale = 240;  /* Size of the bends of passages cut through rock */
+    constexpr static float PassageWidth = 0.035f;
+    constexpr static int Octaves = 3;
+    constexpr static Size SpawnArea = {1500, 750}; /* Bases go into the middle of the level, at most this far apart */
+    constexpr static int SpawnClearing = 45;       /* Dirt all around a base, so that it never starts walled in */
+    constexpr static int SpawnAttempts = 10000;
+};
+
+/* Terrain of a caves level. Every pixel depends only on its position, the seed and the spawns. */
+class CavesTileSource : public LevelTileSource
+{
+    Size size;
+    std::uint64_t seed;
+    std::vector<Position> spawns;
+
+  public:
+    CavesTileSource(Size size, std::uint64_t seed, std::vector<Position> spawns)
+        : size(size), seed(seed), spawns(std::move(spawns))
+    {
+    }
+    void Generate(Rect rect, LevelPixel * pixels) const override;
+
+  private:
+    /* Lattice of one octave of a noise field, for the cells a rectangle touches */
+    struct LatticePatch
+    {
+        int scale;
+        Position first_cell;
+        int stride;
+        std::vector<float> values;
+    };
+    struct NoisePatches
+    {
+        std::vector<LatticePatch> rock;
+        std::vector<LatticePatch> passage;
+    };
+
+    std::vector<LatticePatch> MakePatches(std::uint64_t field, Rect rect, int scale) const;
+    bool IsDirt(Position pos, const NoisePatches & patches) const;
+    /* Sum of octaves of value noise in [0, 1) */
+    static float Noise(const std::vector<LatticePatch> & octaves, Position pos);
+};
+
+class CavesLevelGenerator : public TiledGeneratorAlgorithm
+{
+  public:
+    TiledLevel CreateTiles(Size size, std::uint64_t seed) override;
+};
+
+} // namespace levelgen::caves
@@ -48,7 +48,7 @@ static Dir pick_dir(Maze *m, int x, int y) {
 	if(y != m->h-1 && !m->data[(y+1)*m->w + x].used) list[i++] = DIR_DOWN;
 	
 	/* Pick one: */
-	return (i==0) ? DIR_INVALID : list[Random.Int(0,i-1)];
+	return (i==0) ? DIR_INVALID : list[ThreadRandom().Int(0,i-1)];
 }
 
 /* Note: this doesn't do range checking, so make sure that dir is valid: */
@@ -79,7 +79,7 @@ static void maze_populate(Maze *m) {
 	}
 	
 	/* Now, pick a random cell: */
-	x = Random.Int(0, m->w-1); y = Random.Int(0, m->h-1);
+	x = ThreadRandom().Int(0, m->w-1); y = ThreadRandom().Int(0, m->h-1);
 	
 	do {
 		Dir d = DIR_INVALID;
@@ -144,7 +144,7 @@ static void maze_free(Maze *m) {
 }
 
 
-std::unique_ptr<Level> MazeLevelGenerator::Generate(Size size)
+std::unique_ptr<Level> MazeLevelGenerator::Generate(Size size, GenerationStages &)
 {
     std::unique_ptr<Level> level = std::make_unique<Level>(size);
     Level * lvl = level.get();
@@ -178,11 +178,11 @@ std::unique_ptr<Level> MazeLevelGenerator::Generate(Size size)
 	/* TODO: Have a fill_box() in levelgenutil.c? */
 	for(y=0; y<lvl->GetSize().y; y++)
 		for(x=m->w*CELL_SIZE; x<lvl->GetSize().x; x++)
-			lvl->SetPixel({ x, y }, LevelPixel::LevelGenDirt);
+			lvl->SetVoxelRaw({ x, y }, LevelPixel::LevelGenDirt);
 	
 	for(y=m->h*CELL_SIZE; y<lvl->GetSize().y; y++)
 		for(x=0; x<m->w*CELL_SIZE; x++)
-			lvl->SetPixel({ x, y }, LevelPixel::LevelGenDirt);
+			lvl->SetVoxelRaw({ x, y }, LevelPixel::LevelGenDirt);
 	
 	/* Rough it up a little, and invert: */
 	rough_up(lvl);
@@ -193,13 +193,13 @@ std::unique_ptr<Level> MazeLevelGenerator::Generate(Size size)
 		
 		/* Pick a random spot for the base: */
 		do {
-			x = Random.Int(0, m->w-1); y = Random.Int(0, m->h-1);
+			x = ThreadRandom().Int(0, m->w-1); y = ThreadRandom().Int(0, m->h-1);
 		} while(m->data[y*m->w+x].used);
 		
 		/* Mark our spot, and the ones around it as well: */
 		for(tx=-1; tx<=1; tx++)
 			for(ty=-1; ty<=1; ty++)
-				if(x+tx < m->w && y+ty < m->h)
+				if(x+tx >= 0 && y+ty >= 0 && x+tx < m->w && y+ty < m->h)
 					m->data[(y+ty)*m->w+(x+tx)].used = 1;
 		
 		/* Now, add it to the level: */
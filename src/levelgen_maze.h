@@ -9,7 +9,7 @@ namespace levelgen::maze
 class MazeLevelGenerator : public GeneratorAlgorithm
 {
   public:
-    std::unique_ptr<Level> Generate(Size size) override;
+    std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) override;
 };
 
 } // namespace levelgen::maze
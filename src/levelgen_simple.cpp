@@ -63,12 +63,12 @@ static void add_rock_lines(Level *lvl, Side s)
     }
 
     /* Let's get this party started: */
-    prev = cur = Vector(minx, Random.Int(miny, maxy));
+    prev = cur = Vector(minx, ThreadRandom().Int(miny, maxy));
 
     do
     {
         /* Advance the current x position so it doesn't go over the edge: */
-        cur.x += (xstep = Random.Int(STEP_MIN, STEP_MAX));
+        cur.x += (xstep = ThreadRandom().Int(STEP_MIN, STEP_MAX));
         if (cur.x > maxx)
         {
             xstep = cur.x - maxx;
@@ -76,11 +76,11 @@ static void add_rock_lines(Level *lvl, Side s)
         }
 
         /* Advance the y position so that it is within bounds: */
-        is_rare = Random.Bool(RARITY);
+        is_rare = ThreadRandom().Bool(RARITY);
         do
         {
             int slope = is_rare ? RARE_SLOPE : MAX_SLOPE;
-            ystep = (Random.Int(0, slope * 2) - slope) * xstep;
+            ystep = (ThreadRandom().Int(0, slope * 2) - slope) * xstep;
             ystep /= 100;
         } while ((cur.y + ystep) < miny || (cur.y + ystep) > maxy);
 
@@ -96,27 +96,27 @@ static void add_rock_lines(Level *lvl, Side s)
 
     } while (cur.x != maxx);
 
-    /* Do the correct fill sequence, based on side: */
+    /* Do the correct fill sequence, based on side. Steep lines can leave gaps, don't run off the level through them: */
 
     Position p;
     if (s == SIDE_TOP)
         for (p.x = 0; p.x < lvl->GetSize().x; p.x++)
-            for (p.y = 0; lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.y++)
+            for (p.y = 0; lvl->IsInBounds(p) && lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.y++)
                 lvl->SetVoxelRaw(p, LevelPixel::LevelGenRock);
 
     else if (s == SIDE_RIGHT)
         for (p.y = 0; p.y < lvl->GetSize().y; p.y++)
-            for (p.x = lvl->GetSize().x - 1; lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.x--)
+            for (p.x = lvl->GetSize().x - 1; lvl->IsInBounds(p) && lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.x--)
                 lvl->SetVoxelRaw(p, LevelPixel::LevelGenRock);
 
     else if (s == SIDE_BOTTOM)
         for (p.x = 0; p.x < lvl->GetSize().x; p.x++)
-            for (p.y = lvl->GetSize().y - 1; lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.y--)
+            for (p.y = lvl->GetSize().y - 1; lvl->IsInBounds(p) && lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.y--)
                 lvl->SetVoxelRaw(p, LevelPixel::LevelGenRock);
 
     else if (s == SIDE_LEFT)
         for (p.y = 0; p.y < lvl->GetSize().y; p.y++)
-            for (p.x = 0; lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.x++)
+            for (p.x = 0; lvl->IsInBounds(p) && lvl->GetPixel(p) != static_cast<LevelPixel>(s); p.x++)
                 lvl->SetVoxelRaw(p,  LevelPixel::LevelGenRock);
 }
 
@@ -148,7 +148,7 @@ static void add_spawns(Level *lvl)
     }
 }
 
-std::unique_ptr<Level> SimpleLevelGenerator::Generate(Size size)
+std::unique_ptr<Level> SimpleLevelGenerator::Generate(Size size, GenerationStages &)
 {
     std::unique_ptr<Level> level = std::make_unique<Level>(size);
     Level * lvl = level.get();
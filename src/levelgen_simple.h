@@ -8,7 +8,7 @@ namespace levelgen::simple
 class SimpleLevelGenerator : public GeneratorAlgorithm
 {
   public:
-    std::unique_ptr<Level> Generate(Size size) override;
+    std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) override;
 };
 
 } // namespace levelgen::simple
@@ -1,5 +1,6 @@
 #include <cstdlib>
 
+#include "exceptions.h"
 #include <gamelib.h>
 #include <levelgen.h>
 #include <levelgen_toast.h>
@@ -9,22 +10,28 @@
 #include <random.h>
 #include <trace.h>
 
+#include <algorithm>
+#include <array>
 #include <atomic>
-#include <future>
-
-#include "containers_queue.h"
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "level_bitplanes.h"
 #include "parallelism.h"
+#include "thread_pool.h"
 
 namespace levelgen::toast {
 
 /* Configuration Constants: */
-
-typedef struct Pairing {
-	int dist, a, b;
-} Pairing;
-
-
-using PositionQueue = circular_buffer_adaptor<Position>;
 	
 #ifdef _TESTING
 static void level_draw_ascii(Level *lvl) {
@@ -42,80 +49,132 @@ static void level_draw_ascii(Level *lvl) {
  * STAGE 1: Generate a random tree                                            *
  *----------------------------------------------------------------------------*/
 
-static int pairing_cmp(const void *a, const void *b) {
-	return ((Pairing *)a)->dist - ((Pairing *)b)->dist;
+/* Candidate edge of the tree, ordered by length, ties by the point indices */
+struct Pairing {
+	std::int64_t dist;
+	int a, b;
+
+	bool operator<(const Pairing & other) const {
+		return std::tie(dist, a, b) < std::tie(other.dist, other.a, other.b);
+	}
+};
+
+static std::int64_t point_dist(Position a, Position b) {
+	std::int64_t dx = a.x - b.x, dy = a.y - b.y;
+	return dx * dx + dy * dy;
+}
+
+/* Points bucketed into square cells, so that pairs closer than the cell size are found among 3x3 cells */
+class PointGrid {
+	int cell_size;
+	Size cells;
+	std::vector<int> cell_start; /* Points of cell c are cell_points[cell_start[c] .. cell_start[c + 1]) */
+	std::vector<int> cell_points;
+
+public:
+	PointGrid(const std::vector<Position> & points, Size size, int cell_size)
+		: cell_size(cell_size), cells{size.x / cell_size + 1, size.y / cell_size + 1},
+		  cell_start(std::size_t(cells.x) * cells.y + 1), cell_points(points.size()) {
+		for (Position point : points)
+			++cell_start[CellOf(point) + 1];
+		std::partial_sum(cell_start.begin(), cell_start.end(), cell_start.begin());
+		std::vector<int> fill(cell_start.begin(), cell_start.end() - 1);
+		for (int i = 0; i < int(points.size()); ++i)
+			cell_points[fill[CellOf(points[i])]++] = i;
+	}
+
+	int CellOf(Position point) const { return (point.y / cell_size) * cells.x + point.x / cell_size; }
+
+	/* Calls func(int j) for every point in the 3x3 cells around point */
+	template <typename Func>
+	void ForEachNear(Position point, Func && func) const {
+		int cx = point.x / cell_size, cy = point.y / cell_size;
+		for (int y = std::max(0, cy - 1); y <= std::min(cells.y - 1, cy + 1); ++y)
+			for (int x = std::max(0, cx - 1); x <= std::min(cells.x - 1, cx + 1); ++x) {
+				int cell = y * cells.x + x;
+				for (int k = cell_start[cell]; k < cell_start[cell + 1]; ++k)
+					func(cell_points[k]);
+			}
+	}
+};
+
+/* Picks spawns first-fit among the tree points, then among fresh random points. Those join the points, so the
+ * tree reaches them too. */
+static void place_spawns(Level *lvl, std::vector<Position> & points) {
+	constexpr int min_dist = tweak::base::MinDistance;
+	Size cells = { lvl->GetSize().x / min_dist + 1, lvl->GetSize().y / min_dist + 1 };
+	std::vector<std::vector<Position>> spawn_cells(std::size_t(cells.x) * cells.y);
+
+	int placed = 0;
+	auto try_place = [&](Position point) {
+		int cx = point.x / min_dist, cy = point.y / min_dist;
+		for (int y = std::max(0, cy - 1); y <= std::min(cells.y - 1, cy + 1); ++y)
+			for (int x = std::max(0, cx - 1); x <= std::min(cells.x - 1, cx + 1); ++x)
+				for (Position spawn : spawn_cells[std::size_t(y) * cells.x + x])
+					if (point_dist(point, spawn) < std::int64_t(min_dist) * min_dist)
+						return false;
+		spawn_cells[std::size_t(cy) * cells.x + cx].push_back(point);
+		lvl->SetSpawn(TankColor(placed++), point);
+		return true;
+	};
+
+	for (std::size_t i = 0; i < points.size() && placed < tweak::world::MaxPlayers; ++i)
+		try_place(points[i]);
+	for (int attempt = 0; attempt < ToastParams::SpawnAttempts && placed < tweak::world::MaxPlayers; ++attempt) {
+		Position point = generate_inside(lvl->GetSize(), ToastParams::BorderWidth);
+		if (try_place(point))
+			points.push_back(point);
+	}
+
+	if (placed != tweak::world::MaxPlayers)
+		throw GameException("Level is too small to place all bases far enough apart");
 }
 
+/* Kruskal over the pairs closer than a radius that doubles until the tree is connected. Each round only adds
+ * pairs longer than the last radius, so pairs are still taken shortest first and the tree is the same as with
+ * all pairs sorted at once. */
 static void generate_tree(Level *lvl) {
 	auto perf = MeasureFunction<2>{ __FUNCTION__ };
 
-	int *dsets, paircount;
-	int i, j;
-	int k;
-	Position *points;
-	Pairing *pairs;
-	
-	/* Get an array of disjoint set IDs: */
-	dsets = static_cast<int*>(get_mem( sizeof(int) * ToastParams::TreeSize ));
-	for(i=0; i< ToastParams::TreeSize; i++) 
-		dsets[i] = i;
-	
 	/* Randomly generate all points: */
-	points = static_cast<Position*>(get_mem( sizeof(Position) * ToastParams::TreeSize ));
-	for(i=0; i< ToastParams::TreeSize; i++)
-		points[i] = generate_inside(lvl->GetSize(), ToastParams::BorderWidth);
-	
+	std::vector<Position> points(ToastParams::TreeSize);
+	for (Position & point : points)
+		point = generate_inside(lvl->GetSize(), ToastParams::BorderWidth);
+
 	/* While we're here, copy in some of those points: */
-	lvl->SetSpawn(0, points[0]);
-	for(i=1,j=1; i< ToastParams::TreeSize && j< tweak::world::MaxPlayers; i++) {
-		for(k=0; k<j; k++) {
-            if (pt_dist(points[i], lvl->GetSpawn(TankColor(k))->GetPosition()) <
-                tweak::base::MinDistance * tweak::base::MinDistance)
-				break;
-		}
-		
-		if(k!=j) continue;
-		lvl->SetSpawn(TankColor(j++), points[i]);
-	}
-	if(j!= tweak::world::MaxPlayers) {
-		/* TODO: More robust error handling. */
-		gamelib_error("OH SHUCKS OH SHUCKS OH SHUCKS\n");
-		exit(1);
-	}
-	/* Get an array of all point-point pairings: */
-	paircount = ToastParams::TreeSize*(ToastParams::TreeSize-1) / 2;
-	pairs = static_cast<Pairing*>(get_mem( sizeof(Pairing) * (paircount) ));
-
-	/* Set up all the pairs, and sort them: */
-	for(k=i=0; i< ToastParams::TreeSize; i++)
-		for(j=i+1; j< ToastParams::TreeSize; j++, k++) {
-			pairs[k].a = i; pairs[k].b = j;
-			pairs[k].dist = pt_dist(points[i], points[j]);
+	place_spawns(lvl, points);
+
+	/* Start around the average spacing of the points */
+	int radius = std::max(1, int(std::sqrt(double(lvl->GetSize().x) * lvl->GetSize().y / points.size())));
+	std::int64_t last_dist = -1;
+	DisjointSets dsets(int(points.size()));
+	int edges = 0;
+	std::vector<Pairing> pairs;
+	while (edges < int(points.size()) - 1) {
+		std::int64_t max_dist = std::int64_t(radius) * radius;
+		PointGrid grid(points, lvl->GetSize(), radius);
+
+		pairs.clear();
+		for (int i = 0; i < int(points.size()); ++i)
+			grid.ForEachNear(points[i], [&](int j) {
+				std::int64_t dist = point_dist(points[i], points[j]);
+				if (j > i && dist > last_dist && dist <= max_dist)
+					pairs.push_back(Pairing{ dist, i, j });
+			});
+		std::sort(pairs.begin(), pairs.end());
+
+		for (const Pairing & pair : pairs) {
+			/* Trees only have |n|-1 edges, so call it quits if we've selected that many: */
+			if (edges >= int(points.size()) - 1) break;
+			/* Points in different disjoint sets. "Join" them by drawing them, and merging the two sets: */
+			if (!dsets.Join(pair.a, pair.b)) continue;
+			++edges;
+			draw_line(lvl, points[pair.a], points[pair.b], LevelPixel::LevelGenDirt, 0);
 		}
-	qsort(pairs, paircount, sizeof(Pairing), pairing_cmp);
-	for(i=j=0; i<paircount; i++) {
-		int aset, bset;
-		
-		/* Trees only have |n|-1 edges, so call it quits if we've selected that
-		 * many: */
-		if(j>= ToastParams::TreeSize-1) break;
-		
-		aset = dsets[pairs[i].a]; bset = dsets[pairs[i].b];
-		if(aset == bset) continue;
-		
-		/* Else, these points are in different disjoint sets. "Join" them by
-		 * drawing them, and merging the two sets: */
-		j+=1;
-		for(k=0; k< ToastParams::TreeSize; k++)
-			if(dsets[k] == bset) 
-				dsets[k] = aset;
-		draw_line(lvl, points[pairs[i].a], points[pairs[i].b], LevelPixel::LevelGenDirt, 0);
+
+		last_dist = max_dist;
+		radius *= 2;
 	}
-	
-	/* We don't need this data anymore: */
-	free_mem(pairs);
-	free_mem(points);
-	free_mem(dsets);
 }
 
 
@@ -138,15 +197,15 @@ static void generate_tree(Level *lvl) {
 //
 //
 // Much less instructions. Optimizer cannot see it through and fold it :(
-static int has_neighbor(Level* lvl, int x, int y) {
-	if (lvl->GetVoxelRaw(( x - 1 + lvl->GetSize().x * (y - 1) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x     + lvl->GetSize().x * (y - 1) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x + 1 + lvl->GetSize().x * (y - 1) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x - 1 + lvl->GetSize().x * (y    ) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x + 1 + lvl->GetSize().x * (y    ) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x - 1 + lvl->GetSize().x * (y + 1) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x     + lvl->GetSize().x * (y + 1) )) == LevelPixel::LevelGenDirt) return 1;
-	if (lvl->GetVoxelRaw(( x + 1 + lvl->GetSize().x * (y + 1) )) == LevelPixel::LevelGenDirt) return 1;
+static int has_neighbor(const LevelRowNeighborhood & rows, int x) {
+	if (rows.above[x - 1] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.above[x    ] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.above[x + 1] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.row  [x - 1] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.row  [x + 1] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.below[x - 1] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.below[x    ] == LevelPixel::LevelGenDirt) return 1;
+	if (rows.below[x + 1] == LevelPixel::LevelGenDirt) return 1;
 	return 0;
 }
 
@@ -161,242 +220,243 @@ static void set_outside(Level *lvl, LevelPixel val) {
 	for (i = 1; i < size.y-1; i++) lvl->SetVoxelRaw({ size.x - 1, i }, val);
 }
 
-static void expand_init(Level *lvl, PositionQueue& q) {
-	auto perf = MeasureFunction<3>{ __FUNCTION__ };
-	for(int y = 1; y<lvl->GetSize().y-1; y++)
-		for (int x = 1; x < lvl->GetSize().x - 1; x++) {
-			int offset = x + y * lvl->GetSize().x;
-			if (lvl->GetVoxelRaw(offset) != LevelPixel::LevelGenDirt  && has_neighbor(lvl, x, y)) {
-				lvl->SetVoxelRaw(offset, LevelPixel::LevelGenMark);
-				q.push({ x, y });
-			}
-		}
+/* Candidates closer to the edge of the level are less likely to turn to dirt */
+static int expand_odds(Size size, Position pos) {
+	int xodds = ToastParams::MaxDirtSpawnOdds * std::min(size.x - pos.x, pos.x) / ToastParams::DirtSpawnProgression;
+	int yodds = ToastParams::MaxDirtSpawnOdds * std::min(size.y - pos.y, pos.y) / ToastParams::DirtSpawnProgression;
+	return std::min(std::min(xodds, yodds), ToastParams::MaxDirtSpawnOdds);
 }
 
+/*
+ * Dirt grows out of the tree in passes over square tiles of ExpandTileSize pixels.
+ *  Every tile owns its pixels and its queue of candidates. A candidate falling into another tile goes to the inbox
+ *  of that tile and its owner checks it at the start of its next pass, so no tile ever touches pixels of another.
+ *  A tile runs pass p as soon as it and the tiles around it finished pass p - 1, there is no barrier across the
+ *  level. Each tile draws from its own random stream keyed by the seed, the pass and the tile, so the level
+ *  depends on the seed only, not on the number of threads.
+ *  Expansion ends with the first pass that reaches the goal, which is known only after all tiles finished it.
+ *  Tiles may run up to ExpandLookahead passes ahead of that, remember what they overwrote, and undo the passes
+ *  past the end.
+ */
+class TileExpansion {
+	static constexpr int Ring = ToastParams::ExpandLookahead + 1; /* Passes counted at the same time */
+	static constexpr int NoPass = std::numeric_limits<int>::max();
+
+	/* Dirt written in a pass, every such pixel was marked rock before */
+	struct UndoPass {
+		int pass;
+		std::vector<Position> writes;
+	};
+	struct Tile {
+		Rect rect;
+		std::array<int, 9> around; /* Index of the tile in each direction, (dy + 1) * 3 + dx + 1, -1 past the level */
+		int around_count = 0; /* Itself included */
+		int pass = 0; /* Next pass to run */
+		std::vector<Position> queue; /* Candidates for the next pass */
+		std::vector<Position> next;
+		std::array<std::array<std::vector<Position>, 9>, 2> inbox; /* [pass % 2][direction of the sender] */
+		std::array<int, 2> waiting = {}; /* Tiles around yet to finish the pass before, [pass % 2] */
+		std::deque<UndoPass> undo;
+	};
 
-struct ExpandResult {
-	int dirt_generated = 0;
-	int rocks_marked = 0;
-};
-	
+	/* Runs the next pass of one tile */
+	struct RunTask {
+		TileExpansion * self;
+		void operator()(int tile, ThreadLocal *) const { self->RunPass(tile); }
+	};
 
-ExpandResult expand_once(Level *lvl, circular_buffer_adaptor<Position>& q, RandomGenerator random) {
+	Level * lvl;
+	ThreadPool & pool;
+	std::uint64_t seed;
+	std::int64_t goal;
+	Size tile_counts;
+	std::vector<Tile> tiles;
+	RunTask run_task = {this};
+	TaskGroup group;
+
+	std::mutex mutex; /* Guards the scheduling below and Tile::waiting */
+	std::atomic<int> confirmed = -1; /* Last pass all tiles finished */
+	std::atomic<int> final_pass = NoPass; /* First pass not to keep */
+	std::int64_t generated = 0;
+	int idle_passes = 0;
+	std::array<int, Ring> pass_done = {};
+	std::array<std::int64_t, Ring> pass_dirt = {};
+	std::vector<int> parked; /* Tiles ready to run, but too far ahead of the confirmed pass */
+
+public:
+	TileExpansion(Level *lvl, ThreadPool & pool)
+		: lvl(lvl), pool(pool), seed(std::uint64_t(ThreadRandom().Int(0, std::numeric_limits<int>::max()))),
+		  goal(ToastParams::TargetDirtAmount(lvl)) {
+		constexpr int tile_size = ToastParams::ExpandTileSize;
+		Size size = lvl->GetSize();
+		tile_counts = { (size.x + tile_size - 1) / tile_size, (size.y + tile_size - 1) / tile_size };
+		tiles.resize(std::size_t(tile_counts.x) * tile_counts.y);
+		for (int ty = 0; ty < tile_counts.y; ++ty)
+			for (int tx = 0; tx < tile_counts.x; ++tx) {
+				Tile & tile = tiles[std::size_t(ty) * tile_counts.x + tx];
+				tile.rect = Rect{ tx * tile_size, ty * tile_size, std::min(tile_size, size.x - tx * tile_size),
+				                  std::min(tile_size, size.y - ty * tile_size) };
+				for (int dir = 0; dir < 9; ++dir) {
+					int x = tx + dir % 3 - 1, y = ty + dir / 3 - 1;
+					bool is_inside = x >= 0 && y >= 0 && x < tile_counts.x && y < tile_counts.y;
+					tile.around[dir] = is_inside ? y * tile_counts.x + x : -1;
+					tile.around_count += is_inside;
+				}
+				tile.waiting = { tile.around_count, tile.around_count };
+			}
+	}
 
-	//for (int i = 0; i < q.size() * 1000; ++i) {
-	//	if (i % 10000 == 1)
-	//		++count;
-	//}
-	//return count;
-	
-	ExpandResult result = {};
-	size_t total = q.size();
-	for(size_t i=0; i<total; i++) {
-		int xodds, yodds, odds;
-		
-		Position temp;
-		q.pop(temp);
-
-		/* Odds based on proximity to edge of level */
-		xodds = ToastParams::MaxDirtSpawnOdds * std::min(lvl->GetSize().x - temp.x, temp.x) / ToastParams::DirtSpawnProgression;
-		yodds = ToastParams::MaxDirtSpawnOdds * std::min(lvl->GetSize().y - temp.y, temp.y) / ToastParams::DirtSpawnProgression;
-		odds  = std::min(std::min(xodds, yodds), ToastParams::MaxDirtSpawnOdds);
-		
-		if(random.Bool(odds)) {
-			lvl->SetVoxelRaw(temp, LevelPixel::LevelGenDirt);
-			++result.dirt_generated;
-			
-			/* Now, queue up any neighbors that qualify: */
-			for(int j=0; j<9; j++) {
-				if(j==4) continue;
-				
-				int tx = temp.x + (j % 3) - 1;
-				int ty = temp.y + (j / 3) - 1;
-				LevelPixel v = lvl->GetVoxelRaw({ tx, ty });
-				if(v == LevelPixel::LevelGenRock) {
-				   // v  = LevelPixel::LevelGenMark; // this is never read
-				   ++result.rocks_marked;
-					q.push({ tx, ty });
+	/* Marks the rock next to the tree and queues it in the tile it falls into */
+	void Init() {
+		auto perf = MeasureFunction<3>{ __FUNCTION__ };
+		const int width = lvl->GetSize().x;
+		lvl->ForEachRowNeighborhood([this, width](const LevelRowNeighborhood & rows) {
+			for (int x = 1; x < width - 1; x++) {
+				if (rows.row[x] != LevelPixel::LevelGenDirt && has_neighbor(rows, x)) {
+					rows.row[x] = LevelPixel::LevelGenMark;
+					tiles[TileOf({ x, rows.y })].queue.push_back({ x, rows.y });
 				}
 			}
-		} else
-			q.push(temp);
+		}, 1, lvl->GetSize().y - 2);
 	}
-	return result;
-}
 
-static void expand_process(Level* lvl, PositionQueue& q) {
-	auto measure_function = MeasureFunction<3>{ __FUNCTION__ };
-	/* Want to generate at least goal_generated */
-	const int goal_generated = ToastParams::TargetDirtAmount(lvl);
-	std::atomic<int> items_generated_global = 0;
-
-	/* Prepare worker pool */
-	const int worker_count = tweak::perf::parallelism_degree;
-	auto workerQueues = std::vector<circular_buffer_adaptor<Position>>(); 	/* TODO: circular buffer can overflow */
-	for (int i = 0; i < worker_count; ++i) {
-		workerQueues.emplace_back(50000 / worker_count /* Queue constructor */ );
+	void Process() {
+		auto perf = MeasureFunction<3>{ __FUNCTION__ };
+		pool.Submit(group, int(tiles.size()), run_task);
+		pool.Wait(group);
+
+		/* Take back the passes run past the end */
+		int undone = 0;
+		for (Tile & tile : tiles)
+			for (auto it = tile.undo.rbegin(); it != tile.undo.rend() && it->pass >= final_pass; ++it)
+				for (Position pos : it->writes) {
+					lvl->SetVoxelRaw(pos, LevelPixel::LevelGenMark);
+					++undone;
+				}
+
+		if (generated < goal)
+			gamelib_print("Did generate only %lld items out of %lld", (long long)generated, (long long)goal);
+		DebugTrace<4>("  expand_process: %d passes over %d tiles, %d pixels undone \n", final_pass.load(),
+			int(tiles.size()), undone);
 	}
 
-	/* TODO: Split per position quadrants */
-	/* Split into one queue per worker. This is relatively cheap. */
-	int worker = 0;
-	auto measure_queue_expand = MeasureFunction<4>{ "expand_process: prepare per-worker queues" };
-	
-	assert( worker_count > 0 ); // to avoid division (modulo actually) by zero
-	
-	while (q.size()) {
-		Position pos;
-		q.pop(pos);
-		workerQueues[worker].push(pos);
-		worker = (worker + 1) % worker_count;
+private:
+	int TileOf(Position pos) const {
+		constexpr int tile_size = ToastParams::ExpandTileSize;
+		return (pos.y / tile_size) * tile_counts.x + pos.x / tile_size;
+	}
+
+	/* Marked rock is queued already. Marks are not undone, expand_cleanup turns them back to rock. */
+	void Queue(std::vector<Position> & queue, Position pos) {
+		if (lvl->GetVoxelRaw(pos) != LevelPixel::LevelGenRock)
+			return;
+		lvl->SetVoxelRaw(pos, LevelPixel::LevelGenMark);
+		queue.push_back(pos);
 	}
-	measure_queue_expand.Finish();
-
-	/* Set up threading controls */
-	std::mutex mutex_threads_waiting;
-	std::condition_variable cv_threads_waiting;
-	int threads_waiting = 0;
-	std::condition_variable cv_continue_thread;
-	std::atomic<bool> done = false;
-	int reached_pass = -1; /* Current maximum iteration threads have reached */
-	int max_pass = 0; /* Current maximum iteration threads should process */
-
-	/* Performance statistics */
-	std::atomic<int> waits_main = 0;
-	std::atomic<int> threads_notify = 0;
-	std::atomic<int> waits_continue = 0;
-	std::atomic<std::int64_t> expand_pure_time_ms = 0;
-
-	auto expand_loop = [&](circular_buffer_adaptor<Position>* qq, RandomGenerator random) {
-
-		Stopwatch perf_thread_time;
-		Stopwatch perf_wait_time;
-
-		int curr_pass = 0;
-		int dirt_generated = 0;
-		int rocks_marked = 0;
-		bool no_more_work = false;
-		while (!done && !no_more_work) {
-			{	/* Signal thread is entering work state */
-				std::unique_lock lock(mutex_threads_waiting);
-				--threads_waiting;
-				reached_pass = std::max(reached_pass, curr_pass);
-				cv_threads_waiting.notify_all();
-				threads_notify.fetch_add(1, std::memory_order_relaxed);
-			}
 
-			perf_wait_time.Stop();
+	void RunPass(int index) {
+		Tile & tile = tiles[index];
+		const int pass = tile.pass;
+		if (pass >= final_pass.load(std::memory_order_relaxed))
+			return;
+		while (!tile.undo.empty() && tile.undo.front().pass <= confirmed.load(std::memory_order_relaxed))
+			tile.undo.pop_front();
+
+		/* Candidates the tiles around found in their last pass */
+		for (std::vector<Position> & from : tile.inbox[(pass + 1) % 2]) {
+			for (Position pos : from)
+				Queue(tile.queue, pos);
+			from.clear();
+		}
 
-			/* Call the function doing actual work */
-			Stopwatch expand_time;
-			ExpandResult result = expand_once(lvl, *qq, random);
-			if (!result.dirt_generated) {
-				//no_more_work = true;  /* Do we want to quit early? */
-			}
-			dirt_generated += result.dirt_generated;
-			rocks_marked += result.rocks_marked;
-			items_generated_global.fetch_add(result.dirt_generated, std::memory_order_relaxed);
-			expand_pure_time_ms.fetch_add(expand_time.GetElapsed().count(), std::memory_order_relaxed);
-
-			perf_wait_time.Start();
-
-			/* Early exit if enough results were generates */
-			if (items_generated_global >= goal_generated) {
-				done = true;
-				cv_threads_waiting.notify_all();
-				threads_notify.fetch_add(1, std::memory_order_relaxed);
+		const Size size = lvl->GetSize();
+		StreamRandom random{ StreamRandom::Mix(seed + std::uint64_t(pass)), std::uint64_t(index) };
+		std::vector<Position> & undo = tile.undo.emplace_back(UndoPass{ pass, {} }).writes;
+		std::int64_t dirt = 0;
+		tile.next.clear();
+		for (Position pos : tile.queue) {
+			if (!random.Bool(expand_odds(size, pos))) {
+				tile.next.push_back(pos);
+				continue;
 			}
+			undo.push_back(pos);
+			lvl->SetVoxelRaw(pos, LevelPixel::LevelGenDirt);
+			++dirt;
 
-			{	/* Signal thread is leaving work state */
-				std::unique_lock lock(mutex_threads_waiting);
-				++threads_waiting;
-				cv_threads_waiting.notify_all();
-				threads_notify.fetch_add(1, std::memory_order_relaxed);
-				while (curr_pass >= max_pass) {
-					/* Wait if not allowed to do next pass yet */
-					cv_continue_thread.wait(lock);
-					waits_continue.fetch_add(1, std::memory_order_relaxed);
+			/* Now, queue up any neighbors that qualify: */
+			for (int j = 0; j < 9; j++) {
+				if (j == 4) continue;
+				Position near = { pos.x + (j % 3) - 1, pos.y + (j / 3) - 1 };
+				if (tile.rect.IsInside(near)) {
+					Queue(tile.next, near);
+					continue;
 				}
+				int dx = near.x < tile.rect.Left() ? 0 : near.x > tile.rect.Right() ? 2 : 1;
+				int dy = near.y < tile.rect.Top() ? 0 : near.y > tile.rect.Bottom() ? 2 : 1;
+				int dir = dy * 3 + dx;
+				assert(tile.around[dir] >= 0);
+				tiles[tile.around[dir]].inbox[pass % 2][8 - dir].push_back(near);
 			}
-			++curr_pass;
 		}
-		auto elapsed = perf_thread_time.GetElapsed();
-		auto waited = perf_wait_time.GetElapsed();
-
-		DebugTrace<5>("thread took: %lld.%03lldms (%lld.%03lldms wait time) to add %d dirt and mark %d voxels \r\n",
-			elapsed.count() / 1000, elapsed.count() % 1000, waited.count() / 1000, waited.count() % 1000, dirt_generated, rocks_marked);
-	};
-
-	Stopwatch time_thread_create;
+		std::swap(tile.queue, tile.next);
+		FinishPass(index, pass, dirt);
+	}
 
-	/* Launch workers on their own queues */
-	threads_waiting = worker_count;
-	auto workers = std::vector<std::future<void>>();
-	for (int i = 0; i < worker_count; ++i) {
-		workers.push_back(std::async(std::launch::async, expand_loop, &workerQueues[i], Random));
+	void FinishPass(int index, int pass, std::int64_t dirt) {
+		std::unique_lock lock(mutex);
+		pass_dirt[pass % Ring] += dirt;
+		++pass_done[pass % Ring];
+		const int was_confirmed = confirmed;
+		ConfirmPasses();
+
+		/* Tiles around may be ready for the next pass now */
+		for (int near : tiles[index].around) {
+			if (near < 0 || --tiles[near].waiting[(pass + 1) % 2])
+				continue;
+			tiles[near].waiting[(pass + 1) % 2] = tiles[near].around_count;
+			tiles[near].pass = pass + 1;
+			Schedule(near);
+		}
+		if (confirmed != was_confirmed)
+			for (int tile : std::exchange(parked, {}))
+				Schedule(tile);
 	}
 
-	time_thread_create.Stop();
-	Stopwatch time_workers;
-
-	int prev_items_generated_global = 0;
-	while (!done && items_generated_global < goal_generated) {
-		{
-			/* Wait for all threads being done and waiting for next pass */
-			std::unique_lock lock(mutex_threads_waiting);
-			while (!done && 
-					(threads_waiting != worker_count || /* Already started new passes */
-					(max_pass != reached_pass))) { /* All are still waiting for start */
-				waits_main.fetch_add(1, std::memory_order_relaxed);
-				cv_threads_waiting.wait(lock);
-			}
-			/* Signal exit if we got enough */
-			if (items_generated_global >= goal_generated || prev_items_generated_global == items_generated_global) {
-				done = true;
-			}
-			/* Advance pass boundary, resume thread */
-			max_pass = reached_pass + 100; /* TODO: desynchronized passes */
-			cv_continue_thread.notify_all();
-            prev_items_generated_global = items_generated_global;
+	/* Moves the confirmed pass up as long as all tiles finished the next one, ends the expansion on the first pass
+	 * reaching the goal or after ExpandIdlePasses passes without any new dirt */
+	void ConfirmPasses() {
+		while (final_pass == NoPass && pass_done[(confirmed + 1) % Ring] == int(tiles.size())) {
+			int slot = (confirmed + 1) % Ring;
+			generated += pass_dirt[slot];
+			idle_passes = pass_dirt[slot] ? 0 : idle_passes + 1;
+			pass_done[slot] = 0;
+			pass_dirt[slot] = 0;
+			++confirmed;
+			if (generated >= goal || idle_passes >= ToastParams::ExpandIdlePasses)
+				final_pass = confirmed + 1;
 		}
 	}
-	time_workers.Stop();
-	Stopwatch time_join;
-	/* Wait for threads to end cleanly */
-	for (int i = 0; i < worker_count; ++i) {
-		workers[i].get();
+
+	void Schedule(int tile) {
+		if (final_pass != NoPass)
+			return;
+		if (tiles[tile].pass > confirmed + ToastParams::ExpandLookahead)
+			parked.push_back(tile);
+		else
+			pool.SubmitOne(group, tile, run_task);
 	}
-	time_join.Stop();
-	measure_function.Finish();
-
-	if (prev_items_generated_global < goal_generated)
-        gamelib_print("Did generate only %d items out of %d", prev_items_generated_global,
-                      items_generated_global.load());
-
-	/* Emit diag info */
-	DebugTrace<4>("  expand_process details: %lld.%03lld ms thread create, %lld.%03lld ms thread run, %lld.%03lld ms thread join, %d.%03d ms worker time (%u us per thread) \n",
-		time_thread_create.GetElapsed().count() / 1000, time_thread_create.GetElapsed().count() % 1000,
-		time_workers.GetElapsed().count() / 1000, time_workers.GetElapsed().count() % 1000,
-		time_join.GetElapsed().count() / 1000, time_join.GetElapsed().count() % 1000,
-		expand_pure_time_ms.load() / 1000, expand_pure_time_ms.load() % 1000,
-		expand_pure_time_ms.load() / worker_count);
-	DebugTrace<4>("waits_continue: %d waits_main: %d threads_notify: %d \r\n", waits_continue.load(), waits_main.load(), threads_notify.load());
-}
+};
 
 static void expand_cleanup(Level *lvl) {
 	auto perf = MeasureFunction<3>{ __FUNCTION__ };
 	unmark_all(lvl);
 }
 
-static void randomly_expand(Level *lvl) {
+static void randomly_expand(Level *lvl, ThreadPool & pool) {
 	auto perf = MeasureFunction<2>{ __FUNCTION__ };
-	/* Experimentally, the queue never grew to larger than 3/50ths of the level
-	 * size, so we can use that to save quite a bit of memory: */
-	auto queue = PositionQueue(50000);
-	//queue.resize(lvl->GetSize().x * lvl->GetSize().y * 3 / 50);
-	
-	expand_init(lvl, queue);
-	expand_process(lvl, queue);
+	TileExpansion expansion(lvl, pool);
+	expansion.Init();
+	expansion.Process();
 	expand_cleanup(lvl);
 }
 
@@ -405,46 +465,119 @@ static void randomly_expand(Level *lvl) {
  * STAGE 3: Smooth out the graph with a cellular automaton                    *
  *----------------------------------------------------------------------------*/
 	
-static int smooth_once(Level *lvl) {
+/*
+ * Rock of the level as one bit per pixel, rows padded to whole words.
+ *  There are two copies: a pass reads one and writes the other, so no row sees its neighbors half updated and the
+ *  result does not depend on how the rows are split between workers. Neighbor sums are counted for 64 pixels at
+ *  once with BitSlicedCounter.
+ */
+class SmoothingBits {
+	using Word = LevelBitPlanes::Word;
+	static constexpr int WordBits = LevelBitPlanes::WordBits;
+
+	Size size;
+	int words_per_row;
+	std::array<std::vector<Word>, 2> bits;
+	int current = 0;
+
+public:
+	explicit SmoothingBits(Level *lvl)
+		: size(lvl->GetSize()), words_per_row((size.x + WordBits - 1) / WordBits) {
+		for (std::vector<Word> & copy : bits)
+			copy.resize(std::size_t(words_per_row) * size.y);
+		lvl->ForEachRowParallel([this](int y, LevelPixel * row, ThreadLocal *) {
+			Word * out = Row(current, y);
+			for (int x = 0; x < size.x; ++x)
+				out[x / WordBits] |= Word{ row[x] != LevelPixel::LevelGenDirt } << (x % WordBits);
+			return 0;
+		});
+	}
 
-	/* Smooth surfaces. Require at least 3 neighbors to keep alive. Spawn new at 5 neighbors. */
-	auto smooth_step = [lvl](int from_y, int until_y, ThreadLocal*) {
-		Stopwatch time_step;
-		int count = 0;
-		Size size = lvl->GetSize();
-		for (int y = from_y; y <= until_y; y++)
-			for (int x = 1; x < size.x - 1; x++) {
-                LevelPixel oldbit = lvl->GetVoxelRaw({ x, y });
+	/* Writes the bits back as LevelGenRock and LevelGenDirt */
+	void Store(Level *lvl) const {
+		lvl->ForEachRowParallel([this](int y, LevelPixel * row, ThreadLocal *) {
+			const Word * in = Row(current, y);
+			for (int x = 0; x < size.x; ++x)
+				row[x] = ((in[x / WordBits] >> (x % WordBits)) & 1) ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt;
+			return 0;
+		});
+	}
 
-				int n = Queries::CountNeighborValues({x, y}, lvl);
-				bool paintRock = (oldbit != LevelPixel::LevelGenDirt) ? (n >= 3) : (n > 4);
-				lvl->SetVoxelRaw({ x, y }, paintRock ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt);
+	/* One pass over everything but the outermost pixels. Returns the number of pixels that changed. */
+	int Step() {
+		const int next = current ^ 1;
+		std::copy_n(Row(current, 0), words_per_row, Row(next, 0));
+		std::copy_n(Row(current, size.y - 1), words_per_row, Row(next, size.y - 1));
+
+		int count = parallel_for([this, next](int from_y, int until_y, ThreadLocal *) {
+			int changed = 0;
+			for (int y = from_y; y <= until_y; ++y)
+				changed += StepRow(Row(current, y - 1), Row(current, y), Row(current, y + 1), Row(next, y));
+			return changed;
+		}, 1, size.y - 2, WorkerDivisor{4});
+		current = next;
+		return count;
+	}
 
-				count += lvl->GetVoxelRaw({ x, y }) != oldbit;
-			}
+private:
+	Word * Row(int copy, int y) { return &bits[copy][std::size_t(y) * words_per_row]; }
+	const Word * Row(int copy, int y) const { return &bits[copy][std::size_t(y) * words_per_row]; }
 
-		time_step.Stop();
-		DebugTrace<5>("    smooth_step thread took %lld.%03lld ms \n",
-			time_step.GetElapsed().count() / 1000, time_step.GetElapsed().count() % 1000);
-		return count;
-	};
+	/* Pixels x - 1 and x + 1 of the word at bit x, zero past the row */
+	void ShiftedWords(const Word * row, int word, Word & left, Word & right) const {
+		left = (row[word] << 1) | (word > 0 ? row[word - 1] >> (WordBits - 1) : 0);
+		right = (row[word] >> 1) | (word + 1 < words_per_row ? row[word + 1] << (WordBits - 1) : 0);
+	}
 
-	Stopwatch time_whole;
-	int count = parallel_for(smooth_step, 1, lvl->GetSize().y - 2, WorkerDivisor{4});
-	
-	time_whole.Stop();
-	DebugTrace<4>("  smooth_once total took %lld.%03lld ms \n",
-		time_whole.GetElapsed().count() / 1000, time_whole.GetElapsed().count() % 1000);
+	/* Same rule as before: rock stays with at least 3 rock neighbors, dirt turns to rock with at least 5.
+	 * The first and last pixel of the row keep their value. */
+	int StepRow(const Word * above, const Word * row, const Word * below, Word * out) const {
+		int changed = 0;
+		for (int word = 0; word < words_per_row; ++word) {
+			BitSlicedCounter rock;
+			Word left, right;
+			ShiftedWords(above, word, left, right);
+			rock.Add(left); rock.Add(above[word]); rock.Add(right);
+			ShiftedWords(row, word, left, right);
+			rock.Add(left); rock.Add(right);
+			ShiftedWords(below, word, left, right);
+			rock.Add(left); rock.Add(below[word]); rock.Add(right);
+
+			Word kept = KeptBits(word);
+			Word value = (row[word] & rock.AtLeast3()) | (~row[word] & rock.AtLeast5());
+			value = (value & ~kept) | (row[word] & kept);
+			out[word] = value;
+			changed += std::popcount(value ^ row[word]);
+		}
+		return changed;
+	}
 
-	return count;
-}
+	/* Bits of the word that are not smoothed: the first and last pixel of the row, and the padding past it */
+	Word KeptBits(int word) const {
+		Word kept = 0;
+		const int first = word * WordBits;
+		if (first == 0)
+			kept |= 1;
+		for (int x = std::max(first, size.x - 1); x < first + WordBits; ++x)
+			kept |= Word{ 1 } << (x - first);
+		return kept;
+	}
+};
 
 static void smooth_cavern(Level *lvl) {
 	auto perf = MeasureFunction<2>{ __FUNCTION__ };
 
 	set_outside(lvl, LevelPixel::LevelGenDirt);
+	SmoothingBits bits(lvl);
 	auto steps_remain = ToastParams::SmoothingSteps;
-	while(smooth_once(lvl) && --steps_remain != 0);
+	int steps = 1;
+	Stopwatch time_steps;
+	while (bits.Step() && --steps_remain != 0)
+		++steps;
+	time_steps.Stop();
+	DebugTrace<4>("  smooth_cavern: %d steps took %lld.%03lld ms \n", steps,
+		time_steps.GetElapsed().count() / 1000, time_steps.GetElapsed().count() % 1000);
+	bits.Store(lvl);
 	set_outside(lvl, LevelPixel::LevelGenRock);
 }
 
@@ -453,16 +586,17 @@ static void smooth_cavern(Level *lvl) {
  * MAIN FUNCTIONS:                                                            *
  *----------------------------------------------------------------------------*/
 
-std::unique_ptr<Level> ToastLevelGenerator::Generate(Size size)
+std::unique_ptr<Level> ToastLevelGenerator::Generate(Size size, GenerationStages & stages)
 {
     std::unique_ptr<Level> level = std::make_unique<Level>(size);
     Level * lvl = level.get();
 
 	auto perf = MeasureFunction<1>{ __FUNCTION__ };
 
-	generate_tree(lvl);
-	randomly_expand(lvl);
-	smooth_cavern(lvl);
+	TimeStage(stages, "generate_tree", [lvl]() { generate_tree(lvl); });
+	ThreadPool & expand_pool = this->pool ? *this->pool : ThreadPool::Get();
+	TimeStage(stages, "randomly_expand", [lvl, &expand_pool]() { randomly_expand(lvl, expand_pool); });
+	TimeStage(stages, "smooth_cavern", [lvl]() { smooth_cavern(lvl); });
 
 	return level;
 }
@@ -487,7 +621,7 @@ int main() {
 	TIMER_STOP(t);
 	
 	TIMER_START(t);
-	randomly_expand(&lvl);
+	randomly_expand(&lvl, ThreadPool::Get());
 	TIMER_STOP(t);
 	
 	TIMER_START(t);
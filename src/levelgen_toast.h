@@ -1,6 +1,8 @@
 #pragma once
 #include <level.h>
 
+class ThreadPool;
+
 namespace levelgen::toast
 {
 
@@ -9,8 +11,12 @@ struct ToastParams
     constexpr static int BorderWidth = 30;
     constexpr static int MaxDirtSpawnOdds = 300; /* Maximum chance (out of 1000) to spawn a dirt tile */
     constexpr static int DirtSpawnProgression =  70; /* How much more likely it is to spawn at center compared to edges (formula = distance * MaxDirtSpawnOdds / MaxDirtSpawnOdds)    */
-    constexpr static int DirtTargetPercent = 65; /* Target percentage of dirt in level */
+    constexpr static int DirtTargetPercent = 36; /* Target percentage of dirt in level before smoothing */
     constexpr static int TreeSize = 150;
+    constexpr static int SpawnAttempts = 10000; /* Random points tried for bases when the tree points are too close */
+    constexpr static int ExpandTileSize = 128; /* Expansion works on square tiles this big, the level depends on it */
+    constexpr static int ExpandLookahead = 16; /* How many passes a tile can run ahead of the slowest one */
+    constexpr static int ExpandIdlePasses = 100; /* Expansion gives up after this many passes without new dirt */
     constexpr static int SmoothingSteps = -1; /* How many iterations of smoothing edges. -1 = smooth completely.  */
 
     static int TargetDirtAmount(Level * lvl) { return lvl->GetSize().x * lvl->GetSize().y * DirtTargetPercent / 100; };
@@ -18,8 +24,12 @@ struct ToastParams
 
 class ToastLevelGenerator : public GeneratorAlgorithm
 {
+    ThreadPool * pool;
+
   public:
-    std::unique_ptr<Level> Generate(Size size) override;
+    /* Expands the tree on the given pool, on ThreadPool::Get() when null */
+    explicit ToastLevelGenerator(ThreadPool * pool = nullptr) : pool(pool) {}
+    std::unique_ptr<Level> Generate(Size size, GenerationStages & stages) override;
 };
 
 } // namespace levelgen::toast
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdlib>
 
 #include <levelgenutil.h>
@@ -7,58 +8,63 @@
 
 void fill_all(Level *lvl, LevelPixel c)
 {
-	lvl->ForEachVoxel([c](SafePixelAccessor pixel) { pixel.Set(c); });
+	lvl->FillShape(RectShape{Rect{Position{0, 0}, lvl->GetSize()}}, c);
 }
 void invert_all(Level* lvl)
 {
-    lvl->ForEachVoxel([](SafePixelAccessor pixel)
+	lvl->ForEachRowParallel([lvl](int, LevelPixel * row, ThreadLocal *)
 	{
-        pixel.Set((pixel.Get() == LevelPixel::LevelGenRock) ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock);
+		for (int x = 0; x < lvl->GetSize().x; ++x)
+			row[x] = (row[x] == LevelPixel::LevelGenRock) ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock;
+		return 0;
 	});
 }
 void unmark_all(Level* lvl)
 {
-    lvl->ForEachVoxel([](SafePixelAccessor pixel)
+	lvl->ForEachRowParallel([lvl](int, LevelPixel * row, ThreadLocal *)
 	{
-		pixel.Set((pixel.Get() == LevelPixel::LevelGenDirt) ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock);
+		for (int x = 0; x < lvl->GetSize().x; ++x)
+			row[x] = (row[x] == LevelPixel::LevelGenDirt) ? LevelPixel::LevelGenDirt : LevelPixel::LevelGenRock;
+		return 0;
 	});
 }
 
 
 void rough_up(Level *lvl) {
-	int x, y;
-	
 	/* Sanitize our input: */
 	unmark_all(lvl);
 	
 	/* Mark all spots that are blank, but next to spots that are marked: */
-	for(x=0; x<lvl->GetSize().x; x++) {
-		for(y=0; y<lvl->GetSize().y; y++) {
+	const int width = lvl->GetSize().x;
+	lvl->ForEachRowNeighborhood([width](const LevelRowNeighborhood & rows)
+	{
+		for (int x = 0; x < width; x++) {
 			int t = 0;
 			
-			if (lvl->GetPixel({ x, y }) != LevelPixel::LevelGenDirt) continue;
+			if (rows.row[x] != LevelPixel::LevelGenDirt) continue;
 			
-			t += (x!=0            )       && lvl->GetPixel({ x - 1, y }) == LevelPixel::LevelGenRock;
-			t += (x!=lvl->GetSize().x-1 ) && lvl->GetPixel({ x + 1, y }) == LevelPixel::LevelGenRock;
-			t += (y!=0            )       && lvl->GetPixel({ x, y - 1 }) == LevelPixel::LevelGenRock;
-			t += (y!=lvl->GetSize().y-1)  && lvl->GetPixel({ x, y + 1 }) == LevelPixel::LevelGenRock;
+			t += (x!=0      )  && rows.row[x - 1] == LevelPixel::LevelGenRock;
+			t += (x!=width-1)  && rows.row[x + 1] == LevelPixel::LevelGenRock;
+			t += (rows.above)  && rows.above[x] == LevelPixel::LevelGenRock;
+			t += (rows.below)  && rows.below[x] == LevelPixel::LevelGenRock;
 
-			if(t) lvl->SetPixel({ x, y }, LevelPixel::LevelGenMark);
+			if(t) rows.row[x] = LevelPixel::LevelGenMark;
 		}
-	}
+	}, 0, lvl->GetSize().y - 1);
 	
 	/* For every marked spot, randomly fill it: */
-	lvl->ForEachVoxel([](SafePixelAccessor pixel)
+	lvl->ForEachRow([width](int, LevelPixel * row)
 	{
-		if (pixel.Get() == LevelPixel::LevelGenMark)
-			pixel.Set(Random.Bool(500) ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt);
+		for (int x = 0; x < width; x++)
+			if (row[x] == LevelPixel::LevelGenMark)
+				row[x] = ThreadRandom().Bool(500) ? LevelPixel::LevelGenRock : LevelPixel::LevelGenDirt;
 	});
 }
 
 Position generate_inside(Size size, int border) {
 	Position out;
-	out.x = Random.Int(border, size.x - border);
-	out.y = Random.Int(border, size.y - border);
+	out.x = ThreadRandom().Int(border, size.x - border);
+	out.y = ThreadRandom().Int(border, size.y - border);
 	return out;
 }
 
@@ -68,61 +74,19 @@ int pt_dist(Vector a, Vector b) {
 	return (a.x-b.x)*(a.x-b.x) + (a.y-b.y)*(a.y-b.y);
 }
 
-/* Used for point drawing: */
-static void set_point(Level *lvl, int x, int y, LevelPixel value) {
-	if(x >= lvl->GetSize().x || y >= lvl->GetSize().y) return;
-	lvl->SetVoxelRaw({ x, y }, value);
+/* The pen of fat lines: */
+static const StampMask & circle_pen() {
+	static const StampMask pen = StampMask::RoundedSquare(3);
+	return pen;
 }
 
 void set_circle(Level *lvl, int x, int y, LevelPixel value) {
-	int tx, ty;
-	for(ty=-3; ty<=3; ty++) {
-		for(tx=-3; tx<=3; tx++) {
-			if((tx==-3 || tx==3) && (ty==-3 || ty==3)) continue;
-			set_point(lvl, x+tx, y+ty, value);
-		}
-	}
+	lvl->FillShape(StampShape{circle_pen(), Position{x, y}}, value);
 }
 
-#define SWAP(type,a,b) do { type t = (a); (a)=(b); (b)=t; } while(0)
-
-/* New Bresenham's Algorithm-based function: */
-
+/* Bresenham's Algorithm-based, see LineShape: */
 void draw_line(Level *dest, Vector a, Vector b, LevelPixel value, int fat_line) {
-	int swap, dx, dy, error, stepy;
-	int x, y;
-	void (*pt_func)(Level *, int, int, LevelPixel) ;
-	
-	/* How is this thing getting drawn? */
-	pt_func = (fat_line) ? set_circle : set_point;
-	
-	/* Swap x and y values when the graph gets too steep to operate normally: */
-    swap = abs(b.y - a.y) > abs(b.x - a.x);
-	if(swap) {
-		SWAP(int, a.x, a.y);
-		SWAP(int, b.x, b.y);
-	}
-
-	/* Swap a and b so that a is to the left of b: */
-	if(a.x > b.x) SWAP(Vector, a, b);
-
-	/* A few calculations: */
-	dx = b.x - a.x;
-	dy = /*abs*/(b.y - a.y);
-	error = dx / 2;
-	stepy = (a.y < b.y) ? 1 : -1;
-	
-	/* Now, for every x from a.x to b.x, add the correct dot: */
-	for (x = a.x, y=a.y; x <= b.x; x++) {
-		if(swap) pt_func(dest, y, x, value);
-		else     pt_func(dest, x, y, value);
-
-		error -= dy;
-		if(error < 0) {
-			y     += stepy;
-			error += dx;
-		}
-	}
+	dest->FillShape(LineShape{a, b, fat_line ? &circle_pen() : nullptr}, value);
 }
 
 
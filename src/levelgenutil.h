@@ -1,6 +1,9 @@
 #pragma once
 #include <level.h>
 #include <types.h>
+#include <numeric>
+#include <utility>
+#include <vector>
 
 void rough_up(Level * lvl);
 Position generate_inside(Size size, int border);
@@ -11,3 +14,28 @@ void draw_line(Level * dest, Vector a, Vector b, LevelPixel value, int fat_line)
 void fill_all(Level * lvl, LevelPixel c);
 void invert_all(Level * lvl);
 void unmark_all(Level * lvl);
+
+/* Union-find over indices, union by size with path halving */
+class DisjointSets {
+	std::vector<int> parent;
+	std::vector<int> size;
+
+public:
+	explicit DisjointSets(int count) : parent(count), size(count, 1) {
+		std::iota(parent.begin(), parent.end(), 0);
+	}
+	int Find(int i) {
+		while (parent[i] != i)
+			i = parent[i] = parent[parent[i]];
+		return i;
+	}
+	/* Returns false when both were in the same set already */
+	bool Join(int a, int b) {
+		a = Find(a); b = Find(b);
+		if (a == b) return false;
+		if (size[a] < size[b]) std::swap(a, b);
+		parent[b] = a;
+		size[a] += size[b];
+		return true;
+	}
+};
@@ -248,10 +248,7 @@ void Link::Advance()
 
 bool Link::IsConnectionBlocked(Position from, Position to)
 {
-    return !Raycaster::Cast(PositionF{from}, PositionF{to}, [](PositionF tested_pos, PositionF) {
-        auto pixel = GetWorld()->GetLevel()->GetPixel(tested_pos.ToIntPosition());
-        return Pixel::IsAnyCollision(pixel) ? false : true;
-    });
+    return GetWorld()->GetLevel()->FirstCollisionAlongRay(PositionF{from}, PositionF{to}).has_value();
 }
 
 bool Link::IsConnectionBlocked() const
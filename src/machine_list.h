@@ -32,4 +32,11 @@ class MachineryList
     void Draw(class Surface * surface);
 
     Machine * GetMachineAtPoint(Position position);
+
+    /* Call machine_func(Machine &) for every live machine */
+    template <typename MachineFunc>
+    void ForEach(MachineFunc machine_func)
+    {
+        this->items.ForEach([&machine_func](Machine & machine) { machine_func(machine); });
+    }
 };
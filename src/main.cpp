@@ -3,10 +3,12 @@
 #include <crtdbg.h>
 #endif
 #include <cstdlib>
+#include <cstdio>
 #include <cstring>
 #include <game.h>
 #include <gamelib.h>
 #include <level.h>
+#include <level_provider.h>
 #include <levelgen.h>
 #include <memalloc.h>
 #include <random.h>
@@ -20,6 +22,7 @@
 
 #include "exceptions.h"
 #include "game_config.h"
+#include "level_file.h"
 #include "gamelib/sdl/control.h"
 #include "gamelib/sdl/sdl_system.h"
 
@@ -47,15 +50,22 @@ int GameMain(int argc, char * argv[])
     bool is_reading_level = false;
     bool is_reading_seed = false;
     bool is_reading_file = false;
+    bool is_reading_size = false;
+    bool is_reading_save_level = false;
+    bool is_reading_load_level = false;
 
     bool is_fullscreen = false;
     bool is_debug = false;
     bool is_ai = true;
+    bool is_pipelined = false;
+    bool is_streamed = false;
 
     int player_count = 2;
     Size size{1000, 500};
-    char * id = NULL;
+    const char * id = NULL;
     char * outfile_name = NULL;
+    char * save_level_name = NULL;
+    char * load_level_name = NULL;
     int seed = 0, manual_seed = 0;
 
     /* Apply command-line  */
@@ -77,6 +87,25 @@ int GameMain(int argc, char * argv[])
             outfile_name = argv[i];
             is_reading_file = 0;
         }
+        else if (is_reading_size)
+        {
+            if (sscanf(argv[i], "%dx%d", &size.x, &size.y) != 2 || size.x < 100 || size.y < 100)
+            {
+                gamelib_error("Invalid level size: '%s'\n", argv[i]);
+                exit(1);
+            }
+            is_reading_size = 0;
+        }
+        else if (is_reading_save_level)
+        {
+            save_level_name = argv[i];
+            is_reading_save_level = 0;
+        }
+        else if (is_reading_load_level)
+        {
+            load_level_name = argv[i];
+            is_reading_load_level = 0;
+        }
         else if (!strcmp("--help", argv[i]))
         {
             gamelib_print("%s %s\n\n", tweak::system::WindowTitle, tweak::system::Version);
@@ -92,9 +121,15 @@ int GameMain(int argc, char * argv[])
             gamelib_print("--level <GEN>      Use <GEN> as the level generator.\n");
             gamelib_print("--seed <INT>       Use <INT> as the random seed.\n");
             gamelib_print("--large            Generate a far larger level.\n");
+            gamelib_print("--size <W>x<H>     Generate a level of given size. Maps of 16384x16384 and more are fine.\n");
             gamelib_print("--fullscreen       Start in fullscreen mode.\n\n");
             gamelib_print("--only-gen <FILE>  Will only write the level to a .bmp file, and exit.\n");
+            gamelib_print("--save-level <FILE> Will only write the level to a level file, and exit.\n");
+            gamelib_print("--load-level <FILE> Play on a level loaded from a level file instead of generating one.\n");
             gamelib_print("--debug            Write before/after .bmp's to current directory.\n");
+            gamelib_print("--pipelined        Simulate the next tick while drawing the last one.\n");
+            gamelib_print("--streamed         Generate the level tile by tile around the tanks. Needs a generator\n"
+                          "                   that can stream, caves by default. Any size starts at once.\n");
 
             return 0;
         }
@@ -133,6 +168,10 @@ int GameMain(int argc, char * argv[])
             size.x = 1500;
             size.y = 750;
         }
+        else if (!strcmp("--size", argv[i]))
+        {
+            is_reading_size = true;
+        }
         else if (!strcmp("--fullscreen", argv[i]))
         {
             is_fullscreen = true;
@@ -141,10 +180,26 @@ int GameMain(int argc, char * argv[])
         {
             is_reading_file = true;
         }
+        else if (!strcmp("--save-level", argv[i]))
+        {
+            is_reading_save_level = true;
+        }
+        else if (!strcmp("--load-level", argv[i]))
+        {
+            is_reading_load_level = true;
+        }
         else if (!strcmp("--debug", argv[i]))
         {
             is_debug = true;
         }
+        else if (!strcmp("--pipelined", argv[i]))
+        {
+            is_pipelined = true;
+        }
+        else if (!strcmp("--streamed", argv[i]))
+        {
+            is_streamed = true;
+        }
         else
         {
             gamelib_error("Unexpected argument: '%s'\n", argv[i]);
@@ -152,6 +207,14 @@ int GameMain(int argc, char * argv[])
         }
     }
 
+    if (is_streamed && !id)
+        id = levelgen::LevelGenerator::GetName(levelgen::LevelGeneratorType::Caves);
+    if (is_streamed && !levelgen::LevelGenerator::CanStream(levelgen::LevelGenerator::FromName(id)))
+    {
+        gamelib_error("Level generator '%s' can't stream levels.\n", id ? id : "");
+        exit(1);
+    }
+
     /* Seed if necessary: */
     if (manual_seed)
         Random.Seed(seed);
@@ -161,14 +224,26 @@ int GameMain(int argc, char * argv[])
     try
     {
         /* If we're only writing the generated level to file, then just do that: */
-        if (outfile_name)
+        if (outfile_name || save_level_name)
         {
-            /* Generate our random level: */
-            levelgen::GeneratedLevel generated_level = levelgen::LevelGenerator::Generate(levelgen::LevelGenerator::FromName(id), size );
-            generated_level.level->MaterializeLevelTerrainAndBases();
+            /* Generate our random level, or take one that was generated before: */
+            LevelFileInfo level_info = {.generator = levelgen::LevelGenerator::FromName(id), .seed = Random.GetSeed()};
+            levelgen::GeneratedLevel generated_level =
+                load_level_name ? LevelFile::Load(load_level_name, &level_info)
+                                : levelgen::LevelGenerator::Generate(level_info.generator, size);
+            if (!load_level_name)
+                level_info.generation_time = generated_level.generation_time;
+
+            /* The level file holds the level as generated, before materialization */
+            if (save_level_name)
+                LevelFile::Save(*generated_level.level, level_info, save_level_name);
 
             /* Dump it out, and exit: */
-            generated_level.level->DumpBitmap(outfile_name);
+            if (outfile_name)
+            {
+                generated_level.level->MaterializeLevelTerrainAndBases();
+                generated_level.level->DumpBitmap(outfile_name);
+            }
 
             gamelib_exit();
             return 0;
@@ -176,11 +251,20 @@ int GameMain(int argc, char * argv[])
     }
     catch (const GameException & game_ex)
     {
-        gamelib_error("Failed to dump level bitmap: %s", game_ex.what());
+        gamelib_error("Failed to write level: %s", game_ex.what());
     }
 
     try
     {
+        /* Start generating the level, it gets built while the game system starts */
+        std::unique_ptr<LevelProvider> level_provider;
+        if (!load_level_name && !is_streamed)
+        {
+            level_provider = std::make_unique<LevelProvider>();
+            level_provider->Queue({.generator = levelgen::LevelGenerator::FromName(id), .size = size,
+                                   .seed = Random.GetSeed()});
+        }
+
         /* Let's get this ball rolling: */
         gamelib_init();
 
@@ -196,12 +280,18 @@ int GameMain(int argc, char * argv[])
             .is_debug = is_debug,
             .player_count = player_count,
             .use_ai = is_ai,
+            .level_file = load_level_name,
+            .level_provider = level_provider.get(),
+            .is_pipelined = is_pipelined,
+            .is_streamed = is_streamed && !load_level_name,
         };
 
         /* TODO: Unify this global mess */
         /* Setup input/output system */
         ::global_game_system = CreateGameSystem(config.video_config);
         ::global_game = std::make_unique<Game>(config);
+        /* Game took its level. Don't keep the provider thread and its pool around for the whole match. */
+        level_provider.reset();
         /* Play the game: */
         ::global_game->BeginGame();
         gamelib_main_loop([]() -> bool { return global_game->AdvanceStep(); });
@@ -0,0 +1,160 @@
+#include "mapped_memory.h"
+#include "exceptions.h"
+#include <cstdint>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedMemory::MappedMemory(std::size_t size) : size(size)
+{
+    if (size == 0)
+        return;
+#ifdef _WIN32
+    /* Committed pages are backed by the page file but get physical memory only when touched */
+    this->data = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!this->data)
+        throw GameException("Failed to allocate mapped memory.");
+#else
+    this->data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (this->data == MAP_FAILED)
+    {
+        this->data = nullptr;
+        throw GameException("Failed to allocate mapped memory.");
+    }
+#endif
+}
+
+MappedMemory::MappedMemory(const char * file_name, FileAccess access, std::size_t size) : is_file(true)
+{
+    const bool writable = access == FileAccess::ReadWrite;
+#ifdef _WIN32
+    HANDLE file = CreateFileA(file_name, writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw GameException("Failed to open file for mapping.");
+    if (!writable)
+    {
+        LARGE_INTEGER file_size;
+        GetFileSizeEx(file, &file_size);
+        size = std::size_t(file_size.QuadPart);
+    }
+    this->size = size;
+    if (size == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY,
+                                        DWORD(std::uint64_t(size) >> 32), DWORD(size & 0xFFFFFFFF), nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        throw GameException("Failed to map file.");
+    /* The view keeps the mapping alive */
+    this->data = MapViewOfFile(mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+    CloseHandle(mapping);
+    if (!this->data)
+        throw GameException("Failed to map file.");
+#else
+    int file = open(file_name, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (file < 0)
+        throw GameException("Failed to open file for mapping.");
+    if (writable)
+    {
+        if (ftruncate(file, off_t(size)) != 0)
+        {
+            close(file);
+            throw GameException("Failed to resize mapped file.");
+        }
+    }
+    else
+    {
+        struct stat file_stat;
+        fstat(file, &file_stat);
+        size = std::size_t(file_stat.st_size);
+    }
+    this->size = size;
+    if (size == 0)
+    {
+        close(file);
+        return;
+    }
+    this->data = mmap(nullptr, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (this->data == MAP_FAILED)
+    {
+        this->data = nullptr;
+        throw GameException("Failed to map file.");
+    }
+#endif
+}
+
+MappedMemory::~MappedMemory() { Release(); }
+
+std::size_t MappedMemory::GetPageSize()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return std::size_t(info.dwPageSize);
+#else
+    return std::size_t(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+void MappedMemory::Discard(std::size_t offset, std::size_t discard_size)
+{
+    static const std::size_t page_size = GetPageSize();
+    if (this->is_file || !this->data)
+        return;
+
+    /* Only the pages that lie completely inside of the range */
+    std::uintptr_t from = reinterpret_cast<std::uintptr_t>(this->data) + offset;
+    std::uintptr_t until = from + discard_size;
+    from = (from + page_size - 1) / page_size * page_size;
+    until = until / page_size * page_size;
+    if (from >= until)
+        return;
+#ifdef _WIN32
+    /* MEM_RESET would leave the old contents readable, commit fresh pages instead */
+    VirtualFree(reinterpret_cast<void *>(from), until - from, MEM_DECOMMIT);
+    VirtualAlloc(reinterpret_cast<void *>(from), until - from, MEM_COMMIT, PAGE_READWRITE);
+#else
+    madvise(reinterpret_cast<void *>(from), until - from, MADV_DONTNEED);
+#endif
+}
+
+MappedMemory & MappedMemory::operator=(MappedMemory && other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        this->data = std::exchange(other.data, nullptr);
+        this->size = std::exchange(other.size, 0);
+        this->is_file = other.is_file;
+    }
+    return *this;
+}
+
+void MappedMemory::Release()
+{
+    if (!this->data)
+        return;
+#ifdef _WIN32
+    if (this->is_file)
+        UnmapViewOfFile(this->data);
+    else
+        VirtualFree(this->data, 0, MEM_RELEASE);
+#else
+    munmap(this->data, this->size);
+#endif
+    this->data = nullptr;
+    this->size = 0;
+}
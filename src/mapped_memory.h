@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+/*
+ * MappedMemory: memory obtained directly from the virtual memory system
+ *  - anonymous: zero filled, pages become resident only when touched
+ *  - file: the file contents, paged in on access. Writable mappings are written back to the file.
+ *  Throws GameException when the mapping can't be created.
+ */
+class MappedMemory
+{
+    void * data = nullptr;
+    std::size_t size = 0;
+    bool is_file = false;
+
+  public:
+    enum class FileAccess
+    {
+        ReadOnly,  /* Map existing file */
+        ReadWrite, /* Create or resize the file to size, then map it */
+    };
+
+    MappedMemory() = default;
+    explicit MappedMemory(std::size_t size);
+    MappedMemory(const char * file_name, FileAccess access, std::size_t size = 0);
+    ~MappedMemory();
+
+    MappedMemory(const MappedMemory &) = delete;
+    MappedMemory & operator=(const MappedMemory &) = delete;
+    MappedMemory(MappedMemory && other) noexcept { *this = std::move(other); }
+    MappedMemory & operator=(MappedMemory && other) noexcept;
+
+    void * GetData() const { return this->data; }
+    std::size_t GetSize() const { return this->size; }
+    /* Give the pages inside of [offset, offset + size) back to the system. They read as zero afterwards, the same
+     * as pages never touched. Ignored for files. */
+    void Discard(std::size_t offset, std::size_t size);
+    static std::size_t GetPageSize();
+
+  private:
+    void Release();
+};
+
+/*
+ * MappedArray: fixed size array of trivial values in an anonymous mapping. Starts zero filled.
+ *  Stand-in for std::vector for buffers that can grow far beyond what is ever touched (huge levels).
+ */
+template <typename ValueType>
+class MappedArray
+{
+    static_assert(std::is_trivially_copyable_v<ValueType>, "Mapped array holds raw bytes");
+
+    MappedMemory memory;
+    std::size_t count = 0;
+
+  public:
+    MappedArray() = default;
+    explicit MappedArray(std::size_t count) : memory(count * sizeof(ValueType)), count(count) {}
+
+    ValueType * data() { return static_cast<ValueType *>(this->memory.GetData()); }
+    const ValueType * data() const { return static_cast<const ValueType *>(this->memory.GetData()); }
+    std::size_t size() const { return this->count; }
+
+    ValueType & operator[](std::size_t i) { return data()[i]; }
+    const ValueType & operator[](std::size_t i) const { return data()[i]; }
+    ValueType & front() { return data()[0]; }
+
+    ValueType * begin() { return data(); }
+    ValueType * end() { return data() + this->count; }
+    const ValueType * begin() const { return data(); }
+    const ValueType * end() const { return data() + this->count; }
+
+    /* Pages used only by elements [first, first + discard_count) leave physical memory and read as zero again.
+     * Elements sharing a page with the rest of the array keep their values. */
+    void Discard(std::size_t first, std::size_t discard_count)
+    {
+        this->memory.Discard(first * sizeof(ValueType), discard_count * sizeof(ValueType));
+    }
+
+    /* Keeps the common prefix, new elements are zero */
+    void resize(std::size_t new_count)
+    {
+        MappedArray other(new_count);
+        if (this->count && new_count)
+            std::memcpy(other.data(), data(), std::min(this->count, new_count) * sizeof(ValueType));
+        *this = std::move(other);
+    }
+};
@@ -1,7 +1,9 @@
 #pragma once
-#include "random.h"
+#include "thread_pool.h"
 #include "tweak.h"
-#include <future>
+#include <algorithm>
+#include <exception>
+#include <mutex>
 #include <type_traits>
 #include <vector>
 
@@ -28,39 +30,51 @@ struct WorkerDivisor : WorkerCount
     WorkerDivisor(unsigned int divisor) : WorkerCount(tweak::perf::parallelism_degree / divisor) {}
 };
 
-struct ThreadLocal
-{
-    RandomGenerator random;
-
-    ThreadLocal() { random = ::Random; } // Copy state
-};
-
-template <typename Func> /* void(int first, int last)  */
+template <typename Func> /* Result(int first, int last, ThreadLocal * local) */
 auto parallel_for(Func func, int minimum, int maximum, WorkerCount worker_count = {})
     -> std::invoke_result_t<Func, int, int, ThreadLocal *>
 {
-    /* Parallelize the process using std::async and slicing jobs */
-    auto threadLocals = std::vector<ThreadLocal>();
-    auto tasks = std::vector<std::future<int>>();
-    threadLocals.reserve(worker_count);
-    tasks.reserve(worker_count);
+    /* Slice the range into one job per worker and run them on the shared pool */
+    using Result = std::invoke_result_t<Func, int, int, ThreadLocal *>;
+    if (maximum < minimum)
+        return Result{};
 
-    int curr = minimum;
-    for (int i = 0; i < worker_count; ++i)
+    const int step = (maximum - minimum) / worker_count + 1;
+    const int job_count = (maximum - minimum) / step + 1;
+    struct JobResult /* Not a bare vector<Result>, vector<bool> packs neighbors into one word */
     {
-        if (curr <= maximum)
+        Result value;
+    };
+    auto results = std::vector<JobResult>(job_count);
+    std::mutex exception_mutex;
+    std::exception_ptr first_exception;
+    auto run_job = [&](int job, ThreadLocal * local) {
+        int first = minimum + job * step;
+        try
         {
-            int until = curr + (maximum - minimum) / worker_count;
-            threadLocals.emplace_back();
-            tasks.emplace_back(std::async(std::launch::async, func, curr, std::min(maximum, until), &threadLocals[i]));
-            curr = until + 1;
+            results[job].value = func(first, std::min(maximum, first + step - 1), local);
         }
-    }
-    /* Wait for everything done and sum the results */
-    auto result = std::invoke_result_t<Func, int, int, ThreadLocal *>{}; //std::result_of<Func>::type{};
-    for (auto & task : tasks)
+        catch (...)
+        {
+            std::unique_lock lock(exception_mutex);
+            if (!first_exception)
+                first_exception = std::current_exception();
+        }
+    };
+
+    ThreadPool & pool = ThreadPool::Get();
+    TaskGroup group;
+    pool.Submit(group, job_count, run_job);
+    pool.Wait(group);
+    /* The first exception a job threw, after the rest of the jobs finished */
+    if (first_exception)
+        std::rethrow_exception(first_exception);
+
+    /* Sum the results in job order, so that the reduction doesn't depend on timing */
+    auto result = Result{};
+    for (auto & job_result : results)
     {
-        result += task.get();
+        result += job_result.value;
     }
     return result;
 };
@@ -12,25 +12,30 @@
 
 void Bullet::Advance(TankList *)
 {
-    auto IteratePositions = [this](PositionF tested_pos, PositionF prev_pos) {
+    /* Terrain of the whole step is one bit plane query. Pixels are read one by one only when it finds some,
+     * so the bullet still explodes at the pixel the cast reaches. Tanks and machines are tested every pixel. */
+    const PositionF target = this->pos + this->speed;
+    const bool is_terrain_ahead = this->level->FirstCollisionAlongRay(this->pos, target).has_value();
+
+    auto IteratePositions = [this, is_terrain_ahead](PositionF tested_pos, PositionF prev_pos) {
         this->pos = tested_pos;
         this->pos_blur_from = prev_pos;
 
-        if (GetWorld()->GetCollisionSolver()->TestCollide(this->pos.ToIntPosition(), 
-              [this](Tank & tank)
-        {
-                if (tank.GetColor() == this->tank->GetColor())
-                    return false;
-                tank.GetReactor().Exhaust(tweak::tank::ShotDamage);
-                return true;
-        },
-        [](auto & machine)
-        {
+        auto tank_collide = [this](Tank & tank) {
+            if (tank.GetColor() == this->tank->GetColor())
+                return false;
+            tank.GetReactor().Exhaust(tweak::tank::ShotDamage);
+            return true;
+        };
+        auto machine_collide = [](auto & machine) {
             machine.GetReactor().Exhaust(tweak::tank::ShotDamage);
             return true;
-        },
-        [](LevelPixel level_pixel) { return Pixel::IsAnyCollision(level_pixel); }))
-
+        };
+        auto terrain_collide = [](LevelPixel level_pixel) { return Pixel::IsAnyCollision(level_pixel); };
+        const CollisionSolver * solver = GetWorld()->GetCollisionSolver();
+        if (is_terrain_ahead
+                ? solver->TestCollide(this->pos.ToIntPosition(), tank_collide, machine_collide, terrain_collide)
+                : solver->TestCollide(this->pos.ToIntPosition(), tank_collide, machine_collide))
         {
             for (Shrapnel & shrapnel : ExplosionDesc::AllDirections(
                                            this->pos_blur_from.ToIntPosition(), tweak::explosion::normal::ShrapnelCount,
@@ -46,7 +51,7 @@ void Bullet::Advance(TankList *)
 
         return true;
     };
-    Raycaster::Cast(this->pos, this->pos + (this->speed), IteratePositions);
+    Raycaster::Cast(this->pos, target, IteratePositions);
 }
 
 void Bullet::Draw(Surface * drawBuffer)
@@ -68,16 +73,21 @@ void FlyingBarrel::Advance(TankList *, ExplosionFuncType explosionFunc)
     auto prev_positions = boost::circular_buffer<PositionF>{this->explode_distance + 1ull};
     int search_step = 0;
     const int search_step_count = this->explode_distance + int(std::round(this->speed.GetSize()));
+    const PositionF search_end = this->pos + (direction * float(search_step_count));
+    /* Same as Bullet::Advance: terrain pixels are read only when the bit planes have some on the way */
+    const bool is_terrain_ahead = this->level->FirstCollisionAlongRay(this->pos, search_end).has_value();
 
-    auto IteratePositions = [this, &search_step, &prev_positions](PositionF tested_pos, PositionF) {
+    auto IteratePositions = [this, &search_step, &prev_positions, is_terrain_ahead](PositionF tested_pos, PositionF) {
         prev_positions.push_back(tested_pos);
         ++search_step;
 
-        bool is_collision = GetWorld()->GetCollisionSolver()->TestCollide(
-            tested_pos.ToIntPosition(),
-            [this](Tank & tank) { return tank.GetColor() != this->tank->GetColor(); },
-            [](Machine &) { return true; },
-            [](LevelPixel & pixel) { return Pixel::IsAnyCollision(pixel); });
+        auto tank_collide = [this](Tank & tank) { return tank.GetColor() != this->tank->GetColor(); };
+        auto machine_collide = [](Machine &) { return true; };
+        const CollisionSolver * solver = GetWorld()->GetCollisionSolver();
+        bool is_collision = is_terrain_ahead
+                                ? solver->TestCollide(tested_pos.ToIntPosition(), tank_collide, machine_collide,
+                                                      [](LevelPixel & pixel) { return Pixel::IsAnyCollision(pixel); })
+                                : solver->TestCollide(tested_pos.ToIntPosition(), tank_collide, machine_collide);
 
         if (is_collision)
         {
@@ -87,8 +97,8 @@ void FlyingBarrel::Advance(TankList *, ExplosionFuncType explosionFunc)
         return true;
     };
 
-    bool collided = !Raycaster::Cast(this->pos, this->pos + (direction * float(search_step_count)),
-                                     IteratePositions, Raycaster::VisitFlags::PixelsMustTouchCorners);
+    bool collided =
+        !Raycaster::Cast(this->pos, search_end, IteratePositions, Raycaster::VisitFlags::PixelsMustTouchCorners);
 
     /* Now divine a position {explode_dist} steps past in the simulation and explode there if needed
      * It will always be in the first slot of the circular buffer
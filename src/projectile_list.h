@@ -31,4 +31,11 @@ class ProjectileList
 
     void Advance(class Level * level, class TankList * tankList);
     void Draw(class Surface * drawBuffer);
+
+    /* Call projectile_func(Projectile &) for every live projectile */
+    template <typename ProjectileFunc>
+    void ForEach(ProjectileFunc projectile_func)
+    {
+        this->items.ForEach([&projectile_func](Projectile & projectile) { projectile_func(projectile); });
+    }
 };
@@ -5,14 +5,24 @@
 
 RandomGenerator Random;
 
+static thread_local RandomGenerator * thread_random = nullptr;
+
+RandomGenerator & ThreadRandom() { return thread_random ? *thread_random : Random; }
+
+RandomScope::RandomScope(RandomGenerator & random) : previous(thread_random) { thread_random = &random; }
+
+RandomScope::~RandomScope() { thread_random = this->previous; }
+
 void RandomGenerator::Seed()
 {
-	gen.seed(int(time(nullptr)));
+	this->seed = int(time(nullptr));
+	gen.seed(this->seed);
 }
 
 void RandomGenerator::Seed(int seed)
 {
 	gamelib_print("Using seed: %d\n", seed);
+	this->seed = seed;
 	gen.seed(seed);
 	is_seeded = true;
 }
@@ -1,15 +1,18 @@
 #pragma once
+#include <cstdint>
 #include <random>
 
 class RandomGenerator
 {
     bool is_seeded = false;
+    int seed = 0;
     std::mt19937 gen;
 
   public:
     RandomGenerator() { Seed(); }
     void Seed();
     void Seed(int seed);
+    int GetSeed() const { return this->seed; }
 
     bool Bool(int odds_of_off_1000) { return Int(0, 999) < odds_of_off_1000; }
     template <typename IntegerType>
@@ -19,6 +22,54 @@ class RandomGenerator
 
 extern RandomGenerator Random;
 
+/* Generator of the calling thread: ::Random, unless a RandomScope on this thread installed another one.
+ * Level generation draws from it, so that levels can be generated in the background without touching ::Random. */
+RandomGenerator & ThreadRandom();
+
+class RandomScope
+{
+    RandomGenerator * previous;
+
+  public:
+    explicit RandomScope(RandomGenerator & random);
+    ~RandomScope();
+    RandomScope(const RandomScope &) = delete;
+    RandomScope & operator=(const RandomScope &) = delete;
+};
+
+/*
+ * StreamRandom: counter based generator (SplitMix64) keyed by a seed and a stream number.
+ *  Each stream is independent, so parallel workers can take one per row or tile and the result does not
+ *  depend on the number of workers or the order they run in.
+ */
+class StreamRandom
+{
+    std::uint64_t state;
+
+  public:
+    StreamRandom(std::uint64_t seed, std::uint64_t stream) : state(Mix(seed ^ Mix(stream))) {}
+
+    std::uint64_t Next()
+    {
+        this->state += 0x9E3779B97F4A7C15ull;
+        return Mix(this->state);
+    }
+    bool Bool(int odds_of_off_1000) { return Int(0, 999) < odds_of_off_1000; }
+    int Int(int min, int max)
+    {
+        if (max <= min)
+            return min;
+        return int(Next() % std::uint64_t(max - min + 1)) + min;
+    }
+
+    static std::uint64_t Mix(std::uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+};
+
 template <typename IntegerType>
 IntegerType RandomGenerator::Int(IntegerType min, IntegerType max)
 {
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "color.h"
+#include "mapped_memory.h"
 #include "types.h"
 #include <queue>
 #include <vector>
@@ -11,7 +12,7 @@
 class Surface
 {
  protected:
-    std::vector<RenderedPixel> surface;
+    MappedArray<RenderedPixel> surface; /* Mapped, untouched parts of huge level layers stay virtual */
     Size size;
 
     bool use_default_color = false;
@@ -20,11 +21,11 @@ class Surface
     bool use_change_list = false;
     std::vector<Position> change_list;
   protected:
-    Surface(Size size) : surface(size.x * size.y), size(size) {}
-    RenderedPixel & At(Position position) { return surface[position.x + position.y * size.x]; }
+    Surface(Size size) : surface(size.Area()), size(size) {}
+    RenderedPixel & At(Position position) { return surface[size.Index(position)]; }
   public:
     void Clear();
-    void Resize(Size new_size) { surface.resize(new_size.x * new_size.y); }
+    void Resize(Size new_size) { surface.resize(new_size.Area()); }
     Size GetSize() const { return this->size; }
 
     /* Most basic draw functions only, for everything else, there is ShapeRenderer*/
@@ -46,6 +47,10 @@ class Surface
     /* Raw access for GFX libraries with C interface to effectively copy it. Take great care not to overrun. */
     const RenderedPixel * GetRawData() { return &surface.front(); }
     int GetRowPitch() const { return this->size.x * sizeof(RenderedPixel); }
+    /* Raw row access for bulk writers of opaque pixels. Skips blending and the change list. */
+    RenderedPixel * GetRawRow(int y) { return &surface[size.Index(Vector{0, y})]; }
+    /* Pixels [first, first + count) in row-major order become undefined and stop taking physical memory */
+    void Discard(std::size_t first, std::size_t count) { surface.Discard(first, count); }
 };
 
 /*
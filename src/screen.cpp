@@ -174,14 +174,31 @@ ScreenPosition Screen::FromNativeScreen(OffsetF offset) const
 
 void Screen::DrawLevel()
 {
+    WorldRenderSurface & terrain_surface = GetLevelSurfaces()->terrain_surface;
+    WorldRenderSurface & objects_surface = GetLevelSurfaces()->objects_surface;
+
     /* Erase everything */
     GetSystem()->GetSurface()->Clear();
-    GetLevelSurfaces()->terrain_surface.OverlaySurface(&GetLevelSurfaces()->objects_surface);
+    /* Remember the terrain the objects cover. Level data may already be ahead of the drawn tick. */
+    this->covered_terrain.clear();
+    for (Position pos : objects_surface.GetChangeList())
+        this->covered_terrain.push_back(terrain_surface.GetPixel(pos));
+    terrain_surface.OverlaySurface(&objects_surface);
     /* Draw everything */
     std::for_each(this->widgets.begin(), this->widgets.end(), [this](auto & item) { item->Draw(this); });
 
-    GetWorld()->GetLevel()->CommitPixels(GetLevelSurfaces()->objects_surface.GetChangeList());
-    GetLevelSurfaces()->objects_surface.Clear();
+    for (std::size_t i = 0; i < this->covered_terrain.size(); ++i)
+    {
+        Position pos = objects_surface.GetChangeList()[i];
+        terrain_surface.GetRawRow(pos.y)[pos.x] = this->covered_terrain[i];
+    }
+    objects_surface.Clear();
+}
+
+void Screen::CaptureState()
+{
+    for (auto & widget : this->widgets)
+        widget->CaptureState();
 }
 
 void Screen::DrawCurrentMode()
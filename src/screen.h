@@ -34,6 +34,7 @@ class Screen
 
     LevelSurfaces * level_surfaces;
     ScreenRenderSurface * screen_surface;
+    std::vector<RenderedPixel> covered_terrain; /* Terrain under the objects while they are overlaid */
 
   public:
     Screen(bool is_fullscreen, ScreenRenderSurface * render_surface);
@@ -54,6 +55,8 @@ class Screen
 
     /* These will say what virtual pixel a physical pixel resides on: */
     ScreenPosition FromNativeScreen(OffsetF offset) const;
+    /* Copy the world state the widgets show. Call while the world is not advancing. */
+    void CaptureState();
     /*  Draw whatever it is now supposed to draw */
     void DrawCurrentMode();
 
@@ -41,6 +41,11 @@ class TankBase
     [[nodiscard]] TankColor GetColor() const { return this->color; }
     [[nodiscard]] const MaterialContainer & GetResources() const { return this->materials; }
     [[nodiscard]] bool IsInside(Position position) const;
+    /* All positions for which IsInside holds */
+    [[nodiscard]] Rect GetInteriorRect() const
+    {
+        return Rect{this->position + Offset{1 - BaseSize.x / 2, 1 - BaseSize.y / 2}, BaseSize - Size{2, 2}};
+    }
     
     void AbsorbResources(MaterialContainer & other);
     void AbsorbResources(MaterialContainer & other, MaterialAmount rate);
@@ -68,10 +68,7 @@ void TankTurret::Draw(Surface * surface) const
 
 void TankTurret::Erase(Level * level) const
 {
-    for (const Position & pos : this->TurretVoxels)
-    {
-        level->CommitPixel(pos);
-    }
+    level->CommitShape(PointsShape{this->TurretVoxels.data(), this->current_length});
 }
 
 void TankTurret::HandleShoot()
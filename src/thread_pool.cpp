@@ -0,0 +1,159 @@
+#include "thread_pool.h"
+#include <cassert>
+
+#include "gamelib.h"
+#include "tweak.h"
+
+ThreadPool::ThreadPool(int thread_count, ThreadPriority priority)
+{
+    thread_count = std::max(1, thread_count);
+    for (int i = 0; i < thread_count; ++i)
+    {
+        this->queues.push_back(std::make_unique<WorkerQueue>());
+        this->locals.push_back(std::make_unique<ThreadLocal>());
+    }
+    for (int i = 0; i < thread_count; ++i)
+        this->threads.emplace_back([this, i, priority]() { WorkerLoop(i, priority); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock lock(this->sleep_mutex);
+        this->is_stopping = true;
+    }
+    this->wake.notify_all();
+    for (std::thread & thread : this->threads)
+        thread.join();
+    assert(this->queued_tasks == 0);
+}
+
+ThreadPool & ThreadPool::Get()
+{
+    if (CurrentThread().current)
+        return *CurrentThread().current;
+    static ThreadPool pool{int(tweak::perf::parallelism_degree)};
+    return pool;
+}
+
+void ThreadPool::SetForCurrentThread(ThreadPool * pool) { CurrentThread().current = pool; }
+
+ThreadPool::ThreadIdentity & ThreadPool::CurrentThread()
+{
+    thread_local ThreadIdentity identity;
+    return identity;
+}
+
+int ThreadPool::CurrentWorker() const
+{
+    const ThreadIdentity & identity = CurrentThread();
+    return identity.pool == this ? identity.worker : -1;
+}
+
+void ThreadPool::Push(int count, Task task)
+{
+    const int worker = CurrentWorker();
+    if (worker >= 0)
+    {
+        /* Keep the work close, idle workers steal it */
+        WorkerQueue & queue = *this->queues[worker];
+        std::unique_lock lock(queue.mutex);
+        for (int i = 0; i < count; ++i)
+            queue.tasks.push_back(Task{task.run, task.context, task.index + i, task.group});
+    }
+    else
+    {
+        int next;
+        {
+            std::unique_lock lock(this->sleep_mutex);
+            next = this->next_queue;
+            this->next_queue = (next + count) % GetThreadCount();
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            WorkerQueue & queue = *this->queues[(next + i) % GetThreadCount()];
+            std::unique_lock lock(queue.mutex);
+            queue.tasks.push_back(Task{task.run, task.context, task.index + i, task.group});
+        }
+    }
+
+    {
+        std::unique_lock lock(this->sleep_mutex);
+        this->queued_tasks.fetch_add(count, std::memory_order_relaxed);
+    }
+    if (count == 1)
+        this->wake.notify_one();
+    else
+        this->wake.notify_all();
+}
+
+bool ThreadPool::TryRunOne(int worker)
+{
+    Task task;
+    bool found = false;
+    if (worker >= 0)
+    {
+        WorkerQueue & queue = *this->queues[worker];
+        std::unique_lock lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+            found = true;
+        }
+    }
+    /* Steal the oldest task of somebody else */
+    for (int i = 1; !found && i <= GetThreadCount(); ++i)
+    {
+        WorkerQueue & queue = *this->queues[(std::max(worker, 0) + i) % GetThreadCount()];
+        std::unique_lock lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+            found = true;
+        }
+    }
+    if (!found)
+        return false;
+
+    this->queued_tasks.fetch_sub(1, std::memory_order_relaxed);
+    static thread_local ThreadLocal outside_local;
+    task.run(task.context, task.index, worker >= 0 ? this->locals[worker].get() : &outside_local);
+    /* The waiter may return and free the group as soon as the count drops, so notify through the pool */
+    if (task.group->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        { std::unique_lock lock(this->done_mutex); }
+        this->group_done.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::Wait(TaskGroup & group)
+{
+    const int worker = CurrentWorker();
+    while (group.remaining.load(std::memory_order_acquire))
+    {
+        if (TryRunOne(worker))
+            continue;
+        /* Nothing left to help with: the rest of the group is running elsewhere */
+        std::unique_lock lock(this->done_mutex);
+        this->group_done.wait(lock, [&group]() { return group.remaining.load(std::memory_order_acquire) == 0; });
+    }
+}
+
+void ThreadPool::WorkerLoop(int worker, ThreadPriority priority)
+{
+    CurrentThread() = ThreadIdentity{.pool = this, .worker = worker, .current = this};
+    if (priority == ThreadPriority::Low)
+        gamelib_lower_thread_priority();
+    while (true)
+    {
+        if (TryRunOne(worker))
+            continue;
+        std::unique_lock lock(this->sleep_mutex);
+        this->wake.wait(lock, [this]() { return this->is_stopping || this->queued_tasks.load() > 0; });
+        if (this->is_stopping)
+            return;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Per worker state handed to every task the worker runs */
+struct ThreadLocal
+{
+};
+
+enum class ThreadPriority
+{
+    Normal,
+    Low, /* Background work that should not compete with the game loop */
+};
+
+/* Tasks submitted together, waited for together */
+class TaskGroup
+{
+    friend class ThreadPool;
+    std::atomic<int> remaining = 0;
+
+  public:
+    TaskGroup() = default;
+    TaskGroup(const TaskGroup &) = delete;
+    TaskGroup & operator=(const TaskGroup &) = delete;
+};
+
+/*
+ * ThreadPool: process-wide set of persistent worker threads
+ *  Every worker owns a deque of tasks. It takes work from the back of its own deque and, when that runs dry,
+ *  steals from the front of the others. Tasks submitted from a worker go to its own deque, tasks submitted
+ *  from other threads are dealt round robin.
+ *  Waiting for a group runs queued tasks on the waiting thread until the group is done, so tasks can
+ *  submit and wait for tasks of their own.
+ *  Each worker has one ThreadLocal for its whole life, threads outside of the pool get one of their own.
+ */
+class ThreadPool
+{
+    struct Task
+    {
+        void (*run)(const void * context, int index, ThreadLocal * local);
+        const void * context;
+        int index;
+        TaskGroup * group;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::vector<std::unique_ptr<ThreadLocal>> locals;
+    std::vector<std::thread> threads;
+
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<int> queued_tasks = 0;
+    std::mutex done_mutex;
+    std::condition_variable group_done;
+    bool is_stopping = false;
+    int next_queue = 0;
+
+  public:
+    explicit ThreadPool(int thread_count, ThreadPriority priority = ThreadPriority::Normal);
+    ~ThreadPool();
+
+    /* Pool of the calling thread. That is the process-wide pool with tweak::perf::parallelism_degree workers,
+     * started on first use, unless SetForCurrentThread picked another one. Workers get their own pool. */
+    static ThreadPool & Get();
+    /* Makes Get() return pool on the calling thread, the process-wide pool again for null */
+    static void SetForCurrentThread(ThreadPool * pool);
+
+    int GetThreadCount() const { return int(this->queues.size()); } /* Complete before the first worker starts */
+    /* True when called from one of the workers of any pool */
+    static bool IsWorkerThread() { return CurrentThread().pool; }
+
+    /* Queue task_func(int index, ThreadLocal * local) for index in [0, count). The function object has to stay
+     * alive until the group is waited for. */
+    template <typename TaskFunc>
+    void Submit(TaskGroup & group, int count, const TaskFunc & task_func);
+    /* Queue a single task_func(index, local), for tasks that schedule their successors one by one */
+    template <typename TaskFunc>
+    void SubmitOne(TaskGroup & group, int index, const TaskFunc & task_func);
+    /* Block until all tasks of the group finished, running queued tasks meanwhile */
+    void Wait(TaskGroup & group);
+
+  private:
+    void Push(int count, Task task); /* Queues count copies of the task with indices from task.index up */
+    bool TryRunOne(int worker);
+    void WorkerLoop(int worker, ThreadPriority priority);
+
+    struct ThreadIdentity
+    {
+        ThreadPool * pool = nullptr; /* Pool this thread is a worker of */
+        int worker = -1;
+        ThreadPool * current = nullptr; /* Returned by Get() */
+    };
+    static ThreadIdentity & CurrentThread();
+    int CurrentWorker() const; /* Index of the worker running on this thread, -1 outside of this pool */
+};
+
+template <typename TaskFunc>
+void ThreadPool::Submit(TaskGroup & group, int count, const TaskFunc & task_func)
+{
+    if (count <= 0)
+        return;
+    auto run = [](const void * context, int index, ThreadLocal * local) {
+        (*static_cast<const TaskFunc *>(context))(index, local);
+    };
+    group.remaining.fetch_add(count, std::memory_order_relaxed);
+    Push(count, Task{run, &task_func, 0, &group});
+}
+
+template <typename TaskFunc>
+void ThreadPool::SubmitOne(TaskGroup & group, int index, const TaskFunc & task_func)
+{
+    auto run = [](const void * context, int index, ThreadLocal * local) {
+        (*static_cast<const TaskFunc *>(context))(index, local);
+    };
+    group.remaining.fetch_add(1, std::memory_order_relaxed);
+    Push(1, Task{run, &task_func, index, &group});
+}
@@ -26,6 +26,12 @@ namespace perf
 
 	/* The desired speed in frames per second: */
 	constexpr int TargetFps = 24;
+
+	constexpr int PregeneratedLevels = 2; /* LevelProvider keeps at most this many levels generated ahead */
+	constexpr std::size_t PregeneratedLevelBytes = std::size_t(512) << 20; /* ...and about this much memory for them */
+
+	/* JobGraph runs jobs that took less than this on the last run on the thread that released them */
+	constexpr std::chrono::microseconds JobDispatchCost{20};
 }
 
 namespace world
@@ -38,12 +44,20 @@ namespace world
     constexpr auto DirtRecoverInterval = 250ms; /* Perform the recovery queries only once per this interval */
     constexpr int DirtRecoverSpeed = 10; /* Average delay before growing finishes and new dirt is formed. More is faster. */
     constexpr int DirtRegrowSpeed = 4;  /* Average delay before it starts growing back. More is faster.*/
+    constexpr int DirtRegrowSlices = 6; /* Regrow 1/N of the level on every tick. 1 regrows all of it once per DirtRecoverInterval. */
+    constexpr int DirtRegrowTickBudget = 512; /* Sliced regrowth leaves the rest to the next tick after this many active tiles */
     constexpr int DigThroughRockChance = 250; /* Chance to dig through rock with torch of out 1000 */
 
     constexpr std::chrono::microseconds RefreshLinkMapInterval = 200ms;
     constexpr std::chrono::microseconds LinkCollisionCheckInterval = 200ms;
     constexpr float MaximumLiveLinkDistance = 100.f;
     constexpr float MaximumTheoreticalLinkDistance = 170.f;
+
+    /* Streamed levels: terrain is materialized this far around tanks (and so their views), shots and machines */
+    constexpr int StreamTankMargin = 256;
+    constexpr int StreamObjectMargin = 64;
+    constexpr int StreamEvictMargin = 768; /* Tiles farther than this from every tank and base get evicted */
+    constexpr std::chrono::microseconds StreamEvictInterval = 2s;
     } // namespace world
 
 namespace base
@@ -48,6 +48,9 @@ struct Size : public Vector
     constexpr Size() = default;
     constexpr Size(int sx, int sy) : Vector(sx, sy) {}
     bool FitsInside(int sx, int sy) { return sx >= 0 && sy >= 0 && sx < this->x && sy < this->y; }
+    /* Element count and row-major index of 2D buffers of this size. 64-bit, huge levels overflow int. */
+    constexpr std::size_t Area() const { return std::size_t(this->x) * std::size_t(this->y); }
+    constexpr std::size_t Index(Vector pos) const { return std::size_t(pos.y) * std::size_t(this->x) + pos.x; }
 };
 
 /* Size in units of our screen render surface */
@@ -243,6 +246,11 @@ struct RectBase
     {
         return vec.x >= this->Left() && vec.x <= this->Right() && vec.y >= this->Top() && vec.y <= this->Bottom();
     }
+    constexpr bool Intersects(const RectBase & other) const
+    {
+        return this->Left() <= other.Right() && other.Left() <= this->Right() && this->Top() <= other.Bottom() &&
+               other.Top() <= this->Bottom();
+    }
     [[nodiscard]] Vector MakeInside(Vector vec) const
     {
         return {std::clamp(vec.x, this->Left(), this->Right()), std::clamp(vec.y, this->Top(), this->Bottom())};
@@ -2,8 +2,11 @@
 #include "game.h"
 #include "random.h"
 
+#include <iterator>
+
 World::World(Game * game, std::unique_ptr<Level> && level)
     : game(game), level(std::move(level)),
+      regrowth(this->level.get()),
       link_map(this->level.get()),
       projectile_list(),
       harvester_list(),
@@ -11,6 +14,26 @@ World::World(Game * game, std::unique_ptr<Level> && level)
       collision_solver(this->level.get(), &this->tank_list, &this->harvester_list)
 {
     //this->level->OnConnectWorld(this);
+    BuildTickJobs();
+}
+
+void World::BuildTickJobs()
+{
+    Level * level = this->level.get();
+    std::function<void()> funcs[] = {
+        [this]() { RegrowPass(); },
+        [this, level]() { this->projectile_list.Advance(level, this->GetTankList()); },
+        [this]() { this->tank_list.for_each([=](Tank * t) { t->Advance(this); }); },
+        [this, level]() { this->harvester_list.Advance(level, this->GetTankList()); },
+        [level]() {
+            for (TankBase & base : level->GetSpawns())
+                base.Advance();
+        },
+        [this]() { this->link_map.Advance(); },
+    };
+    static_assert(std::size(funcs) == std::size(TickJobs));
+    for (std::size_t i = 0; i < std::size(TickJobs); ++i)
+        this->tick_jobs.Add(TickJobs[i].name, TickJobs[i].access, std::move(funcs[i]));
 }
 
 void World::Clear()
@@ -27,16 +50,28 @@ void World::Advance()
 {
     ++this->advance_count;
     this->time_elapsed += tweak::world::AdvanceStep;
-    RegrowPass();
-
-    /* Move everything: */
-    this->projectile_list.Advance(this->level.get(), this->GetTankList());
-    this->tank_list.for_each([=](Tank * t) { t->Advance(this); });
-    this->harvester_list.Advance(this->level.get(), this->GetTankList());
-    /* TODO: get out of level? */
-    for (TankBase & base : this->level->GetSpawns())
-        base.Advance();
-    this->link_map.Advance();
+
+    /* Terrain has to be there before anything of this tick looks at it */
+    if (this->level->IsStreamed())
+        StreamTiles();
+
+    /* Terrain writes of this tick reach the terrain surface once, in CommitEdits */
+    this->level->BeginEdits();
+
+    /* Regrow and move everything. Jobs that don't share state run at the same time. */
+    this->tick_jobs.Run();
+
+    this->level->CommitEdits();
+
+    /* Performance info */
+    this->tick_elapsed += this->tick_jobs.GetRunTime();
+    if (this->advance_count % 100 == 0)
+    {
+        auto average = this->tick_elapsed / 100;
+        DebugTrace<4>("Tick jobs take on average %lld.%03lld ms, last critical path: %s\r\n", average.count() / 1000,
+                      average.count() % 1000, this->tick_jobs.DescribeCriticalPath().c_str());
+        this->tick_elapsed = {};
+    }
 }
 
 
@@ -53,47 +88,78 @@ void World::Draw(WorldRenderSurface * objects_surface)
 
 void World::SetGameOver() { this->game->GameOver(); }
 
-
-void World::RegrowPass()
+void World::StreamTiles()
 {
-    if (!this->regrow_timer.AdvanceAndCheckElapsed())
+    Level * level = this->level.get();
+    auto around = [](Position pos, int margin) {
+        return Rect{pos - Size{margin, margin}, Size{2 * margin + 1, 2 * margin + 1}};
+    };
+
+    /* Views follow the tanks, so the tank margin covers what is drawn */
+    this->tank_list.for_each(
+        [&](Tank * tank) { level->MaterializeTiles(around(tank->GetPosition(), tweak::world::StreamTankMargin)); });
+    this->projectile_list.ForEach([&](Projectile & projectile) {
+        level->MaterializeTiles(around(projectile.pos.ToIntPosition(), tweak::world::StreamObjectMargin));
+    });
+    this->harvester_list.ForEach([&](Machine & machine) {
+        level->MaterializeTiles(around(machine.GetPosition(), tweak::world::StreamObjectMargin));
+    });
+
+    if (!this->stream_evict_timer.AdvanceAndCheckElapsed())
         return;
+    /* Objects keep twice the margin they materialize, so they don't evict and reload tiles on every step */
+    std::vector<Rect> keep;
+    this->tank_list.for_each(
+        [&](Tank * tank) { keep.push_back(around(tank->GetPosition(), tweak::world::StreamEvictMargin)); });
+    for (const TankBase & base : level->GetSpawns())
+        keep.push_back(around(base.GetPosition(), tweak::world::StreamEvictMargin));
+    this->projectile_list.ForEach([&](Projectile & projectile) {
+        keep.push_back(around(projectile.pos.ToIntPosition(), 2 * tweak::world::StreamObjectMargin));
+    });
+    this->harvester_list.ForEach([&](Machine & machine) {
+        keep.push_back(around(machine.GetPosition(), 2 * tweak::world::StreamObjectMargin));
+    });
+    int evicted = level->EvictTiles(keep);
+    if (evicted)
+    {
+        LevelStreamStats stats = level->GetStreamStats();
+        DebugTrace<4>("Evicted %d tiles, %d resident, %d evicted with changes in %lld kB\r\n", evicted,
+                      stats.resident_tiles, stats.evicted_tiles, static_cast<long long>(stats.evicted_bytes / 1024));
+    }
+}
+
 
+void World::RegrowPass()
+{
     Stopwatch<> elapsed;
-    int holes_decayed = 0;
-    int dirt_grown = 0;
-    this->level->ForEachVoxelParallel(
-        [this, &holes_decayed, &dirt_grown](LevelPixel pix, SafePixelAccessor pixel, ThreadLocal * local) {
-            if (pix == LevelPixel::Blank || Pixel::IsScorched(pix) || this->GetLevel()->CheckBaseCollision(pixel.GetPosition()))
-            {
-                int neighbors = //this->level->DirtPixelsAdjacent(pixel.GetPosition());
-                    this->level->CountNeighborValues(pixel.GetPosition(), [](auto voxel) { return Pixel::IsDirt(voxel) ? 1 : 0; });
-                int modifier = (pix == LevelPixel::Blank) ? 4 : 1;
-                if (neighbors > 2 && local->random.Int(0, 1000) < tweak::world::DirtRegrowSpeed * neighbors * modifier)
-                {
-
-                    pixel.Set(LevelPixel::DirtGrow);
-                    this->level->CommitPixel(pixel.GetPosition());
-                    ++holes_decayed;
-                }
-            }
-            else if (pix == LevelPixel::DirtGrow)
-            {
-                if (Random.Int(0, 1000) < tweak::world::DirtRecoverSpeed)
-                {
-                    pixel.Set(local->random.Bool(500) ? LevelPixel::DirtHigh : LevelPixel::DirtLow);
-                    this->level->CommitPixel(pixel.GetPosition());
-                    ++dirt_grown;
-                }
-            }
-        },
-        WorkerCount{PhysicalCores{}});
+    RegrowStats stats;
+    if constexpr (tweak::world::DirtRegrowSlices > 1)
+    {
+        /* A slice every tick keeps the cost of regrowth even instead of a spike every DirtRecoverInterval */
+        stats = this->regrowth.PassSlice(this->time_elapsed, tweak::world::DirtRegrowSlices,
+                                         tweak::world::DirtRegrowTickBudget, WorkerCount{PhysicalCores{}});
+    }
+    else
+    {
+        if (!this->regrow_timer.AdvanceAndCheckElapsed())
+            return;
+        stats = this->regrowth.Pass(WorkerCount{PhysicalCores{}});
+    }
+
+    /* Workers only wrote the level data. Materialize the tiles they touched in one go. */
+    this->level->CommitChangedTiles();
 
-    this->regrow_elapsed += elapsed.GetElapsed();
+    auto pass_elapsed = elapsed.GetElapsed();
+    this->regrow_elapsed += pass_elapsed;
+    this->regrow_peak = std::max(this->regrow_peak, pass_elapsed);
     if (this->advance_count % 100 == 1)
     {
         this->regrow_average = this->regrow_elapsed / this->advance_count;
-        DebugTrace<4>("RegrowPass takes on average %lld.%03lld ms\r\n", this->regrow_average.count() / 1000,
-                      this->regrow_average.count() % 1000);
+        DebugTrace<4>("RegrowPass takes on average %lld.%03lld ms, at most %lld.%03lld ms, %d active tiles, "
+                      "%d rescanned\r\n",
+                      this->regrow_average.count() / 1000, this->regrow_average.count() % 1000,
+                      this->regrow_peak.count() / 1000, this->regrow_peak.count() % 1000, stats.tiles_active,
+                      stats.tiles_refreshed);
+        this->regrow_peak = {};
     }
 }
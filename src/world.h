@@ -2,7 +2,9 @@
 
 #include "collision_solver.h"
 #include "game.h"
+#include "job_graph.h"
 #include "level.h"
+#include "level_regrowth.h"
 #include "link.h"
 #include "machine_list.h"
 #include "projectile_list.h"
@@ -12,11 +14,45 @@ class WorldRenderSurface;
 
 class World
 {
+    /* Shared state the jobs of a tick read and write, see World::BuildTickJobs */
+    enum TickState : unsigned
+    {
+        Terrain = 1 << 0,
+        Tanks = 1 << 1,
+        Projectiles = 1 << 2,
+        Machines = 1 << 3,
+        Bases = 1 << 4,
+        Links = 1 << 5,
+        GlobalRandom = 1 << 6, /* ::Random */
+    };
+
+  public:
+    /* A job of a tick and the state it touches. Jobs run in this order when nothing runs them side by side. */
+    struct TickJob
+    {
+        const char * name;
+        JobGraph::Access access;
+    };
+    static constexpr TickJob TickJobs[] = {
+        {"regrow", {.writes = Terrain}},
+        /* Shots dig and build terrain, damage tanks and machines and spawn shrapnel */
+        {"projectiles", {.writes = Terrain | Tanks | Projectiles | Machines | GlobalRandom}},
+        /* Tanks dig, shoot, build machines, use their bases and move their link points */
+        {"tanks", {.writes = Terrain | Tanks | Projectiles | Machines | Bases | Links | GlobalRandom}},
+        /* Harvesters dig dirt for their owner, move their link points and burst into shrapnel when they die */
+        {"machines", {.writes = Terrain | Tanks | Projectiles | Machines | Links | GlobalRandom}},
+        /* TODO: get out of level? */
+        {"bases", {.writes = Bases}},
+        {"links", {.reads = Terrain | Tanks | Machines | Bases, .writes = Links}},
+    };
+
+  private:
     class Game * game;
     int advance_count = 0;
     std::chrono::microseconds time_elapsed = {};
 
     std::unique_ptr<Level> level;
+    LevelRegrowth regrowth;
     LinkMap link_map;
     ProjectileList projectile_list;
     MachineryList harvester_list;
@@ -24,6 +60,9 @@ class World
 
     CollisionSolver collision_solver;
     RepetitiveTimer regrow_timer{tweak::world::DirtRecoverInterval};
+    RepetitiveTimer stream_evict_timer{tweak::world::StreamEvictInterval};
+
+    JobGraph tick_jobs;
 
   public:
     World(Game * game, std::unique_ptr<Level> && level);
@@ -46,9 +85,15 @@ class World
   private:
     std::chrono::microseconds regrow_elapsed = {};
     std::chrono::microseconds regrow_average = {};
+    std::chrono::microseconds regrow_peak = {}; /* Longest pass since the last trace */
+    std::chrono::microseconds tick_elapsed = {}; /* Tick jobs since the last trace */
 
     /* Attempts to regrow destroyed dirt in empty places where there is some neighboring dirt to extend */
     void RegrowPass();
+    /* Streamed levels: materialize terrain around everything that moves, evict it far from tanks and bases */
+    void StreamTiles();
+    /* Jobs of one Advance with the state each of them touches */
+    void BuildTickJobs();
 };
 
 inline World * GetWorld() { return GetGame()->GetWorld(); }